@@ -1,6 +1,14 @@
 
 #include "simfs.h"
+#include "simfs_crc.h"
+#include "simfs_io.h"
+#include "simfs_lz4.h"
+#include "simfs_stats.h"
+#include "simfs_trace.h"
 #include <stdbool.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
 
 //////////////////////////////////////////////////////////////////////////
 //
@@ -8,8 +16,14 @@
 //
 //////////////////////////////////////////////////////////////////////////
 
-SIMFS_CONTEXT_TYPE *simfsContext; // all in-memory information about the system
-SIMFS_VOLUME *simfsVolume;
+// the instance of the functions without an instance parameter
+static SIMFS_INSTANCE_TYPE defaultInstance;
+
+// the instance the calling thread works on; the functions taking an instance switch to it for the duration of the call
+static _Thread_local SIMFS_INSTANCE_TYPE *currentInstance = &defaultInstance;
+
+#define simfsContext (currentInstance->context) // all in-memory information about the system
+#define simfsVolume (currentInstance->volume)
 
 
 //////////////////////////////////////////////////////////////////////////
@@ -35,14 +49,20 @@ inline unsigned long hash(unsigned char *str)
 }
 
 /*****
- * Find a free block in a bit vector.
+ * Find a free block among the blocks [first, last) of a bit vector; first and last are multiples of 8.
+ * Returns SIMFS_NUMBER_OF_BLOCKS if there is none.
  */
-inline unsigned short simfsFindFreeBlock(unsigned char *bitvector)
+static unsigned short findFreeBlockInRange(unsigned char *bitvector, int first, int last)
 {
-    unsigned short i = 0;
-    while (bitvector[i] == 0xFF)
+    unsigned short i = first / 8;
+    while (i < last / 8 && bitvector[i] == 0xFF)
         i += 1;
 
+    if (i == last / 8) {
+        SIMFS_TRACE_INSTANT(SIMFS_TRACE_FIND_FREE_BLOCK, SIMFS_NUMBER_OF_BLOCKS, 0);
+        return SIMFS_NUMBER_OF_BLOCKS; // the range is full
+    }
+
     register unsigned char mask = 0x80;
     unsigned short j = 0;
     while (bitvector[i] & mask)
@@ -51,9 +71,18 @@ inline unsigned short simfsFindFreeBlock(unsigned char *bitvector)
         ++j;
     }
 
+    SIMFS_TRACE_INSTANT(SIMFS_TRACE_FIND_FREE_BLOCK, i * 8 + j, 0);
     return (i * 8) + j; // i bytes and j bits are all "1", so this formula points to the first "0"
 }
 
+/*****
+ * Find a free block in a bit vector.
+ */
+inline unsigned short simfsFindFreeBlock(unsigned char *bitvector)
+{
+    return findFreeBlockInRange(bitvector, 0, SIMFS_NUMBER_OF_BLOCKS);
+}
+
 /***
  * Three functions for bit manipulation.
  */
@@ -85,357 +114,2518 @@ inline void simfsClearBit(unsigned char *bitvector, unsigned short bitIndex)
 }
 
 /***
- * Allocates space for the file system and saves it to disk.
+ * Block allocation on top of the in-memory bitvector.
+ *
+ * allocateBlock() takes the first free block of the given allocation group, or of the other group if that one is
+ * full, and marks it as used in the in-memory bitvector; it returns SIMFS_INVALID_INDEX if the volume is full.
+ * The changes are copied to the bitvector of the volume with syncBitvector() once an operation has completed.
  */
-SIMFS_ERROR simfsCreateFileSystem(char *simfsFileName)
-{
-    FILE *file = fopen(simfsFileName, "wb");
-    if (file == NULL)
-        return SIMFS_ALLOC_ERROR;
-
-    // --- create the OS context ---
+static const int groupStart[SIMFS_NUMBER_OF_GROUPS + 1] = {0, SIMFS_METADATA_GROUP_SIZE, SIMFS_NUMBER_OF_BLOCKS};
 
-    printf("Size of SIMFS_CONTEXT_TYPE: %ld\n", sizeof(SIMFS_CONTEXT_TYPE));
-    simfsContext = malloc(sizeof(SIMFS_CONTEXT_TYPE));
-    if (simfsContext == NULL)
-        return SIMFS_ALLOC_ERROR;
+static SIMFS_INDEX_TYPE allocateBlock(SIMFS_ALLOCATION_GROUP_TYPE group)
+{
+    unsigned short i = SIMFS_NUMBER_OF_BLOCKS;
+    for (int g = 0; g < SIMFS_NUMBER_OF_GROUPS && i >= SIMFS_NUMBER_OF_BLOCKS; g++) {
+        int from = (group + g) % SIMFS_NUMBER_OF_GROUPS;
+        i = findFreeBlockInRange(simfsContext->bitvector, groupStart[from], groupStart[from + 1]);
+    }
+    if (i >= SIMFS_NUMBER_OF_BLOCKS)
+        return SIMFS_INVALID_INDEX;
 
-    for (int i = 0; i < SIMFS_MAX_NUMBER_OF_OPEN_FILES; i++)
-        simfsContext->globalOpenFileTable[i].type = SIMFS_INVALID_CONTENT_TYPE;  // indicates  empty slot
+    simfsSetBit(simfsContext->bitvector, i);
+    simfsStatsBlocks(1, 0);
+    return i;
+}
 
-    for (int i = 0; i < SIMFS_DIRECTORY_SIZE; i++)
-        simfsContext->directory[i] = NULL;
+/***
+ * Allocates up to count blocks of the given allocation group, then of the other one, with a single pass over the
+ * in-memory bitvector; returns the number of blocks obtained and their indices through the parameter blocks.
+ */
+static int allocateBlocks(SIMFS_ALLOCATION_GROUP_TYPE group, int count, SIMFS_INDEX_TYPE *blocks)
+{
+    int allocated = 0;
+    for (int g = 0; g < SIMFS_NUMBER_OF_GROUPS && allocated < count; g++) {
+        int from = (group + g) % SIMFS_NUMBER_OF_GROUPS;
+        for (int i = groupStart[from] / 8; i < groupStart[from + 1] / 8 && allocated < count; i++) {
+            if (simfsContext->bitvector[i] == 0xFF)
+                continue;
+
+            for (int j = 0; j < 8 && allocated < count; j++) {
+                if (!(simfsContext->bitvector[i] & (0x80 >> j))) {
+                    simfsContext->bitvector[i] |= (0x80 >> j);
+                    blocks[allocated++] = i * 8 + j;
+                }
+            }
+        }
+    }
+    simfsStatsBlocks(allocated, 0);
+    return allocated;
+}
 
-    memset(simfsContext->bitvector, 0, SIMFS_NUMBER_OF_BLOCKS / 8);
+static SIMFS_INDEX_TYPE allocateIndexBlock()
+{
+    SIMFS_INDEX_TYPE i = allocateBlock(SIMFS_METADATA_GROUP);
+    if (i == SIMFS_INVALID_INDEX)
+        return SIMFS_INVALID_INDEX;
 
-    simfsContext->processControlBlocks = NULL;
+    simfsVolume->block[i].type = SIMFS_INDEX_CONTENT_TYPE;
+    memset(simfsVolume->block[i].content.index, 0, sizeof(simfsVolume->block[i].content.index));
+    return i;
+}
 
-    // --- create the volume ---
+static void freeBlock(SIMFS_INDEX_TYPE blockIndex)
+{
+    simfsClearBit(simfsContext->bitvector, blockIndex);
+    simfsVolume->block[blockIndex].type = SIMFS_INVALID_CONTENT_TYPE;
+    simfsStatsBlocks(0, 1);
+}
 
-    printf("Size of SIMFS_VOLUME: %ld\n", sizeof(SIMFS_VOLUME));
-    simfsVolume = malloc(sizeof(SIMFS_VOLUME));
-    if (simfsVolume == NULL)
-        return SIMFS_ALLOC_ERROR;
+//////////////////////////////////////////////////////////////////////////
 
-    // initialize the superblock
+static uint64_t rotateLeft(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
 
-    simfsVolume->superblock.attr.nextUniqueIdentifier = SIMFS_INITIAL_VALUE_OF_THE_UNIQUE_FILE_IDENTIFIER;
-    simfsVolume->superblock.attr.rootNodeIndex = SIMFS_ROOT_NODE_INDEX;
-    simfsVolume->superblock.attr.blockSize = SIMFS_BLOCK_SIZE;
-    simfsVolume->superblock.attr.numberOfBlocks = SIMFS_NUMBER_OF_BLOCKS;
+static uint64_t mixBits(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
 
-    // initialize the bitvector
+/***
+ * Computes the 128-bit fingerprint of the content of a data block with MurmurHash3 (x64, 128-bit variant).
+ */
+static SIMFS_FINGERPRINT_TYPE fingerprint(const char *data, size_t length)
+{
+    const uint64_t c1 = 0x87c37b91114253d5ULL, c2 = 0x4cf5ad432745937fULL;
+    uint64_t h1 = 0, h2 = 0, k1, k2;
+
+    size_t offset = 0;
+    for (; offset + 16 <= length; offset += 16) {
+        memcpy(&k1, data + offset, 8);
+        memcpy(&k2, data + offset + 8, 8);
+        h1 ^= rotateLeft(k1 * c1, 31) * c2;
+        h1 = (rotateLeft(h1, 27) + h2) * 5 + 0x52dce729;
+        h2 ^= rotateLeft(k2 * c2, 33) * c1;
+        h2 = (rotateLeft(h2, 31) + h1) * 5 + 0x38495ab5;
+    }
 
-    memset(simfsVolume->bitvector, 0, SIMFS_NUMBER_OF_BLOCKS / 8);
+    size_t tail = length - offset;
+    k1 = k2 = 0;
+    memcpy(&k1, data + offset, (tail < 8 ? tail : 8));
+    if (tail > 8) {
+        memcpy(&k2, data + offset + 8, tail - 8);
+        h2 ^= rotateLeft(k2 * c2, 33) * c1;
+    }
+    if (tail > 0)
+        h1 ^= rotateLeft(k1 * c1, 31) * c2;
+
+    h1 ^= length;
+    h2 ^= length;
+    h1 += h2;
+    h2 += h1;
+    h1 = mixBits(h1);
+    h2 = mixBits(h2);
+    h1 += h2;
+    h2 += h1;
+    return (SIMFS_FINGERPRINT_TYPE) {h1, h2};
+}
 
-    // initialize the blocks holding the root folder
+/***
+ * Returns the slot of the fingerprint index holding a data block with the given fingerprint, or the empty slot where
+ * such a block would be added.
+ */
+static int fingerprintSlot(SIMFS_FINGERPRINT_TYPE key)
+{
+    SIMFS_FINGERPRINT_INDEX_TYPE *fingerprints = simfsContext->fingerprints;
+    int slot = (int) (key.low & (SIMFS_FINGERPRINT_INDEX_SIZE - 1));
+    while (fingerprints->block[slot] != SIMFS_INVALID_INDEX
+           && (fingerprints->fingerprint[slot].low != key.low || fingerprints->fingerprint[slot].high != key.high))
+        slot = (slot + 1) & (SIMFS_FINGERPRINT_INDEX_SIZE - 1);
+    return slot;
+}
 
-    // initialize the root folder
+/***
+ * Adds a data block to the fingerprint index, unless a block with the same fingerprint is there already.
+ */
+static void indexDataBlock(SIMFS_INDEX_TYPE block)
+{
+    SIMFS_FINGERPRINT_TYPE key = fingerprint(simfsVolume->block[block].content.data, SIMFS_DATA_SIZE);
+    int slot = fingerprintSlot(key);
+    if (simfsContext->fingerprints->block[slot] == SIMFS_INVALID_INDEX) {
+        simfsContext->fingerprints->fingerprint[slot] = key;
+        simfsContext->fingerprints->block[slot] = block;
+    }
+}
 
-    simfsVolume->block[0].type = SIMFS_FOLDER_CONTENT_TYPE;
-    // root folder always has "0" as the identifier
-    simfsVolume->block[0].content.fileDescriptor.identifier = simfsVolume->superblock.attr.nextUniqueIdentifier++;
-    simfsVolume->block[0].content.fileDescriptor.type = SIMFS_FOLDER_CONTENT_TYPE;
-    strcpy(simfsVolume->block[0].content.fileDescriptor.name, "/");
-    simfsVolume->block[0].content.fileDescriptor.accessRights = umask(00000);
-    simfsVolume->block[0].content.fileDescriptor.owner = 0; // arbitrarily simulated
-    simfsVolume->block[0].content.fileDescriptor.size = 0;
+/***
+ * Removes a data block from the fingerprint index. The entries behind it that were displaced past their home slot
+ * are shifted back, so that lookups never have to step over a removed entry.
+ */
+static void unindexDataBlock(SIMFS_INDEX_TYPE block)
+{
+    SIMFS_FINGERPRINT_INDEX_TYPE *fingerprints = simfsContext->fingerprints;
+    const int mask = SIMFS_FINGERPRINT_INDEX_SIZE - 1;
+    int hole = fingerprintSlot(fingerprint(simfsVolume->block[block].content.data, SIMFS_DATA_SIZE));
+    if (fingerprints->block[hole] != block)
+        return;
+
+    for (int next = (hole + 1) & mask; fingerprints->block[next] != SIMFS_INVALID_INDEX; next = (next + 1) & mask) {
+        int home = (int) (fingerprints->fingerprint[next].low & mask);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            fingerprints->fingerprint[hole] = fingerprints->fingerprint[next];
+            fingerprints->block[hole] = fingerprints->block[next];
+            hole = next;
+        }
+    }
+    fingerprints->block[hole] = SIMFS_INVALID_INDEX;
+}
 
-    struct timespec time;
-    clock_gettime(CLOCK_MONOTONIC, &time);
-    simfsVolume->block[0].content.fileDescriptor.creationTime = time.tv_sec;
-    simfsVolume->block[0].content.fileDescriptor.lastAccessTime = time.tv_sec;
-    simfsVolume->block[0].content.fileDescriptor.lastModificationTime = time.tv_sec;
+/***
+ * Returns a data block holding the given SIMFS_DATA_SIZE bytes of content: while deduplication is on, a block with
+ * the same content if the volume has one, with one more reference, and otherwise a new block. The content of a
+ * block found by its fingerprint is compared as well, so blocks are only shared if they are equal.
+ */
+static SIMFS_INDEX_TYPE takeDataBlock(const char *content)
+{
+    SIMFS_FINGERPRINT_TYPE key;
+    int slot = -1;
+    if (simfsContext->fingerprints != NULL) {
+        key = fingerprint(content, SIMFS_DATA_SIZE);
+        slot = fingerprintSlot(key);
+        SIMFS_INDEX_TYPE existing = simfsContext->fingerprints->block[slot];
+        if (existing != SIMFS_INVALID_INDEX && simfsContext->dataReferences[existing] < UINT16_MAX
+            && memcmp(simfsVolume->block[existing].content.data, content, SIMFS_DATA_SIZE) == 0) {
+            simfsContext->dataReferences[existing]++;
+            simfsStatsDeduplicated();
+            return existing;
+        }
+    }
 
-    // initialize the index block of the root folder
+    SIMFS_INDEX_TYPE data = allocateBlock(SIMFS_DATA_GROUP);
+    if (data == SIMFS_INVALID_INDEX)
+        return SIMFS_INVALID_INDEX;
 
-    // first, point from the root file descriptor to the index block
-    simfsVolume->block[0].content.fileDescriptor.block_ref = 1;
+    simfsVolume->block[data].type = SIMFS_DATA_CONTENT_TYPE;
+    memcpy(simfsVolume->block[data].content.data, content, SIMFS_DATA_SIZE);
+    simfsContext->dataReferences[data] = 1;
+    if (slot >= 0 && simfsContext->fingerprints->block[slot] == SIMFS_INVALID_INDEX) {
+        simfsContext->fingerprints->fingerprint[slot] = key;
+        simfsContext->fingerprints->block[slot] = data;
+    }
+    return data;
+}
 
-    simfsVolume->block[1].type = SIMFS_INDEX_CONTENT_TYPE;
+/***
+ * Drops a reference to a data block, and frees the block with its last reference.
+ */
+static void releaseDataBlock(SIMFS_INDEX_TYPE block)
+{
+    if (simfsContext->dataReferences[block] > 1) {
+        simfsContext->dataReferences[block]--;
+        return;
+    }
 
-    // indicate that the blocks #0 and #1 are allocated
+    simfsContext->dataReferences[block] = 0;
+    if (simfsContext->fingerprints != NULL)
+        unindexDataBlock(block);
+    freeBlock(block);
+}
 
-    // using the function to find a free block for testing purposes
-    simfsFlipBit(simfsVolume->bitvector, simfsFindFreeBlock(simfsVolume->bitvector)); // should be 0
-    simfsFlipBit(simfsVolume->bitvector, simfsFindFreeBlock(simfsVolume->bitvector)); // should be 1
+/***
+ * Counts the references to every data block from the index blocks of the volume.
+ */
+static void countDataReferences()
+{
+    memset(simfsContext->dataReferences, 0, sizeof(simfsContext->dataReferences));
+    for (int i = 0; i < SIMFS_NUMBER_OF_BLOCKS; i++) {
+        if (simfsVolume->block[i].type != SIMFS_INDEX_CONTENT_TYPE
+            || !(simfsContext->bitvector[i / 8] & (0x80 >> (i % 8))))
+            continue;
+
+        SIMFS_INDEX_TYPE *index = simfsVolume->block[i].content.index;
+        for (int j = 0; j < SIMFS_INDEX_SIZE - 1; j++) {
+            SIMFS_INDEX_TYPE data = index[j];
+            if (data != 0 && data < SIMFS_NUMBER_OF_BLOCKS && simfsContext->dataReferences[data] < UINT16_MAX)
+                simfsContext->dataReferences[data]++;
+        }
+    }
+}
 
-    // sample alternative #1 - illustration of bit-wise operations
-//    simfsVolume->bitvector[0] = 0;
-//    simfsVolume->bitvector[0] |= 0x01 << 7; // set the first bit of the bit vector
-//    simfsVolume->bitvector[0] += 0x80 >> 1; // flip the first bit of the bit vector
+/***
+ * Rebuilds the fingerprint index from the data blocks in use.
+ */
+static void indexDataBlocks()
+{
+    for (int i = 0; i < SIMFS_FINGERPRINT_INDEX_SIZE; i++)
+        simfsContext->fingerprints->block[i] = SIMFS_INVALID_INDEX;
+    for (int i = 0; i < SIMFS_NUMBER_OF_BLOCKS; i++)
+        if (simfsVolume->block[i].type == SIMFS_DATA_CONTENT_TYPE && simfsContext->dataReferences[i] > 0)
+            indexDataBlock(i);
+}
 
-    // sample alternative #2 - less educational, but fastest
-//     simfsVolume->bitvector[0] = 0xC0;
-    // 0xC0 is 11000000 in binary (showing the root block and root's index block taken)
+/***
+ * Frees a chain of index blocks together with the data blocks that only it refers to.
+ */
+static void freeIndexChain(SIMFS_INDEX_TYPE indexBlock)
+{
+    while (indexBlock != 0 && indexBlock != SIMFS_INVALID_INDEX)
+    {
+        SIMFS_INDEX_TYPE *index = simfsVolume->block[indexBlock].content.index;
+        for (int j = 0; j < SIMFS_INDEX_SIZE - 1; ++j)
+            if (index[j] != 0)
+                releaseDataBlock(index[j]);
+
+        SIMFS_INDEX_TYPE next = index[SIMFS_INDEX_SIZE - 1];
+        freeBlock(indexBlock);
+        indexBlock = next;
+    }
+}
 
-    fwrite(simfsVolume, 1, sizeof(SIMFS_VOLUME), file);
+static void syncBitvector()
+{
+    memcpy(simfsVolume->bitvector, simfsContext->bitvector, SIMFS_NUMBER_OF_BLOCKS / 8);
+}
 
-    fclose(file);
+static SIMFS_INDEX_TYPE *nextIndex(SIMFS_INDEX_TYPE *index)
+{
+    if (index[SIMFS_INDEX_SIZE - 1] == 0)
+        return NULL;
 
-    return SIMFS_NO_ERROR;
+    return simfsVolume->block[index[SIMFS_INDEX_SIZE - 1]].content.index;
 }
 
 /***
- * Loads the file system from a disk and constructs in-memory directory of all files is the system.
- *
- * Starting with the file system root (pointed to from the superblock) traverses the hierarchy of directories
- * and adds an entry for each folder or file to the directory by hashing the name and adding a directory
- * entry node to the conflict resolution list for that entry. If the entry is NULL, the new node will be
- * the only element of that list. If the list contains more than one element, then multiple files hashed to
- * the same value, so the unique file identifier can be used to determine which entry is applicable. The
- * identifier must be the same as the identifier in the file descriptor pointed to by the node reference.
- *
- * The function sets the current working directory to refer to the block holding the root of the volume. This will
- * be changed as the user navigates the file system hierarchy.
+ * Helpers for the directories of folders.
  *
+ * A name is stored with at most SIMFS_MAX_NAME_LENGTH - 1 characters, as in the file descriptor. Its hash selects
+ * the bucket and is kept in the record, so most records of a bucket are skipped without comparing names.
  */
+#define RECORD_SIZE(nameLength) (sizeof(SIMFS_DIRECTORY_RECORD_TYPE) + (nameLength))
 
-SIMFS_DIR_ENT* findEmptyHash(char* fileName){
-    SIMFS_INDEX_TYPE index = hash((unsigned char*)fileName);
-    SIMFS_DIR_ENT* hashed = simfsContext->directory[index];
-    if (hashed == NULL) {
-        hashed = malloc(sizeof(SIMFS_DIR_ENT));
-        hashed->next = NULL;
-        hashed->nodeReference = SIMFS_INVALID_INDEX;
-        hashed->globalOpenFileTableIndex = -1;
-        hashed->uniqueFileIdentifier = -1;
-        simfsContext->directory[index] = hashed;
-        return hashed;
-    }
-    while (hashed->next != NULL){
-        hashed = hashed->next;
-    }
-    hashed->next = malloc(sizeof(SIMFS_DIR_ENT));
-    hashed = hashed->next;
-    hashed->next = NULL;
-    return hashed;
+static int nameLength(char *name)
+{
+    return strnlen(name, SIMFS_MAX_NAME_LENGTH - 1);
 }
 
-void recursiveHashing(SIMFS_INDEX_TYPE* index){
+static uint32_t nameHash(char *name, int length)
+{
+    uint32_t hash = 5381;
+    for (int i = 0; i < length; i++)
+        hash = ((hash << 5) + hash) ^ (unsigned char) name[i];
+    return hash;
+}
 
-    while (true){
-        for (int i = 0; i < 6; ++i) {
-            if(simfsVolume->block[index[i]].type != SIMFS_INVALID_CONTENT_TYPE)
-                findEmptyHash(simfsVolume->block[index[i]].content.fileDescriptor.name);
-        }
+static SIMFS_INDEX_TYPE *directoryBucket(SIMFS_INDEX_TYPE folder, uint32_t hash)
+{
+    SIMFS_INDEX_TYPE root = simfsVolume->block[folder].content.fileDescriptor.block_ref;
+    return &simfsVolume->block[root].content.bucket[hash % SIMFS_DIRECTORY_BUCKETS];
+}
 
-        if(index[6]==0 || simfsVolume->block[index[6]].type == SIMFS_INVALID_CONTENT_TYPE) {
-            break;
-        } else{
-            index = simfsVolume->block[index[6]].content.index;
-        }
+static SIMFS_DIRECTORY_RECORD_TYPE *leafRecord(SIMFS_INDEX_TYPE leaf, int offset)
+{
+    return (SIMFS_DIRECTORY_RECORD_TYPE *) &simfsVolume->block[leaf].content.leaf.records[offset];
+}
 
+/***
+ * Adds (delta 1) or removes (delta -1) a name hash to or from the name filter of a folder, if the folder has one.
+ * The counters are chosen by double hashing of the mixed hash.
+ */
+static void updateNameFilter(SIMFS_INDEX_TYPE folder, uint32_t hash, int delta)
+{
+    SIMFS_NAME_FILTER_TYPE *filter = simfsContext->nameFilter[folder];
+    if (filter == NULL)
+        return;
+
+    uint32_t probe = hash * 0x9E3779B1u, step = (hash * 0x85EBCA6Bu) | 1;
+    for (int i = 0; i < SIMFS_NAME_FILTER_PROBES; i++, probe += step) {
+        uint8_t *counter = &filter->counter[probe >> (32 - SIMFS_NAME_FILTER_BITS)];
+        if (*counter != UINT8_MAX) // a saturated counter no longer knows how many names it counts
+            *counter += delta;
     }
 }
 
-SIMFS_ERROR simfsMountFileSystem(char *simfsFileName)
+static void freeNameFilter(SIMFS_INDEX_TYPE folder)
 {
+    free(simfsContext->nameFilter[folder]);
+    simfsContext->nameFilter[folder] = NULL;
+}
 
-    if (simfsContext == NULL)
-        return SIMFS_ALLOC_ERROR;
-
-    simfsVolume = malloc(sizeof(SIMFS_VOLUME));
-    if (simfsVolume == NULL)
-        return SIMFS_ALLOC_ERROR;
-
-    FILE *file = fopen(simfsFileName, "rb");
-    if (file == NULL)
-        return SIMFS_ALLOC_ERROR;
-
-    fread(simfsVolume, 1, sizeof(SIMFS_VOLUME), file);
-    fclose(file);
+/***
+ * Returns the record of a name in a folder's directory, or NULL if the folder holds no such name. If the parameter
+ * link is given, it receives the reference to the leaf holding the record, from the root or from the previous leaf.
+ */
+static SIMFS_DIRECTORY_RECORD_TYPE *findRecord(SIMFS_INDEX_TYPE folder, char *name, SIMFS_INDEX_TYPE **link)
+{
+    int length = nameLength(name);
+    uint32_t hash = nameHash(name, length);
+
+    for (SIMFS_INDEX_TYPE *leaf = directoryBucket(folder, hash); *leaf != 0;
+         leaf = &simfsVolume->block[*leaf].content.leaf.next) {
+        int used = simfsVolume->block[*leaf].content.leaf.used;
+        for (int offset = 0; offset < used;) {
+            SIMFS_DIRECTORY_RECORD_TYPE *record = leafRecord(*leaf, offset);
+            if (record->hash == hash >> 16 && record->nameLength == length
+                && memcmp(record->name, name, length) == 0) {
+                if (link != NULL)
+                    *link = leaf;
+                return record;
+            }
+            offset += RECORD_SIZE(record->nameLength);
+        }
+    }
+    return NULL;
+}
 
-    // TODO: complete
-    simfsContext->processControlBlocks = malloc(sizeof(SIMFS_PROCESS_CONTROL_BLOCK_TYPE));
+/***
+ * Adds the record of a child to a folder's directory; the record goes to the first leaf of its bucket with room
+ * for it, or to a new leaf in front of the others. Returns false if no block could be allocated for the leaf.
+ */
+static bool addRecord(SIMFS_INDEX_TYPE folder, char *name, SIMFS_INDEX_TYPE node)
+{
+    int length = nameLength(name);
+    uint32_t hash = nameHash(name, length);
+    SIMFS_INDEX_TYPE *bucket = directoryBucket(folder, hash);
+
+    SIMFS_INDEX_TYPE leaf = *bucket;
+    while (leaf != 0 && simfsVolume->block[leaf].content.leaf.used + RECORD_SIZE(length) > SIMFS_DIRECTORY_LEAF_SIZE)
+        leaf = simfsVolume->block[leaf].content.leaf.next;
+
+    if (leaf == 0) {
+        leaf = allocateBlock(SIMFS_METADATA_GROUP);
+        if (leaf == SIMFS_INVALID_INDEX)
+            return false;
+
+        simfsVolume->block[leaf].type = SIMFS_DIRECTORY_CONTENT_TYPE;
+        memset(&simfsVolume->block[leaf].content.leaf, 0, sizeof(SIMFS_DIRECTORY_LEAF_TYPE));
+        simfsVolume->block[leaf].content.leaf.next = *bucket;
+        *bucket = leaf;
+    }
 
-    simfsContext->processControlBlocks->currentWorkingDirectory = simfsVolume->superblock.attr.rootNodeIndex;
-    SIMFS_DIR_ENT* hash = findEmptyHash(simfsFileName);
-    hash->uniqueFileIdentifier = simfsVolume->superblock.attr.nextUniqueIdentifier;
-    simfsVolume->superblock.attr.nextUniqueIdentifier++;
-    hash->nodeReference = simfsContext->processControlBlocks->currentWorkingDirectory;
-    memcpy(simfsContext->bitvector, simfsVolume->bitvector, 512);
-    recursiveHashing(simfsVolume->block[simfsContext->processControlBlocks->currentWorkingDirectory].content.index);
-    return SIMFS_NO_ERROR;
+    SIMFS_DIRECTORY_LEAF_TYPE *content = &simfsVolume->block[leaf].content.leaf;
+    SIMFS_DIRECTORY_RECORD_TYPE *record = leafRecord(leaf, content->used);
+    record->node = node;
+    record->hash = hash >> 16;
+    record->nameLength = length;
+    memcpy(record->name, name, length);
+    content->used += RECORD_SIZE(length);
+    updateNameFilter(folder, hash, 1);
+
+    simfsVolume->block[folder].content.fileDescriptor.size++;
+    simfsContext->folderGeneration[folder]++;
+    return true;
 }
 
 /***
- * Saves the file system to a disk and de-allocates the memory.
- *
- * Assumes that all synchronization has been done.
- *
+ * Removes the record of a name from a folder's directory; a leaf left empty is freed.
  */
-SIMFS_ERROR simfsUmountFileSystem(char *simfsFileName)
+static void removeRecord(SIMFS_INDEX_TYPE folder, char *name)
 {
-    FILE *file = fopen(simfsFileName, "wb");
-    if (file == NULL)
-        return SIMFS_ALLOC_ERROR;
+    SIMFS_INDEX_TYPE *link;
+    SIMFS_DIRECTORY_RECORD_TYPE *record = findRecord(folder, name, &link);
+    if (record == NULL)
+        return;
+
+    updateNameFilter(folder, nameHash(record->name, record->nameLength), -1);
+
+    SIMFS_INDEX_TYPE leaf = *link;
+    SIMFS_DIRECTORY_LEAF_TYPE *content = &simfsVolume->block[leaf].content.leaf;
+    int offset = (unsigned char *) record - content->records, size = RECORD_SIZE(record->nameLength);
+    memmove(&content->records[offset], &content->records[offset + size], content->used - offset - size);
+    content->used -= size;
+
+    if (content->used == 0) {
+        *link = content->next;
+        freeBlock(leaf);
+    }
 
-    fwrite(simfsVolume, 1, sizeof(SIMFS_VOLUME), file);
-    fclose(file);
+    simfsVolume->block[folder].content.fileDescriptor.size--;
+    simfsContext->folderGeneration[folder]++;
+}
 
-    free(simfsVolume);
-    free(simfsContext);
+static SIMFS_INDEX_TYPE allocateDirectory()
+{
+    SIMFS_INDEX_TYPE i = allocateBlock(SIMFS_METADATA_GROUP);
+    if (i == SIMFS_INVALID_INDEX)
+        return SIMFS_INVALID_INDEX;
 
-    return SIMFS_NO_ERROR;
+    simfsVolume->block[i].type = SIMFS_DIRECTORY_CONTENT_TYPE;
+    memset(simfsVolume->block[i].content.bucket, 0, sizeof(simfsVolume->block[i].content.bucket));
+    return i;
 }
 
-//////////////////////////////////////////////////////////////////////////
+static void freeDirectory(SIMFS_INDEX_TYPE root)
+{
+    for (int i = 0; i < SIMFS_DIRECTORY_BUCKETS; i++) {
+        SIMFS_INDEX_TYPE leaf = simfsVolume->block[root].content.bucket[i];
+        while (leaf != 0) {
+            SIMFS_INDEX_TYPE next = simfsVolume->block[leaf].content.leaf.next;
+            freeBlock(leaf);
+            leaf = next;
+        }
+    }
+    freeBlock(root);
+}
 
 /***
- * Depending on the type parameter the function creates a file or a folder in the current directory
- * of the process. If the process does not have an entry in the processControlBlock, then the root directory
- * is assumed to be its current working directory.
- *
- * If a file with the same name already exists in the current directory, it returns SIMFS_DUPLICATE_ERROR.
- *
- * Otherwise:
- *    - set the folder/file's identifier to the current value of the next unique identifier from the superblock;
- *      then it increments the next available value in the superblock (to prepare it for the next created file)
- *    - finds an available block in the storage using the in-memory bitvector and flips the bit to indicate
- *      that the block is taken
- *    - initializes a local buffer for the file descriptor block with the block type depending on the parameter type
- *      (i.e., folder or file)
- *    - creates an entry in the conflict resolution list for the corresponding in-memory directory entry
- *    - copies the local buffer to the disk block that was found to be free
- *    - copies the in-memory bitvector to the bitevector blocks on the simulated disk
- *
- *  The access rights and the the owner are taken from the context (umask and uid correspondingly).
- *
+ * Position in a walk over all records of a folder's directory, bucket by bucket.
  */
+struct directoryCursor {
+    SIMFS_INDEX_TYPE root;
+    int bucket; // the next bucket to enter
+    SIMFS_INDEX_TYPE leaf; // 0 between buckets
+    int offset;
+};
 
+static void startDirectoryWalk(struct directoryCursor *cursor, SIMFS_INDEX_TYPE folder)
+{
+    cursor->root = simfsVolume->block[folder].content.fileDescriptor.block_ref;
+    cursor->bucket = 0;
+    cursor->leaf = 0;
+    cursor->offset = 0;
+}
 
-
-void findEndOfIndex(SIMFS_INDEX_TYPE** index){
-    do{
-        for (int j = 0; j < 6; ++j) {
-            if (*index[j] == 0) {
-                return;
+static SIMFS_DIRECTORY_RECORD_TYPE *nextRecord(struct directoryCursor *cursor)
+{
+    while (true) {
+        if (cursor->leaf != 0) {
+            if (cursor->offset < simfsVolume->block[cursor->leaf].content.leaf.used) {
+                SIMFS_DIRECTORY_RECORD_TYPE *record = leafRecord(cursor->leaf, cursor->offset);
+                cursor->offset += RECORD_SIZE(record->nameLength);
+                return record;
             }
+            cursor->leaf = simfsVolume->block[cursor->leaf].content.leaf.next;
+            cursor->offset = 0;
+            continue;
         }
-        if(index[6] != 0) {
-            *index = simfsVolume->block[*index[6]].content.index;
-        } else{
-            *index = simfsVolume->block[simfsFindFreeBlock(simfsVolume->bitvector)].content.index;
-            simfsVolume->bitvector[*index[0]] = 1;
-        }
-    }while (index[6] != 0);
-}
 
-struct ffret{
-    SIMFS_INDEX_TYPE* index;
-    short number;
-};
+        if (cursor->bucket >= SIMFS_DIRECTORY_BUCKETS)
+            return NULL;
+        cursor->leaf = simfsVolume->block[cursor->root].content.bucket[cursor->bucket++];
+    }
+}
 
-struct ffret* findFile(SIMFS_NAME_TYPE fileName){
-    SIMFS_INDEX_TYPE* index = simfsVolume->block[simfsContext->processControlBlocks->currentWorkingDirectory].content.index;
-    while (true){
-        for (int j = 0; j < 6; ++j) {
-            if (index[j] != 0
-            && (simfsVolume->block[index[j]].type == SIMFS_FOLDER_CONTENT_TYPE
-            || simfsVolume->block[index[j]].type == SIMFS_FILE_CONTENT_TYPE)
-            && strcmp(simfsVolume->block[index[j]].content.fileDescriptor.name, fileName) == 0) {
-                struct ffret *ret = malloc(sizeof(ret));
-                ret->index = index;
-                ret->number = j;
-                return ret;
-            }
-        }
-        if(index[6] != 0){
-            index = simfsVolume->block[index[6]].content.index;
-        } else{
-            break;
-        }
+/***
+ * Returns false if a folder certainly holds no child with the name hash. The folder's name filter is built from its
+ * directory the first time it is asked; if there is no memory for it, the answer is always true.
+ */
+static bool mayHoldName(SIMFS_INDEX_TYPE folder, uint32_t hash)
+{
+    SIMFS_NAME_FILTER_TYPE *filter = simfsContext->nameFilter[folder];
+    if (filter == NULL) {
+        filter = calloc(1, sizeof(SIMFS_NAME_FILTER_TYPE));
+        if (filter == NULL)
+            return true;
+        simfsContext->nameFilter[folder] = filter;
+
+        struct directoryCursor cursor;
+        startDirectoryWalk(&cursor, folder);
+        for (SIMFS_DIRECTORY_RECORD_TYPE *record = nextRecord(&cursor); record != NULL; record = nextRecord(&cursor))
+            updateNameFilter(folder, nameHash(record->name, record->nameLength), 1);
     }
-    return NULL;
- }
 
+    uint32_t probe = hash * 0x9E3779B1u, step = (hash * 0x85EBCA6Bu) | 1;
+    for (int i = 0; i < SIMFS_NAME_FILTER_PROBES; i++, probe += step)
+        if (filter->counter[probe >> (32 - SIMFS_NAME_FILTER_BITS)] == 0)
+            return false;
+    return true;
+}
 
-SIMFS_ERROR simfsCreateFile(SIMFS_NAME_TYPE fileName, SIMFS_CONTENT_TYPE type) {
-    // TODO: implement
+//////////////////////////////////////////////////////////////////////////
 
-    if(findFile(fileName) != NULL){
-        return SIMFS_DUPLICATE_ERROR;
+static void initSlab(SIMFS_SLAB_TYPE *slab, size_t objectSize)
+{
+    slab->objectSize = (objectSize + sizeof(max_align_t) - 1) / sizeof(max_align_t) * sizeof(max_align_t);
+    slab->freeList = NULL;
+    slab->arenas = NULL;
+    slab->used = SIMFS_SLAB_ARENA_OBJECTS; // there is no arena to carve out of yet
+}
+
+/***
+ * Takes an object from the free list of the slab, or from its newest arena; a new arena is only allocated when
+ * the newest one is used up. Returns NULL if there is no memory for it.
+ */
+static void *slabAllocate(SIMFS_SLAB_TYPE *slab)
+{
+    void *object = slab->freeList;
+    if (object != NULL) {
+        slab->freeList = *(void **) object;
+        return object;
     }
 
-    SIMFS_INDEX_TYPE *index = simfsVolume->block[simfsContext->processControlBlocks->currentWorkingDirectory].content.index;
-    int i = simfsFindFreeBlock(simfsVolume->bitvector);
-    simfsFlipBit(simfsVolume->bitvector, i);
+    if (slab->used == SIMFS_SLAB_ARENA_OBJECTS) {
+        SIMFS_SLAB_ARENA_TYPE *arena = malloc(sizeof(SIMFS_SLAB_ARENA_TYPE)
+                                              + SIMFS_SLAB_ARENA_OBJECTS * slab->objectSize);
+        if (arena == NULL)
+            return NULL;
 
-    findEndOfIndex(&index);
+        arena->next = slab->arenas;
+        slab->arenas = arena;
+        slab->used = 0;
+    }
 
-    for (int j = 0; j < 6; ++j) {
-        if(index[j] == 0){
-            index[j] = i;
+    return (unsigned char *) slab->arenas->objects + slab->used++ * slab->objectSize;
+}
 
-            simfsVolume->block[i].type = SIMFS_FILE_CONTENT_TYPE;
-            simfsVolume->block[i].content.fileDescriptor.type = type;
-            strcpy(simfsVolume->block[i].content.fileDescriptor.name, fileName);
-            simfsVolume->block[i].content.fileDescriptor.accessRights = simfsContext->globalOpenFileTable->accessRights;
-            simfsVolume->block[i].content.fileDescriptor.identifier = simfsVolume->superblock.attr.nextUniqueIdentifier;
-            SIMFS_DIR_ENT* hash = findEmptyHash(fileName);
-            hash->uniqueFileIdentifier = simfsVolume->block[i].content.fileDescriptor.identifier;
-            hash->nodeReference = simfsVolume->block[i].content.fileDescriptor.block_ref;
+static void slabFree(SIMFS_SLAB_TYPE *slab, void *object)
+{
+    *(void **) object = slab->freeList;
+    slab->freeList = object;
+}
+
+/***
+ * Frees the arenas of the slab, and with them all objects allocated from it.
+ */
+static void destroySlab(SIMFS_SLAB_TYPE *slab)
+{
+    while (slab->arenas != NULL) {
+        SIMFS_SLAB_ARENA_TYPE *arena = slab->arenas;
+        slab->arenas = arena->next;
+        free(arena);
+    }
+}
+
+/***
+ * Frees the decompressed content of a file together with the older content linked to it.
+ */
+static void freePlainContent(SIMFS_PLAIN_CONTENT_TYPE *plain)
+{
+    while (plain != NULL) {
+        SIMFS_PLAIN_CONTENT_TYPE *next = plain->next;
+        free(plain);
+        plain = next;
+    }
+}
+
+/***
+ * Allocates an empty in-memory context.
+ */
+static SIMFS_CONTEXT_TYPE *createContext()
+{
+    SIMFS_CONTEXT_TYPE *context = malloc(sizeof(SIMFS_CONTEXT_TYPE));
+    if (context == NULL)
+        return NULL;
+
+    for (int i = 0; i < SIMFS_MAX_NUMBER_OF_OPEN_FILES; i++)
+        context->globalOpenFileTable[i].type = SIMFS_INVALID_CONTENT_TYPE;  // indicates  empty slot
+
+    for (int i = 0; i < SIMFS_DIRECTORY_SIZE; i++)
+        context->directory[i] = NULL;
+
+    memset(context->bitvector, 0, SIMFS_NUMBER_OF_BLOCKS / 8);
+    memset(context->dataReferences, 0, sizeof(context->dataReferences));
+    context->fingerprints = NULL; // deduplication is off
+
+    context->processControlBlocks = NULL;
+
+    memset(context->dentryCache, 0, sizeof(context->dentryCache));
+    for (int i = 0; i < SIMFS_NUMBER_OF_BLOCKS; i++) {
+        context->folderGeneration[i] = 1;
+        context->nameFilter[i] = NULL;
+    }
+
+    initSlab(&context->directoryEntries, sizeof(SIMFS_DIR_ENT));
+    initSlab(&context->processes, sizeof(SIMFS_PROCESS_CONTROL_BLOCK_TYPE));
+
+    return context;
+}
+
+/***
+ * Frees the in-memory context together with the directory entries and process control blocks hanging off it;
+ * those are freed with the arenas of their slabs, without walking the hash chains and the list of processes.
+ */
+static void destroyContext(SIMFS_CONTEXT_TYPE *context)
+{
+    for (int i = 0; i < SIMFS_MAX_NUMBER_OF_OPEN_FILES; i++) {
+        if (context->globalOpenFileTable[i].type != SIMFS_INVALID_CONTENT_TYPE) {
+            freePlainContent(context->globalOpenFileTable[i].plainContent);
+            freePlainContent(context->globalOpenFileTable[i].retiredPlainContent);
+        }
+    }
+
+    destroySlab(&context->directoryEntries);
+    destroySlab(&context->processes);
+
+    for (int i = 0; i < SIMFS_NUMBER_OF_BLOCKS; i++)
+        free(context->nameFilter[i]);
+
+    free(context->fingerprints);
+    free(context);
+}
+
+static SIMFS_ERROR transferVolume(char *simfsFileName, SIMFS_IO_OPERATION_TYPE operation);
+
+/***
+ * Allocates space for the file system and saves it to disk, striped across the image files if several are named.
+ *
+ * A volume mounted on the instance is discarded without being saved, as mounting another one would.
+ */
+SIMFS_ERROR simfsCreateFileSystem(char *simfsFileName)
+{
+    if (simfsContext != NULL)
+        destroyContext(simfsContext);
+    free(simfsVolume);
+    simfsVolume = NULL;
+
+    // --- create the OS context ---
+
+    printf("Size of SIMFS_CONTEXT_TYPE: %ld\n", sizeof(SIMFS_CONTEXT_TYPE));
+    simfsContext = createContext();
+    if (simfsContext == NULL)
+        return SIMFS_ALLOC_ERROR;
+
+    // --- create the volume ---
+
+    printf("Size of SIMFS_VOLUME: %ld\n", sizeof(SIMFS_VOLUME));
+    simfsVolume = malloc(sizeof(SIMFS_VOLUME));
+    if (simfsVolume == NULL) {
+        destroyContext(simfsContext);
+        simfsContext = NULL;
+        return SIMFS_ALLOC_ERROR;
+    }
+
+    // initialize the superblock
+
+    simfsVolume->superblock.attr.nextUniqueIdentifier = SIMFS_INITIAL_VALUE_OF_THE_UNIQUE_FILE_IDENTIFIER;
+    simfsVolume->superblock.attr.rootNodeIndex = SIMFS_ROOT_NODE_INDEX;
+    simfsVolume->superblock.attr.blockSize = SIMFS_BLOCK_SIZE;
+    simfsVolume->superblock.attr.numberOfBlocks = SIMFS_NUMBER_OF_BLOCKS;
+    simfsVolume->superblock.attr.stripeCount = 1; // set to the number of image files when the volume is written
+    simfsVolume->superblock.attr.stripeBlocks = SIMFS_STRIPE_BLOCKS;
+    simfsVolume->superblock.attr.stripeIndex = 0;
+
+    // initialize the bitvector
+
+    memset(simfsVolume->bitvector, 0, SIMFS_NUMBER_OF_BLOCKS / 8);
+
+    // mark all blocks as unused
+
+    for (int i = 0; i < SIMFS_NUMBER_OF_BLOCKS; i++)
+    {
+        simfsVolume->block[i].type = SIMFS_INVALID_CONTENT_TYPE;
+        memset(&simfsVolume->block[i].content, 0, sizeof(simfsVolume->block[i].content));
+    }
+
+    // initialize the blocks holding the root folder
+
+    // initialize the root folder
+
+    simfsVolume->block[0].type = SIMFS_FOLDER_CONTENT_TYPE;
+    // root folder always has "0" as the identifier
+    simfsVolume->block[0].content.fileDescriptor.identifier = simfsVolume->superblock.attr.nextUniqueIdentifier++;
+    simfsVolume->block[0].content.fileDescriptor.type = SIMFS_FOLDER_CONTENT_TYPE;
+    strcpy(simfsVolume->block[0].content.fileDescriptor.name, "/");
+    simfsVolume->block[0].content.fileDescriptor.accessRights = umask(00000);
+    simfsVolume->block[0].content.fileDescriptor.owner = 0; // arbitrarily simulated
+    simfsVolume->block[0].content.fileDescriptor.size = 0;
+
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    simfsVolume->block[0].content.fileDescriptor.creationTime = time.tv_sec;
+    simfsVolume->block[0].content.fileDescriptor.lastAccessTime = time.tv_sec;
+    simfsVolume->block[0].content.fileDescriptor.lastModificationTime = time.tv_sec;
+
+    // initialize the directory of the root folder
+
+    // first, point from the root file descriptor to the root block of the directory
+    simfsVolume->block[0].content.fileDescriptor.block_ref = 1;
+
+    simfsVolume->block[1].type = SIMFS_DIRECTORY_CONTENT_TYPE;
+    memset(simfsVolume->block[1].content.bucket, 0, sizeof(simfsVolume->block[1].content.bucket));
+
+    // indicate that the blocks #0 and #1 are allocated
+
+    // using the function to find a free block for testing purposes
+    simfsFlipBit(simfsVolume->bitvector, simfsFindFreeBlock(simfsVolume->bitvector)); // should be 0
+    simfsFlipBit(simfsVolume->bitvector, simfsFindFreeBlock(simfsVolume->bitvector)); // should be 1
+
+    // sample alternative #1 - illustration of bit-wise operations
+//    simfsVolume->bitvector[0] = 0;
+//    simfsVolume->bitvector[0] |= 0x01 << 7; // set the first bit of the bit vector
+//    simfsVolume->bitvector[0] += 0x80 >> 1; // flip the first bit of the bit vector
+
+    // sample alternative #2 - less educational, but fastest
+//     simfsVolume->bitvector[0] = 0xC0;
+    // 0xC0 is 11000000 in binary (showing the root block and root's index block taken)
+
+    return transferVolume(simfsFileName, SIMFS_IO_WRITE);
+}
+
+//
+// one image file of a volume being read or written by transferStripe
+//
+struct stripeTransfer {
+    SIMFS_VOLUME *volume; // of the instance that transfers it, which other threads do not work on
+    int file;
+    int member; // the position of the file in the stripe set
+    int stripeCount;
+    size_t stripeBlocks;
+    SIMFS_IO_OPERATION_TYPE operation;
+    SIMFS_SUPERBLOCK_TYPE superblock; // written to the file; it records the position of the file
+    unsigned long damagedBlocks; // read with a checksum that does not match the table; 1 for a damaged header
+    SIMFS_ERROR result;
+};
+
+/***
+ * Computes the checksum table of one image file: the checksum of the superblock of the file and the bitvector,
+ * followed by the checksums of the blocks of the file in the order in which they are stored in it. Without a
+ * superblock, the first entry is left alone.
+ */
+static void checksumStripe(struct stripeTransfer *transfer, SIMFS_SUPERBLOCK_TYPE *superblock, uint32_t *table)
+{
+    if (superblock != NULL)
+        table[0] = simfsCrc32c(simfsCrc32c(0, superblock, sizeof(SIMFS_SUPERBLOCK_TYPE)), transfer->volume->bitvector,
+                               sizeof(transfer->volume->bitvector));
+
+    int position = 1;
+    for (size_t first = transfer->member * transfer->stripeBlocks; first < SIMFS_NUMBER_OF_BLOCKS;
+         first += transfer->stripeCount * transfer->stripeBlocks) {
+        int count = (SIMFS_NUMBER_OF_BLOCKS - first < transfer->stripeBlocks ? SIMFS_NUMBER_OF_BLOCKS - first
+                                                                              : transfer->stripeBlocks);
+        simfsCrc32cBlocks(&transfer->volume->block[first], sizeof(SIMFS_BLOCK_TYPE), count, &table[position]);
+        position += count;
+    }
+}
+
+/***
+ * Reads or writes the superblock and bitvector, the stripe units and the checksum table of one image file through
+ * an I/O engine of its own, keeping up to SIMFS_IO_DEFAULT_QUEUE_DEPTH chunks of at most SIMFS_IO_CHUNK_SIZE bytes
+ * in flight. A write is followed by an fsync, so the file is on the disk when unmounting returns. Every file is
+ * written with a copy of the superblock and the bitvector, but they are only read from the first one.
+ *
+ * The checksum table is computed before writing, and the blocks read are checked against it once they are all in;
+ * a file without a table, written before checksums were kept, is read unchecked.
+ *
+ * Runs as the start routine of a thread per image file; the outcome is left in the result of the transfer.
+ */
+static void *transferStripe(void *argument)
+{
+    struct stripeTransfer *transfer = argument;
+
+    // the extents of the file: the superblock and the bitvector, then every stripeCount-th unit from the member-th,
+    // then the checksum table
+    size_t header = offsetof(SIMFS_VOLUME, block), unitSize = transfer->stripeBlocks * sizeof(SIMFS_BLOCK_TYPE);
+    size_t units = (SIMFS_NUMBER_OF_BLOCKS + transfer->stripeBlocks - 1) / transfer->stripeBlocks;
+    size_t blocks = 0;
+    for (size_t u = transfer->member; u < units; u += transfer->stripeCount)
+        blocks += (SIMFS_NUMBER_OF_BLOCKS - u * transfer->stripeBlocks < transfer->stripeBlocks
+                   ? SIMFS_NUMBER_OF_BLOCKS - u * transfer->stripeBlocks : transfer->stripeBlocks);
+    off_t tableOffset = header + blocks * sizeof(SIMFS_BLOCK_TYPE);
+    size_t tableSize = (1 + blocks) * sizeof(uint32_t);
+
+    uint32_t *table = malloc(tableSize), *computed = malloc(tableSize);
+    SIMFS_IO_ENGINE_TYPE *engine = (table == NULL || computed == NULL ? NULL
+                                    : simfsIoOpen(transfer->file, SIMFS_IO_DEFAULT_QUEUE_DEPTH, transfer->volume,
+                                                  sizeof(SIMFS_VOLUME)));
+    if (engine == NULL) {
+        free(table);
+        free(computed);
+        transfer->result = (table == NULL || computed == NULL ? SIMFS_ALLOC_ERROR : SIMFS_SYSTEM_ERROR);
+        return NULL;
+    }
+
+    SIMFS_ERROR error = SIMFS_NO_ERROR;
+    SIMFS_ERROR failure = (transfer->operation == SIMFS_IO_READ ? SIMFS_READ_ERROR : SIMFS_WRITE_ERROR);
+    bool checked = false;
+    if (transfer->operation == SIMFS_IO_WRITE) {
+        checksumStripe(transfer, &transfer->superblock, table);
+    } else {
+        ssize_t length = pread(transfer->file, table, tableSize, tableOffset);
+        checked = (length == (ssize_t) tableSize);
+        if (length != 0 && !checked)
+            error = failure; // a torn table
+    }
+
+    SIMFS_IO_REQUEST_TYPE requests[SIMFS_IO_DEFAULT_QUEUE_DEPTH];
+    SIMFS_IO_REQUEST_TYPE *idle[SIMFS_IO_DEFAULT_QUEUE_DEPTH];
+    SIMFS_IO_REQUEST_TYPE *completed[SIMFS_IO_DEFAULT_QUEUE_DEPTH];
+    int numberOfIdle = SIMFS_IO_DEFAULT_QUEUE_DEPTH;
+    for (int i = 0; i < SIMFS_IO_DEFAULT_QUEUE_DEPTH; i++)
+        idle[i] = &requests[i];
+
+    size_t unit = transfer->member, length = 0, done = 0;
+    int extent = (transfer->operation == SIMFS_IO_READ && transfer->member > 0 ? 2 : 0);
+    char *buffer = NULL;
+    off_t offset = 0;
+    bool more = (error == SIMFS_NO_ERROR), tableDone = (transfer->operation == SIMFS_IO_READ);
+
+    while (more || simfsIoInFlight(engine) > 0) {
+        while (more && numberOfIdle > 0) {
+            if (done == length) {
+                if (extent == 0) {
+                    buffer = (transfer->operation == SIMFS_IO_READ ? (char *) &transfer->volume->superblock
+                                                                   : (char *) &transfer->superblock);
+                    offset = offsetof(SIMFS_VOLUME, superblock);
+                    length = sizeof(SIMFS_SUPERBLOCK_TYPE);
+                } else if (extent == 1) {
+                    buffer = (char *) transfer->volume->bitvector;
+                    offset = offsetof(SIMFS_VOLUME, bitvector);
+                    length = sizeof(transfer->volume->bitvector);
+                } else if (unit < units) {
+                    size_t memory = header + unit * unitSize;
+                    buffer = (char *) transfer->volume + memory;
+                    offset = header + unit / transfer->stripeCount * unitSize;
+                    length = (sizeof(SIMFS_VOLUME) - memory < unitSize ? sizeof(SIMFS_VOLUME) - memory : unitSize);
+                    unit += transfer->stripeCount;
+                } else if (!tableDone) {
+                    buffer = (char *) table;
+                    offset = tableOffset;
+                    length = tableSize;
+                    tableDone = true;
+                } else {
+                    more = false;
+                    break;
+                }
+                extent++;
+                done = 0;
+            }
+
+            SIMFS_IO_REQUEST_TYPE *request = idle[--numberOfIdle];
+            request->operation = transfer->operation;
+            request->buffer = buffer + done;
+            request->length = (length - done < SIMFS_IO_CHUNK_SIZE ? length - done : SIMFS_IO_CHUNK_SIZE);
+            request->offset = offset + done;
+            if (simfsIoSubmit(engine, request) != SIMFS_NO_ERROR) {
+                idle[numberOfIdle++] = request;
+                break;
+            }
+            done += request->length;
+        }
+
+        int count = simfsIoWait(engine, completed, 1, SIMFS_IO_DEFAULT_QUEUE_DEPTH);
+        if (count < 0) {
+            error = SIMFS_SYSTEM_ERROR;
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            if (completed[i]->result != (ssize_t) completed[i]->length) {
+                error = failure;
+                more = false; // stop submitting, but collect what is in flight
+            }
+            idle[numberOfIdle++] = completed[i];
+        }
+    }
+
+    if (error == SIMFS_NO_ERROR && transfer->operation == SIMFS_IO_WRITE) {
+        requests[0].operation = SIMFS_IO_FSYNC;
+        requests[0].buffer = NULL;
+        requests[0].length = 0;
+        requests[0].offset = 0;
+        if (simfsIoSubmit(engine, &requests[0]) != SIMFS_NO_ERROR
+            || simfsIoWait(engine, completed, 1, 1) != 1 || completed[0]->result != 0)
+            error = failure;
+    }
+
+    // the superblock and the bitvector are only checked in the first file, the only one they are read from
+    if (error == SIMFS_NO_ERROR && checked) {
+        checksumStripe(transfer, transfer->member == 0 ? &transfer->volume->superblock : NULL, computed);
+        for (size_t i = (transfer->member == 0 ? 0 : 1); i < 1 + blocks; i++)
+            if (computed[i] != table[i])
+                transfer->damagedBlocks++;
+        if (transfer->damagedBlocks > 0)
+            error = SIMFS_READ_ERROR;
+    }
+
+    simfsIoClose(engine);
+    free(table);
+    free(computed);
+    transfer->result = error;
+    return NULL;
+}
+
+/***
+ * Reads the volume from, or writes it to, the image files named by simfsFileName, in parallel.
+ *
+ * Before reading, the superblocks of all files are checked to describe the same volume striped across as many files
+ * as are named. Writing stripes the volume across the files named, which need not be as many as it was read from.
+ */
+static SIMFS_ERROR transferVolume(char *simfsFileName, SIMFS_IO_OPERATION_TYPE operation)
+{
+    char *names = strdup(simfsFileName);
+    if (names == NULL)
+        return SIMFS_ALLOC_ERROR;
+
+    struct stripeTransfer transfers[SIMFS_MAX_STRIPES];
+    char separator[] = {SIMFS_STRIPE_SEPARATOR, '\0'};
+    char *rest;
+    int stripeCount = 0;
+    SIMFS_ERROR error = SIMFS_NO_ERROR;
+    for (char *name = strtok_r(names, separator, &rest); name != NULL; name = strtok_r(NULL, separator, &rest)) {
+        if (stripeCount == SIMFS_MAX_STRIPES) {
+            error = SIMFS_ALLOC_ERROR;
+            break;
+        }
+        transfers[stripeCount].file = (operation == SIMFS_IO_READ ? open(name, O_RDONLY)
+                                                                  : open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644));
+        if (transfers[stripeCount].file < 0) {
+            error = SIMFS_ALLOC_ERROR;
+            break;
+        }
+        stripeCount++;
+    }
+    free(names);
+    if (stripeCount == 0 && error == SIMFS_NO_ERROR)
+        error = SIMFS_ALLOC_ERROR;
+
+    struct attr *attributes = &simfsVolume->superblock.attr;
+    if (error == SIMFS_NO_ERROR && operation == SIMFS_IO_READ) {
+        SIMFS_SUPERBLOCK_TYPE first, other;
+        for (int i = 0; i < stripeCount && error == SIMFS_NO_ERROR; i++) {
+            SIMFS_SUPERBLOCK_TYPE *superblock = (i == 0 ? &first : &other);
+            if (pread(transfers[i].file, superblock, sizeof(SIMFS_SUPERBLOCK_TYPE), 0) != sizeof(SIMFS_SUPERBLOCK_TYPE))
+                error = SIMFS_READ_ERROR;
+            else if (first.attr.numberOfBlocks != SIMFS_NUMBER_OF_BLOCKS || first.attr.blockSize != SIMFS_BLOCK_SIZE)
+                error = SIMFS_READ_ERROR; // the volume was made by a build of another geometry
+            else if ((first.attr.stripeCount == 0 ? 1 : first.attr.stripeCount) != stripeCount)
+                error = SIMFS_READ_ERROR;
+            else if (stripeCount > 1 && superblock->attr.stripeIndex != i)
+                error = SIMFS_READ_ERROR; // the files are named in another order than they were written in
+            else if (i > 0 && (other.attr.nextUniqueIdentifier != first.attr.nextUniqueIdentifier
+                               || other.attr.stripeCount != first.attr.stripeCount
+                               || other.attr.stripeBlocks != first.attr.stripeBlocks))
+                error = SIMFS_READ_ERROR; // a file of another volume, or of an earlier unmount
+        }
+        if (error == SIMFS_NO_ERROR)
+            *attributes = first.attr; // for the layout; the first file is read over it
+    } else if (error == SIMFS_NO_ERROR) {
+        attributes->stripeCount = stripeCount;
+        if (attributes->stripeBlocks == 0)
+            attributes->stripeBlocks = SIMFS_STRIPE_BLOCKS;
+    }
+
+    if (error == SIMFS_NO_ERROR) {
+        // the first file is transferred by the calling thread, the others by threads of their own
+        pthread_t threads[SIMFS_MAX_STRIPES];
+        bool started[SIMFS_MAX_STRIPES] = {false};
+        for (int i = stripeCount - 1; i >= 0; i--) {
+            transfers[i].volume = simfsVolume;
+            transfers[i].member = i;
+            transfers[i].stripeCount = stripeCount;
+            transfers[i].stripeBlocks = (attributes->stripeBlocks == 0 ? SIMFS_NUMBER_OF_BLOCKS
+                                                                       : attributes->stripeBlocks);
+            transfers[i].operation = operation;
+            transfers[i].superblock = simfsVolume->superblock;
+            transfers[i].superblock.attr.stripeIndex = i;
+            transfers[i].damagedBlocks = 0;
+            if (i == 0 || pthread_create(&threads[i], NULL, transferStripe, &transfers[i]) != 0)
+                transferStripe(&transfers[i]);
+            else
+                started[i] = true;
+        }
+        for (int i = 0; i < stripeCount; i++) {
+            if (started[i])
+                pthread_join(threads[i], NULL);
+            if (error == SIMFS_NO_ERROR)
+                error = transfers[i].result;
+        }
+    }
+
+    for (int i = 0; i < stripeCount; i++)
+        close(transfers[i].file);
+    return error;
+}
+
+/***
+ * Loads the file system from a disk and constructs in-memory directory of all files is the system.
+ *
+ * Starting with the file system root (pointed to from the superblock) traverses the hierarchy of directories
+ * and adds an entry for each folder or file to the directory by hashing the name and adding a directory
+ * entry node to the conflict resolution list for that entry. If the entry is NULL, the new node will be
+ * the only element of that list. If the list contains more than one element, then multiple files hashed to
+ * the same value, so the unique file identifier can be used to determine which entry is applicable. The
+ * identifier must be the same as the identifier in the file descriptor pointed to by the node reference.
+ *
+ * The function sets the current working directory to refer to the block holding the root of the volume. This will
+ * be changed as the user navigates the file system hierarchy.
+ *
+ * The in-memory context is built from the image alone, so a volume can be mounted by a process that did not create
+ * it, and again after it has been unmounted. A volume that is mounted already is dropped without being saved. If the
+ * superblock describes a volume of another geometry than the one this build was compiled for, SIMFS_READ_ERROR is
+ * returned; after any error no volume is mounted.
+ */
+
+SIMFS_DIR_ENT* findEmptyHash(char* fileName){
+    SIMFS_INDEX_TYPE index = hash((unsigned char*)fileName);
+    SIMFS_DIR_ENT* entry = slabAllocate(&simfsContext->directoryEntries);
+    if (entry == NULL)
+        return NULL;
+    entry->next = NULL;
+    entry->nodeReference = SIMFS_INVALID_INDEX;
+    entry->globalOpenFileTableIndex = SIMFS_INVALID_OPEN_FILE_TABLE_INDEX;
+    entry->uniqueFileIdentifier = -1;
+
+    SIMFS_DIR_ENT* hashed = simfsContext->directory[index];
+    if (hashed == NULL) {
+        SIMFS_TRACE_INSTANT(SIMFS_TRACE_FIND_EMPTY_HASH, index, 0);
+        simfsContext->directory[index] = entry;
+        return entry;
+    }
+    int position = 1;
+    while (hashed->next != NULL){
+        hashed = hashed->next;
+        position++;
+    }
+    SIMFS_TRACE_INSTANT(SIMFS_TRACE_FIND_EMPTY_HASH, index, position);
+    hashed->next = entry;
+    return entry;
+}
+
+/***
+ * Finds the directory entry of the folder or file held in the given file descriptor block. Conflicts in the
+ * resolution list are resolved with the unique identifier of the file.
+ */
+static SIMFS_DIR_ENT *findDirEnt(SIMFS_INDEX_TYPE node)
+{
+    SIMFS_FILE_DESCRIPTOR_TYPE *descriptor = &simfsVolume->block[node].content.fileDescriptor;
+    SIMFS_DIR_ENT *entry = simfsContext->directory[hash((unsigned char *) descriptor->name)];
+    while (entry != NULL && entry->uniqueFileIdentifier != descriptor->identifier)
+        entry = entry->next;
+
+    return entry;
+}
+
+static void removeDirEnt(SIMFS_INDEX_TYPE node)
+{
+    SIMFS_FILE_DESCRIPTOR_TYPE *descriptor = &simfsVolume->block[node].content.fileDescriptor;
+    SIMFS_DIR_ENT **link = &simfsContext->directory[hash((unsigned char *) descriptor->name)];
+    while (*link != NULL && (*link)->uniqueFileIdentifier != descriptor->identifier)
+        link = &(*link)->next;
+
+    if (*link == NULL)
+        return;
+
+    SIMFS_DIR_ENT *entry = *link;
+    *link = entry->next;
+    slabFree(&simfsContext->directoryEntries, entry);
+}
+
+/***
+ * Adds the directory entries of the folders and files below a folder; returns false if there is no memory for them.
+ */
+bool recursiveHashing(SIMFS_INDEX_TYPE folder){
+    struct directoryCursor cursor;
+    startDirectoryWalk(&cursor, folder);
+    for (SIMFS_DIRECTORY_RECORD_TYPE *record = nextRecord(&cursor); record != NULL; record = nextRecord(&cursor)) {
+        SIMFS_FILE_DESCRIPTOR_TYPE *descriptor = &simfsVolume->block[record->node].content.fileDescriptor;
+        SIMFS_DIR_ENT *entry = findEmptyHash(descriptor->name);
+        if (entry == NULL)
+            return false;
+        entry->uniqueFileIdentifier = descriptor->identifier;
+        entry->nodeReference = record->node;
+
+        if (simfsVolume->block[record->node].type == SIMFS_FOLDER_CONTENT_TYPE && !recursiveHashing(record->node))
+            return false;
+    }
+    return true;
+}
+
+/***
+ * Fills the context of a volume that has just been read: the process control block, the bitvector, the references
+ * to the data blocks and the in-memory directory.
+ */
+static SIMFS_ERROR buildContext()
+{
+    simfsContext->processControlBlocks = slabAllocate(&simfsContext->processes);
+    if (simfsContext->processControlBlocks == NULL)
+        return SIMFS_ALLOC_ERROR;
+    simfsContext->processControlBlocks->pid = 0;
+    simfsContext->processControlBlocks->numberOfOpenFiles = 0;
+    for (int i = 0; i < SIMFS_MAX_NUMBER_OF_OPEN_FILES_PER_PROCESS; i++)
+        simfsContext->processControlBlocks->openFileTable[i].globalOpenFileTableIndex = SIMFS_INVALID_OPEN_FILE_TABLE_INDEX;
+    simfsContext->processControlBlocks->next = NULL;
+
+    SIMFS_INDEX_TYPE root = simfsVolume->superblock.attr.rootNodeIndex;
+    simfsContext->processControlBlocks->currentWorkingDirectory = root;
+    SIMFS_DIR_ENT* entry = findEmptyHash(simfsVolume->block[root].content.fileDescriptor.name);
+    if (entry == NULL)
+        return SIMFS_ALLOC_ERROR;
+    entry->uniqueFileIdentifier = simfsVolume->block[root].content.fileDescriptor.identifier;
+    entry->nodeReference = root;
+    memcpy(simfsContext->bitvector, simfsVolume->bitvector, sizeof(simfsContext->bitvector));
+    countDataReferences();
+    return (recursiveHashing(root) ? SIMFS_NO_ERROR : SIMFS_ALLOC_ERROR);
+}
+
+static SIMFS_ERROR mountFileSystem(char *simfsFileName);
+
+SIMFS_ERROR simfsMountFileSystem(char *simfsFileName)
+{
+    unsigned long long start = simfsStatsClock();
+    return simfsStatsRecord(SIMFS_STATS_MOUNT, start, mountFileSystem(simfsFileName));
+}
+
+static SIMFS_ERROR mountFileSystem(char *simfsFileName)
+{
+    if (simfsContext != NULL)
+        destroyContext(simfsContext);
+    free(simfsVolume);
+
+    simfsContext = createContext();
+    simfsVolume = malloc(sizeof(SIMFS_VOLUME));
+    SIMFS_ERROR error = (simfsContext == NULL || simfsVolume == NULL ? SIMFS_ALLOC_ERROR
+                                                                     : transferVolume(simfsFileName, SIMFS_IO_READ));
+    if (error == SIMFS_NO_ERROR && simfsVolume->superblock.attr.rootNodeIndex >= SIMFS_NUMBER_OF_BLOCKS)
+        error = SIMFS_READ_ERROR;
+    if (error == SIMFS_NO_ERROR)
+        error = buildContext();
+    if (error != SIMFS_NO_ERROR) {
+        if (simfsContext != NULL)
+            destroyContext(simfsContext);
+        free(simfsVolume);
+        simfsContext = NULL;
+        simfsVolume = NULL;
+        return error;
+    }
+    return SIMFS_NO_ERROR;
+}
+
+/***
+ * Saves the file system to a disk and de-allocates the memory.
+ *
+ * Assumes that all synchronization has been done.
+ *
+ */
+static SIMFS_ERROR umountFileSystem(char *simfsFileName);
+
+SIMFS_ERROR simfsUmountFileSystem(char *simfsFileName)
+{
+    unsigned long long start = simfsStatsClock();
+    return simfsStatsRecord(SIMFS_STATS_UMOUNT, start, umountFileSystem(simfsFileName));
+}
+
+static SIMFS_ERROR umountFileSystem(char *simfsFileName)
+{
+    SIMFS_TRACE_SAVE();
+
+    SIMFS_ERROR error = transferVolume(simfsFileName, SIMFS_IO_WRITE);
+    if (error != SIMFS_NO_ERROR)
+        return error;
+
+    free(simfsVolume);
+    destroyContext(simfsContext);
+    simfsVolume = NULL;
+    simfsContext = NULL;
+
+    return SIMFS_NO_ERROR;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+/***
+ * Depending on the type parameter the function creates a file or a folder in the current directory
+ * of the process. If the process does not have an entry in the processControlBlock, then the root directory
+ * is assumed to be its current working directory.
+ *
+ * If a file with the same name already exists in the current directory, it returns SIMFS_DUPLICATE_ERROR.
+ *
+ * Otherwise:
+ *    - set the folder/file's identifier to the current value of the next unique identifier from the superblock;
+ *      then it increments the next available value in the superblock (to prepare it for the next created file)
+ *    - finds an available block in the storage using the in-memory bitvector and flips the bit to indicate
+ *      that the block is taken
+ *    - initializes a local buffer for the file descriptor block with the block type depending on the parameter type
+ *      (i.e., folder or file)
+ *    - creates an entry in the conflict resolution list for the corresponding in-memory directory entry
+ *    - copies the local buffer to the disk block that was found to be free
+ *    - copies the in-memory bitvector to the bitevector blocks on the simulated disk
+ *
+ *  The access rights and the the owner are taken from the context (umask and uid correspondingly).
+ *
+ */
+
+
+
+/***
+ * Fills the file descriptor block of a new folder or file and adds its entry to the in-memory directory; returns
+ * false if there is no memory for the entry.
+ *
+ * The access rights and the owner are taken from the context (umask and uid correspondingly).
+ */
+static bool initDescriptor(SIMFS_INDEX_TYPE node, char *fileName, SIMFS_CONTENT_TYPE type, SIMFS_INDEX_TYPE blockRef)
+{
+    struct fuse_context *context = simfs_debug_get_context();
+    SIMFS_FILE_DESCRIPTOR_TYPE *descriptor = &simfsVolume->block[node].content.fileDescriptor;
+
+    simfsVolume->block[node].type = type;
+    descriptor->type = type;
+    descriptor->flags = 0;
+    memset(descriptor->reserved, 0, sizeof(descriptor->reserved));
+    descriptor->identifier = simfsVolume->superblock.attr.nextUniqueIdentifier++;
+    strncpy(descriptor->name, fileName, SIMFS_MAX_NAME_LENGTH - 1);
+    descriptor->name[SIMFS_MAX_NAME_LENGTH - 1] = '\0';
+    descriptor->accessRights = context->umask;
+    descriptor->owner = context->uid;
+    descriptor->size = 0;
+    descriptor->block_ref = blockRef;
+    descriptor->creationTime = descriptor->lastAccessTime = descriptor->lastModificationTime = time(NULL);
+
+    SIMFS_DIR_ENT* entry = findEmptyHash(descriptor->name);
+    if (entry == NULL)
+        return false;
+    entry->uniqueFileIdentifier = descriptor->identifier;
+    entry->nodeReference = node;
+    return true;
+}
+
+static SIMFS_ERROR deleteChild(SIMFS_INDEX_TYPE folder, SIMFS_INDEX_TYPE node);
+
+/***
+ * Looks up a name in a folder through the dentry cache. On a miss the folder's directory is searched, unless its name
+ * filter rules the name out, and the slot of the name is overwritten with the outcome, whether the name was found or
+ * not.
+ */
+static SIMFS_DENTRY_TYPE *lookupDentry(SIMFS_INDEX_TYPE folder, char *fileName)
+{
+    uint32_t hash = nameHash(fileName, nameLength(fileName));
+    uint32_t slot = (hash ^ folder * 0x9E3779B1u) & (SIMFS_DENTRY_CACHE_SIZE - 1);
+    SIMFS_DENTRY_TYPE *dentry = &simfsContext->dentryCache[slot];
+
+    // names are compared up to the length that is stored in the directory
+    bool hit = dentry->folder == folder && dentry->generation == simfsContext->folderGeneration[folder]
+               && strncmp(dentry->name, fileName, SIMFS_MAX_NAME_LENGTH - 1) == 0;
+    simfsStatsDentry(hit);
+    if (hit)
+        return dentry;
+
+    SIMFS_DIRECTORY_RECORD_TYPE *record = (mayHoldName(folder, hash) ? findRecord(folder, fileName, NULL) : NULL);
+    dentry->folder = folder;
+    dentry->node = (record != NULL ? record->node : SIMFS_INVALID_INDEX);
+    dentry->type = (record != NULL ? simfsVolume->block[record->node].type : SIMFS_INVALID_CONTENT_TYPE);
+    dentry->generation = simfsContext->folderGeneration[folder];
+    strncpy(dentry->name, fileName, SIMFS_MAX_NAME_LENGTH - 1);
+    dentry->name[SIMFS_MAX_NAME_LENGTH - 1] = '\0';
+    return dentry;
+}
+
+/***
+ * Returns the file descriptor block of the child of a folder with the given name, or SIMFS_INVALID_INDEX if the
+ * folder holds no such child.
+ */
+static SIMFS_INDEX_TYPE findChild(SIMFS_INDEX_TYPE folder, char *fileName)
+{
+    return lookupDentry(folder, fileName)->node;
+}
+
+static SIMFS_INDEX_TYPE findFile(SIMFS_NAME_TYPE fileName)
+{
+    SIMFS_INDEX_TYPE folder = simfsContext->processControlBlocks->currentWorkingDirectory;
+    SIMFS_TRACE_BEGIN(SIMFS_TRACE_FIND_FILE, folder, 0);
+    SIMFS_INDEX_TYPE node = findChild(folder, fileName);
+    SIMFS_TRACE_END(SIMFS_TRACE_FIND_FILE, folder, node);
+    return node;
+}
+
+
+static SIMFS_ERROR createFile(SIMFS_NAME_TYPE fileName, SIMFS_CONTENT_TYPE type);
+
+SIMFS_ERROR simfsCreateFile(SIMFS_NAME_TYPE fileName, SIMFS_CONTENT_TYPE type)
+{
+    unsigned long long start = simfsStatsClock();
+    return simfsStatsRecord(SIMFS_STATS_CREATE_FILE, start, createFile(fileName, type));
+}
+
+static SIMFS_ERROR createFile(SIMFS_NAME_TYPE fileName, SIMFS_CONTENT_TYPE type)
+{
+    SIMFS_INDEX_TYPE folder = simfsContext->processControlBlocks->currentWorkingDirectory;
+
+    if(findFile(fileName) != SIMFS_INVALID_INDEX){
+        return SIMFS_DUPLICATE_ERROR;
+    }
+
+    SIMFS_INDEX_TYPE i = allocateBlock(SIMFS_METADATA_GROUP);
+    if (i == SIMFS_INVALID_INDEX)
+        return SIMFS_ALLOC_ERROR;
+
+    // folders always have a directory, files get an index block with their first content
+    SIMFS_INDEX_TYPE blockRef = SIMFS_INVALID_INDEX;
+    if (type == SIMFS_FOLDER_CONTENT_TYPE) {
+        blockRef = allocateDirectory();
+        if (blockRef == SIMFS_INVALID_INDEX) {
+            freeBlock(i);
+            return SIMFS_ALLOC_ERROR;
+        }
+    }
+
+    if (!addRecord(folder, fileName, i)) {
+        if (blockRef != SIMFS_INVALID_INDEX)
+            freeBlock(blockRef);
+        freeBlock(i);
+        return SIMFS_ALLOC_ERROR;
+    }
+
+    if (!initDescriptor(i, fileName, type, blockRef)) {
+        removeRecord(folder, simfsVolume->block[i].content.fileDescriptor.name);
+        if (blockRef != SIMFS_INVALID_INDEX)
+            freeBlock(blockRef);
+        freeBlock(i);
+        return SIMFS_ALLOC_ERROR;
+    }
+
+    syncBitvector();
+    return SIMFS_NO_ERROR;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+
+/***
+ * Deletes a file from the file system.
+ *
+ * Hashes the file name and check if the file is in the directory. If not, then it returns SIMFS_NOT_FOUND_ERROR.
+ * Otherwise:
+ *    - finds the reference to the file descriptor block
+ *    - if the referenced block is a folder that is not empty, then returns SIMFS_NOT_EMPTY_ERROR.
+ *    - Otherwise:
+ *       - checks if the process owner can delete this file or folder; if not, it returns SIMFS_ACCESS_ERROR.
+ *       - Otherwise:
+ *          - frees all blocks belonging to the file by flipping the corresponding bits in the in-memory bitvector
+ *          - frees the reference block by flipping the corresponding bit in the in-memory bitvector
+ *          - clears the entry in the folder by removing the corresponding node in the list associated with
+ *            the slot for this file
+ *          - copies the in-memory bitvector to the bitvector blocks on the simulated disk
+ */
+
+
+
+static SIMFS_ERROR deleteFile(SIMFS_NAME_TYPE fileName);
+
+SIMFS_ERROR simfsDeleteFile(SIMFS_NAME_TYPE fileName)
+{
+    unsigned long long start = simfsStatsClock();
+    return simfsStatsRecord(SIMFS_STATS_DELETE_FILE, start, deleteFile(fileName));
+}
+
+static SIMFS_ERROR deleteFile(SIMFS_NAME_TYPE fileName)
+{
+    SIMFS_INDEX_TYPE node = findFile(fileName);
+    if (node == SIMFS_INVALID_INDEX){
+        return SIMFS_NOT_FOUND_ERROR;
+    }
+
+    SIMFS_ERROR error = deleteChild(simfsContext->processControlBlocks->currentWorkingDirectory, node);
+    syncBitvector();
+    return error;
+}
+
+/***
+ * Deletes the folder or file held in the given file descriptor block from its folder.
+ */
+static SIMFS_ERROR deleteChild(SIMFS_INDEX_TYPE folder, SIMFS_INDEX_TYPE node)
+{
+    SIMFS_FILE_DESCRIPTOR_TYPE *descriptor = &simfsVolume->block[node].content.fileDescriptor;
+
+    if (simfsVolume->block[node].type == SIMFS_FOLDER_CONTENT_TYPE && descriptor->size != 0)
+        return SIMFS_NOT_EMPTY_ERROR;
+
+    // open files cannot be deleted, since the open file table refers to the file descriptor block
+    SIMFS_DIR_ENT *entry = findDirEnt(node);
+    if (entry != NULL && entry->globalOpenFileTableIndex != SIMFS_INVALID_OPEN_FILE_TABLE_INDEX)
+        return SIMFS_ACCESS_ERROR;
+
+    removeDirEnt(node);
+    removeRecord(folder, descriptor->name);
+
+    if (simfsVolume->block[node].type == SIMFS_FOLDER_CONTENT_TYPE) {
+        freeDirectory(descriptor->block_ref);
+        freeNameFilter(node);
+    }
+    else if (descriptor->block_ref != SIMFS_INVALID_INDEX)
+        freeIndexChain(descriptor->block_ref);
+    freeBlock(node);
+
+    return SIMFS_NO_ERROR;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+/***
+ * Finds the file in the in-memory directory and obtains the information about the file from the file descriptor
+ * block referenced from the directory.
+ *
+ * If the file is not found, then it returns SIMFS_NOT_FOUND_ERROR
+ */
+static SIMFS_ERROR getFileInfo(SIMFS_INDEX_TYPE node, SIMFS_FILE_DESCRIPTOR_TYPE *infoBuffer);
+
+SIMFS_ERROR simfsGetFileInfo(SIMFS_NAME_TYPE fileName, SIMFS_FILE_DESCRIPTOR_TYPE *infoBuffer)
+{
+    unsigned long long start = simfsStatsClock();
+    SIMFS_INDEX_TYPE node = findFile(fileName);
+    SIMFS_ERROR error = (node == SIMFS_INVALID_INDEX ? SIMFS_NOT_FOUND_ERROR : getFileInfo(node, infoBuffer));
+    return simfsStatsRecord(SIMFS_STATS_GET_FILE_INFO, start, error);
+}
+
+SIMFS_ERROR simfsGetFileInfoByReference(SIMFS_INDEX_TYPE node, SIMFS_FILE_DESCRIPTOR_TYPE *infoBuffer)
+{
+    unsigned long long start = simfsStatsClock();
+    return simfsStatsRecord(SIMFS_STATS_GET_FILE_INFO, start, getFileInfo(node, infoBuffer));
+}
+
+static SIMFS_ERROR getFileInfo(SIMFS_INDEX_TYPE node, SIMFS_FILE_DESCRIPTOR_TYPE *infoBuffer)
+{
+    if (node >= SIMFS_NUMBER_OF_BLOCKS
+        || (simfsVolume->block[node].type != SIMFS_FOLDER_CONTENT_TYPE
+            && simfsVolume->block[node].type != SIMFS_FILE_CONTENT_TYPE))
+        return SIMFS_NOT_FOUND_ERROR;
+
+    SIMFS_FILE_DESCRIPTOR_TYPE* fileDescriptor = &simfsVolume->block[node].content.fileDescriptor;
+
+    infoBuffer->block_ref = fileDescriptor->block_ref;
+    infoBuffer->type = fileDescriptor->type;
+    infoBuffer->flags = fileDescriptor->flags;
+    infoBuffer->accessRights = fileDescriptor->accessRights;
+    infoBuffer->identifier = fileDescriptor->identifier;
+    strcpy(infoBuffer->name, fileDescriptor->name);
+    infoBuffer->creationTime = fileDescriptor->creationTime;
+    infoBuffer->lastAccessTime = fileDescriptor->lastAccessTime;
+    infoBuffer->lastModificationTime = fileDescriptor->lastModificationTime;
+    infoBuffer->owner = fileDescriptor->owner;
+    infoBuffer->size = fileDescriptor->size;
+
+    return SIMFS_NO_ERROR;
+}
+
+/***
+ * Resolves a path of folder and file names separated by slashes and returns the block holding the file descriptor
+ * of its last component through the parameter node. A path starting with a slash is resolved from the root of the
+ * volume, any other from the current working directory of the process. Empty components and "." are skipped; since
+ * folders do not refer to their parents, ".." is an ordinary name.
+ *
+ * Each component is looked up through the dentry cache, so a path whose names are cached is resolved without
+ * reading any blocks.
+ *
+ * If a component does not exist, or one before the last is not a folder, then it returns SIMFS_NOT_FOUND_ERROR.
+ */
+static SIMFS_ERROR resolvePath(char *path, SIMFS_INDEX_TYPE *node);
+
+SIMFS_ERROR simfsResolvePath(char *path, SIMFS_INDEX_TYPE *node)
+{
+    unsigned long long start = simfsStatsClock();
+    return simfsStatsRecord(SIMFS_STATS_RESOLVE_PATH, start, resolvePath(path, node));
+}
+
+static SIMFS_ERROR resolvePath(char *path, SIMFS_INDEX_TYPE *node)
+{
+    SIMFS_INDEX_TYPE current = (*path == '/' ? simfsVolume->superblock.attr.rootNodeIndex
+                                             : simfsContext->processControlBlocks->currentWorkingDirectory);
+    uint16_t type = SIMFS_FOLDER_CONTENT_TYPE;
+    SIMFS_NAME_TYPE component;
+
+    while (true) {
+        path += strspn(path, "/");
+        size_t length = strcspn(path, "/");
+        if (length == 0)
+            break;
+
+        if (length != 1 || path[0] != '.') {
+            if (type != SIMFS_FOLDER_CONTENT_TYPE)
+                return SIMFS_NOT_FOUND_ERROR;
+
+            // longer names were cut to this length when they were created
+            size_t stored = (length < SIMFS_MAX_NAME_LENGTH ? length : SIMFS_MAX_NAME_LENGTH - 1);
+            memcpy(component, path, stored);
+            component[stored] = '\0';
+
+            SIMFS_DENTRY_TYPE *dentry = lookupDentry(current, component);
+            if (dentry->node == SIMFS_INVALID_INDEX)
+                return SIMFS_NOT_FOUND_ERROR;
+            current = dentry->node;
+            type = dentry->type;
+        }
+        path += length;
+    }
+
+    *node = current;
+    return SIMFS_NO_ERROR;
+}
+
+/***
+ * Makes the folder at the given path the current working directory of the process.
+ *
+ * If the path does not lead to a folder, then it returns SIMFS_NOT_FOUND_ERROR.
+ */
+SIMFS_ERROR simfsChangeDirectory(char *path)
+{
+    SIMFS_INDEX_TYPE node;
+    SIMFS_ERROR error = simfsResolvePath(path, &node);
+    if (error != SIMFS_NO_ERROR)
+        return error;
+    if (simfsVolume->block[node].type != SIMFS_FOLDER_CONTENT_TYPE)
+        return SIMFS_NOT_FOUND_ERROR;
+
+    simfsContext->processControlBlocks->currentWorkingDirectory = node;
+    return SIMFS_NO_ERROR;
+}
+
+/***
+ * Looks up a child of the given folder by name and returns the block holding its file descriptor through
+ * the parameter node.
+ *
+ * If the folder does not hold a file with the name, then it returns SIMFS_NOT_FOUND_ERROR.
+ */
+SIMFS_ERROR simfsLookupFile(SIMFS_INDEX_TYPE folder, SIMFS_NAME_TYPE fileName, SIMFS_INDEX_TYPE *node)
+{
+    if (folder >= SIMFS_NUMBER_OF_BLOCKS || simfsVolume->block[folder].type != SIMFS_FOLDER_CONTENT_TYPE)
+        return SIMFS_NOT_FOUND_ERROR;
+
+    *node = findChild(folder, fileName);
+    return (*node == SIMFS_INVALID_INDEX ? SIMFS_NOT_FOUND_ERROR : SIMFS_NO_ERROR);
+}
+
+/***
+ * Returns the file descriptor block of the child at the given position of the folder through the parameter node.
+ *
+ * Positions count the children in the order of the folder's directory blocks. If the folder has fewer children,
+ * then it returns SIMFS_NOT_FOUND_ERROR.
+ */
+SIMFS_ERROR simfsGetFolderEntry(SIMFS_INDEX_TYPE folder, int position, SIMFS_INDEX_TYPE *node)
+{
+    if (folder >= SIMFS_NUMBER_OF_BLOCKS || simfsVolume->block[folder].type != SIMFS_FOLDER_CONTENT_TYPE)
+        return SIMFS_NOT_FOUND_ERROR;
+
+    struct directoryCursor cursor;
+    startDirectoryWalk(&cursor, folder);
+    for (SIMFS_DIRECTORY_RECORD_TYPE *record = nextRecord(&cursor); record != NULL; record = nextRecord(&cursor)) {
+        if (position-- == 0) {
+            *node = record->node;
             return SIMFS_NO_ERROR;
         }
     }
+    return SIMFS_NOT_FOUND_ERROR;
+}
+
+/***
+ * Lists the children of a folder in batches: fills the buffer with up to max entries following the position named by
+ * the cursor, returns their number through the parameter count, and moves the cursor behind the last of them. A count
+ * below max means the listing is complete.
+ *
+ * The children are listed bucket by bucket of the folder's directory, and within a bucket in the order of the upper
+ * half of their name hash and their file descriptor block. Their position in that order is the cursor, so entries
+ * that are created or deleted between two calls do not shift the others.
+ *
+ * If the folder does not exist, then it returns SIMFS_NOT_FOUND_ERROR.
+ */
+static SIMFS_ERROR readDir(SIMFS_INDEX_TYPE folder, SIMFS_FOLDER_CURSOR_TYPE *cursor, SIMFS_FOLDER_ENTRY_TYPE *buffer,
+                           int max, int *count);
+
+SIMFS_ERROR simfsReadDir(SIMFS_INDEX_TYPE folder, SIMFS_FOLDER_CURSOR_TYPE *cursor, SIMFS_FOLDER_ENTRY_TYPE *buffer,
+                         int max, int *count)
+{
+    unsigned long long start = simfsStatsClock();
+    return simfsStatsRecord(SIMFS_STATS_READ_DIR, start, readDir(folder, cursor, buffer, max, count));
+}
+
+static SIMFS_FOLDER_CURSOR_TYPE recordKey(int bucket, SIMFS_DIRECTORY_RECORD_TYPE *record)
+{
+    return ((SIMFS_FOLDER_CURSOR_TYPE) bucket << 32) | ((SIMFS_FOLDER_CURSOR_TYPE) record->hash << 16) | record->node;
+}
+
+static int compareRecordKeys(const void *a, const void *b)
+{
+    SIMFS_FOLDER_CURSOR_TYPE x = *(const SIMFS_FOLDER_CURSOR_TYPE *) a, y = *(const SIMFS_FOLDER_CURSOR_TYPE *) b;
+    return (x > y) - (x < y);
+}
+
+static SIMFS_ERROR readDir(SIMFS_INDEX_TYPE folder, SIMFS_FOLDER_CURSOR_TYPE *cursor, SIMFS_FOLDER_ENTRY_TYPE *buffer,
+                           int max, int *count)
+{
+    if (folder >= SIMFS_NUMBER_OF_BLOCKS || simfsVolume->block[folder].type != SIMFS_FOLDER_CONTENT_TYPE)
+        return SIMFS_NOT_FOUND_ERROR;
+
+    SIMFS_INDEX_TYPE root = simfsVolume->block[folder].content.fileDescriptor.block_ref;
+
+    // the records of a bucket are kept in the order they were added; their keys are sorted to resume in the middle
+    SIMFS_FOLDER_CURSOR_TYPE keys[SIMFS_NUMBER_OF_BLOCKS];
+
+    *count = 0;
+    for (int bucket = *cursor >> 32; bucket < SIMFS_DIRECTORY_BUCKETS && *count < max; bucket++) {
+        int found = 0;
+        for (SIMFS_INDEX_TYPE leaf = simfsVolume->block[root].content.bucket[bucket]; leaf != 0;
+             leaf = simfsVolume->block[leaf].content.leaf.next) {
+            int used = simfsVolume->block[leaf].content.leaf.used;
+            for (int offset = 0; offset < used;) {
+                SIMFS_DIRECTORY_RECORD_TYPE *record = leafRecord(leaf, offset);
+                if (recordKey(bucket, record) >= *cursor)
+                    keys[found++] = recordKey(bucket, record);
+                offset += RECORD_SIZE(record->nameLength);
+            }
+        }
+        qsort(keys, found, sizeof(keys[0]), compareRecordKeys);
+
+        for (int i = 0; i < found && *count < max; i++) {
+            SIMFS_INDEX_TYPE node = keys[i] & 0xFFFF;
+            SIMFS_FOLDER_ENTRY_TYPE *entry = &buffer[(*count)++];
+            entry->node = node;
+            entry->type = simfsVolume->block[node].type;
+            entry->size = simfsVolume->block[node].content.fileDescriptor.size;
+            memcpy(entry->name, simfsVolume->block[node].content.fileDescriptor.name, SIMFS_MAX_NAME_LENGTH);
+            entry->name[SIMFS_MAX_NAME_LENGTH - 1] = '\0';
+            entry->next = keys[i] + 1;
+            *cursor = entry->next;
+        }
+
+        if (*count < max)
+            *cursor = (SIMFS_FOLDER_CURSOR_TYPE) (bucket + 1) << 32;
+    }
+    return SIMFS_NO_ERROR;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+/***
+ * Creates an in-memory description of the file for fast access.
+ *
+ * - hashes the name and searches for it in the in-memory directory resolving potential conflicts using the
+ *   unique identifier.
+ *
+ *   If the file does not exist (i.e., the slot obtained by hashing is NULL), the SIMFS_NOT_FOUND_ERROR is returned.
+ *
+ * Otherwise:
+ *
+ *    - if there is a global entry for the file (as indicated by the index to the global open file table in the
+ *      directory entry), then:
+ *
+ *       - it increases the reference count for this file
+ *
+ *       - otherwise
+ *          - finds an empty slot in the global open file table and adds an entry for the file
+ *          - copies the information from the file descriptor block referenced from the directory entry for
+ *            this file to the new entry in the global open file table
+ *          - sets the reference count of the file to 1
+ *          - adds the index of the entry in the global open file table to the directory entry for this file
+ *
+ *   - checks if the process has its process control block in the processControlBlocks list
+ *      - if not, then a file control block for the process is created and added to the list; the current
+ *        working directory is initialized to the root of the volume and the number of the open files is
+ *        initialized to 1; the process id should be simulated for testing; it will be possible to obtain
+ *        the actual pid after integration with FUSE
+ *
+ *     - scans the per-process open file table of the process checking if an entry for the file already
+ *      exists in the table (i.e., the file has already been opened)
+ *
+ *       - if the entry indeed does exists, the function returns the index of the entry through the parameter
+ *         fileHandle, and then returns SIMFS_DUPLICATE_ERROR as the return value. This is not a fatal error.
+ *
+ *       - otherwise:
+ *          - the function finds an empty slot in the table and fills it with the information including
+ *            the index to the entry for this file in the global open file table
+ *
+ *          - returns the index to the new element of the per-process open file table through the parameter
+ *            fileHandle and SIMFS_NO_ERROR as the return value.
+ *
+ * If there is no free slot for the file in either the global file table or in the per-process
+ * file table, or if there is any other allocation problem, then the function returns SIMFS_ALLOC_ERROR.
+ *
+ */
+
+
+int findEmptyInFileTable(){
+    for (int i = 0; i < SIMFS_MAX_NUMBER_OF_OPEN_FILES; ++i) {
+        if(simfsContext->globalOpenFileTable[i].type == SIMFS_INVALID_CONTENT_TYPE){
+            return i;
+        }
+    }
+    return -1;
+}
+
+static SIMFS_ERROR openFile(SIMFS_INDEX_TYPE node, SIMFS_FILE_HANDLE_TYPE *fileHandle);
+static SIMFS_ERROR openFileByReference(SIMFS_INDEX_TYPE node, SIMFS_FILE_HANDLE_TYPE *fileHandle);
+
+void setGOFTV(int fileIndex, SIMFS_INDEX_TYPE fileDescriptorType){
+    SIMFS_BLOCK_TYPE *file = &simfsVolume->block[fileDescriptorType];
+    SIMFS_OPEN_FILE_GLOBAL_TABLE_TYPE* globalTableType = &(simfsContext->globalOpenFileTable[fileIndex]);
+
+    globalTableType->type = file->type;
+    globalTableType->fileDescriptor = fileDescriptorType;
+    globalTableType->referenceCount = 1;
+    globalTableType->processReferences = 0;
+    globalTableType->accessRights = file->content.fileDescriptor.accessRights;
+    globalTableType->creationTime = file->content.fileDescriptor.creationTime;
+    globalTableType->lastAccessTime = file->content.fileDescriptor.lastAccessTime;
+    globalTableType->lastModificationTime = file->content.fileDescriptor.lastModificationTime;
+    globalTableType->owner = file->content.fileDescriptor.owner;
+    globalTableType->size = file->content.fileDescriptor.size;
+    globalTableType->pinCount = 0;
+    globalTableType->retiredBlockRef = SIMFS_INVALID_INDEX;
+    globalTableType->plainContent = NULL;
+    globalTableType->retiredPlainContent = NULL;
+    globalTableType->nextReadOffset = 0;
+    globalTableType->nextReadIndexBlock = file->content.fileDescriptor.block_ref;
+    globalTableType->readaheadWindow = 0;
+}
+
+//SIMFS_FILE_DESCRIPTOR_TYPE* searchFileTable(SIMFS_NAME_TYPE name, unsigned long long int identifier){
+//    SIMFS_PROCESS_CONTROL_BLOCK_TYPE* current = simfsContext->processControlBlocks;
+//
+//    while (current != NULL){
+//        if(simfsVolume->block[simfsContext->globalOpenFileTable[current->openFileTable->globalOpenFileTableIndex].fileDescriptor].content.fileDescriptor.identifier == identifier){
+//            return &(simfsVolume->block[simfsContext->globalOpenFileTable[current->openFileTable->globalOpenFileTableIndex].fileDescriptor].content.fileDescriptor);
+//        }
+//        current = current->next;
+//    }
+//
+//
+//    return NULL;
+//}
+
+SIMFS_ERROR simfsOpenFile(SIMFS_NAME_TYPE fileName, SIMFS_FILE_HANDLE_TYPE *fileHandle)
+{
+    unsigned long long start = simfsStatsClock();
+    SIMFS_INDEX_TYPE node = findFile(fileName);
+    SIMFS_ERROR error = (node == SIMFS_INVALID_INDEX ? SIMFS_NOT_FOUND_ERROR : openFile(node, fileHandle));
+    return simfsStatsRecord(SIMFS_STATS_OPEN_FILE, start, error);
+}
+
+/***
+ * Opens the folder or file held in the given file descriptor block for the current process.
+ */
+static SIMFS_ERROR openFile(SIMFS_INDEX_TYPE node, SIMFS_FILE_HANDLE_TYPE *fileHandle)
+{
+    SIMFS_PROCESS_CONTROL_BLOCK_TYPE *process = simfsContext->processControlBlocks;
+    SIMFS_DIR_ENT *entry = findDirEnt(node);
+    if (entry == NULL)
+        return SIMFS_SYSTEM_ERROR;
+
+    int slot = -1;
+    for (int i = 0; i < SIMFS_MAX_NUMBER_OF_OPEN_FILES_PER_PROCESS; ++i) {
+        unsigned int globalIndex = process->openFileTable[i].globalOpenFileTableIndex;
+        if (globalIndex != SIMFS_INVALID_OPEN_FILE_TABLE_INDEX && globalIndex == entry->globalOpenFileTableIndex) {
+            *fileHandle = globalIndex;
+            return SIMFS_DUPLICATE_ERROR;
+        }
+        if (globalIndex == SIMFS_INVALID_OPEN_FILE_TABLE_INDEX && slot == -1)
+            slot = i;
+    }
+    if (slot == -1)
+        return SIMFS_ALLOC_ERROR;
+
+    SIMFS_ERROR error = openFileByReference(node, fileHandle);
+    if (error != SIMFS_NO_ERROR)
+        return error;
+
+    process->openFileTable[slot].globalOpenFileTableIndex = *fileHandle;
+    process->openFileTable[slot].accessRights = simfsContext->globalOpenFileTable[*fileHandle].accessRights;
+    process->numberOfOpenFiles++;
+    simfsContext->globalOpenFileTable[*fileHandle].processReferences++;
+
+    return SIMFS_NO_ERROR;
+}
+
+/***
+ * Opens the folder or file held in the given file descriptor block without going through a process control block.
+ *
+ * Increases the reference count of the entry in the global open file table if the file is already open, and
+ * otherwise creates one. The index of the entry is returned through the parameter fileHandle.
+ */
+static SIMFS_ERROR openFileByReference(SIMFS_INDEX_TYPE node, SIMFS_FILE_HANDLE_TYPE *fileHandle);
+
+SIMFS_ERROR simfsOpenFileByReference(SIMFS_INDEX_TYPE node, SIMFS_FILE_HANDLE_TYPE *fileHandle)
+{
+    unsigned long long start = simfsStatsClock();
+    return simfsStatsRecord(SIMFS_STATS_OPEN_FILE, start, openFileByReference(node, fileHandle));
+}
+
+static SIMFS_ERROR openFileByReference(SIMFS_INDEX_TYPE node, SIMFS_FILE_HANDLE_TYPE *fileHandle)
+{
+    if (node >= SIMFS_NUMBER_OF_BLOCKS
+        || (simfsVolume->block[node].type != SIMFS_FOLDER_CONTENT_TYPE
+            && simfsVolume->block[node].type != SIMFS_FILE_CONTENT_TYPE))
+        return SIMFS_NOT_FOUND_ERROR;
+
+    SIMFS_DIR_ENT *entry = findDirEnt(node);
+    if (entry == NULL)
+        return SIMFS_SYSTEM_ERROR;
+
+    if (entry->globalOpenFileTableIndex != SIMFS_INVALID_OPEN_FILE_TABLE_INDEX) {
+        simfsContext->globalOpenFileTable[entry->globalOpenFileTableIndex].referenceCount++;
+        *fileHandle = entry->globalOpenFileTableIndex;
+        return SIMFS_NO_ERROR;
+    }
+
+    int fileIndex = findEmptyInFileTable();
+    if (fileIndex == -1)
+        return SIMFS_ALLOC_ERROR;
+
+    setGOFTV(fileIndex, node);
+    entry->globalOpenFileTableIndex = fileIndex;
+    *fileHandle = fileIndex;
+    return SIMFS_NO_ERROR;
+}
+
+/***
+ * Returns the entry of the global open file table for a file handle, or NULL if the handle does not refer to
+ * an open file.
+ */
+static SIMFS_OPEN_FILE_GLOBAL_TABLE_TYPE *openFileEntry(SIMFS_FILE_HANDLE_TYPE fileHandle)
+{
+    if (fileHandle < 0 || fileHandle >= SIMFS_MAX_NUMBER_OF_OPEN_FILES)
+        return NULL;
+
+    SIMFS_OPEN_FILE_GLOBAL_TABLE_TYPE *file = &simfsContext->globalOpenFileTable[fileHandle];
+    if (file->type == SIMFS_INVALID_CONTENT_TYPE || file->fileDescriptor == SIMFS_INVALID_INDEX)
+        return NULL;
+
+    return file;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+/***
+ * Keeps the old content of a file whose blocks are pinned by simfsReadFileVector. The chain is linked in front of
+ * the chains retired earlier, so all of them are freed at once when the last pin is released.
+ */
+static void retireIndexChain(SIMFS_OPEN_FILE_GLOBAL_TABLE_TYPE *file, SIMFS_INDEX_TYPE indexBlock)
+{
+    if (indexBlock == SIMFS_INVALID_INDEX)
+        return;
+
+    SIMFS_INDEX_TYPE *index = simfsVolume->block[indexBlock].content.index;
+    while (index[SIMFS_INDEX_SIZE - 1] != 0)
+        index = nextIndex(index);
+
+    if (file->retiredBlockRef != SIMFS_INVALID_INDEX)
+        index[SIMFS_INDEX_SIZE - 1] = file->retiredBlockRef;
+    file->retiredBlockRef = indexBlock;
+}
+
+/***
+ * Drops the decompressed content of a file after the file has been written; while vectors into it are pinned,
+ * it is kept with the content retired earlier.
+ */
+static void retirePlainContent(SIMFS_OPEN_FILE_GLOBAL_TABLE_TYPE *file)
+{
+    if (file->plainContent == NULL)
+        return;
+
+    if (file->pinCount == 0) {
+        free(file->plainContent);
+    } else {
+        file->plainContent->next = file->retiredPlainContent;
+        file->retiredPlainContent = file->plainContent;
+    }
+    file->plainContent = NULL;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+/***
+ * A new index chain being filled with data blocks.
+ */
+struct chainBuilder {
+    SIMFS_INDEX_TYPE first;
+    SIMFS_INDEX_TYPE *index; // the last index block of the chain
+    int slot; // next free slot of the last index block
+};
+
+/***
+ * Stores size bytes in data blocks appended to the chain, starting with a new block; with deduplication on, blocks
+ * of the volume with the same content are shared. Returns false if the volume is full; the blocks obtained so far
+ * stay in the chain.
+ */
+static bool appendData(struct chainBuilder *chain, const char *bytes, size_t size)
+{
+    for (size_t offset = 0; offset < size; offset += SIMFS_DATA_SIZE) {
+        if (chain->slot == SIMFS_INDEX_SIZE - 1) {
+            SIMFS_INDEX_TYPE next = allocateIndexBlock();
+            if (next == SIMFS_INVALID_INDEX)
+                return false;
+            if (chain->index == NULL)
+                chain->first = next;
+            else
+                chain->index[SIMFS_INDEX_SIZE - 1] = next;
+            chain->index = simfsVolume->block[next].content.index;
+            chain->slot = 0;
+        }
+
+        // the rest of a last, partial block is cleared, so that equal content has equal blocks
+        char content[SIMFS_DATA_SIZE] = {0};
+        memcpy(content, bytes + offset, (size - offset < SIMFS_DATA_SIZE ? size - offset : SIMFS_DATA_SIZE));
+
+        SIMFS_INDEX_TYPE data = takeDataBlock(content);
+        if (data == SIMFS_INVALID_INDEX)
+            return false;
+        chain->index[chain->slot++] = data;
+    }
+    return true;
+}
+
+/***
+ * Stores content in compressed chunks. A chunk is only kept compressed if that saves at least one data block;
+ * the compressor is given no more room than that, so it gives up on a chunk that does not compress as soon as
+ * the room is used up, and the chunk is stored raw.
+ */
+static bool appendCompressed(struct chainBuilder *chain, const char *content, size_t size)
+{
+    char stored[SIMFS_COMPRESSION_HEADER_SIZE + SIMFS_COMPRESSION_CHUNK_SIZE];
+
+    for (size_t offset = 0; offset < size; offset += SIMFS_COMPRESSION_CHUNK_SIZE) {
+        size_t left = size - offset;
+        int length = (left < SIMFS_COMPRESSION_CHUNK_SIZE ? (int) left : SIMFS_COMPRESSION_CHUNK_SIZE);
+        int rawBlocks = (SIMFS_COMPRESSION_HEADER_SIZE + length + SIMFS_DATA_SIZE - 1) / SIMFS_DATA_SIZE;
+        int room = (rawBlocks - 1) * SIMFS_DATA_SIZE - SIMFS_COMPRESSION_HEADER_SIZE;
+
+        char *payload = stored + SIMFS_COMPRESSION_HEADER_SIZE;
+        int compressed = (room > 0 ? simfsLz4Compress(content + offset, length, payload, room) : 0);
+        uint16_t header = (uint16_t) (compressed > 0 ? compressed : SIMFS_COMPRESSION_RAW | length);
+        if (compressed == 0)
+            memcpy(payload, content + offset, length);
+        memcpy(stored, &header, SIMFS_COMPRESSION_HEADER_SIZE);
+
+        if (!appendData(chain, stored, SIMFS_COMPRESSION_HEADER_SIZE + (compressed > 0 ? compressed : length)))
+            return false;
+    }
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+static SIMFS_ERROR writeFile(SIMFS_FILE_HANDLE_TYPE fileHandle, char *writeBuffer);
+
+// the first index block of an open file, for the trace records of reads and writes
+#define TRACED_BLOCK_REF(fileHandle) (openFileEntry(fileHandle) == NULL ? SIMFS_INVALID_INDEX \
+    : simfsVolume->block[openFileEntry(fileHandle)->fileDescriptor].content.fileDescriptor.block_ref)
+
+/***
+ * The function replaces content of a file with new one pointed to by the parameter writeBuffer.
+ *
+ * Checks if the file handle points to a valid file descriptor of an open file. Any issues should be reported by
+ * returning SIMFS_SYSTEM_ERROR. In this case, further code debugging is needed.
+ *
+ * Otherwise, it checks the access rights for writing. If the process owner is not allowed to write to the file,
+ * then the function returns SIMFS_ACCESS_ERROR.
+ *
+ * Then, the function calculates the space needed for the new content and checks if the write buffer can fit into
+ * the remaining free space in the file system. If not, then the SIMFS_ALLOC_ERROR is returned.
+ *
+ * Otherwise, the function:
+ *    - acquires as many new blocks as needed to hold the new content modifying corresponding bits in
+ *      the in-memory bitvector,
+ *    - copies the characters pointed to by the parameter writeBuffer (until '\0' but excluding it) to the
+ *      new just acquired blocks,
+ *    - copies any modified block of the in-memory bitvector to the corresponding bitvector block on the disk.
+ *
+ * The content of a file with the flag SIMFS_FILE_COMPRESSED is compressed chunk by chunk on the way into the blocks,
+ * so it takes fewer of them.
+ *
+ * If the new content has been written successfully, the function then removes all blocks currently held by
+ * this file and modifies the file descriptor to reflect the new location, the new size of the file, and the new
+ * times of last modification and access.
+ *
+ * This order of actions prevents file corruption, since in case of any error with writing new content, the file's
+ * old version is intact. This technique is called copy-on-write and is an alternative to journalling.
+ *
+ * The function returns SIMFS_WRITE_ERROR in response to exception not specified earlier.
+ *
+ */
+SIMFS_ERROR simfsWriteFile(SIMFS_FILE_HANDLE_TYPE fileHandle, char *writeBuffer)
+{
+    unsigned long long start = simfsStatsClock();
+    SIMFS_TRACE_BEGIN(SIMFS_TRACE_WRITE_FILE, fileHandle, strlen(writeBuffer));
+    SIMFS_ERROR error = writeFile(fileHandle, writeBuffer);
+    syncBitvector();
+    SIMFS_TRACE_END(SIMFS_TRACE_WRITE_FILE, TRACED_BLOCK_REF(fileHandle), error);
+    return simfsStatsRecord(SIMFS_STATS_WRITE_FILE, start, error);
+}
+
+static SIMFS_ERROR writeFile(SIMFS_FILE_HANDLE_TYPE fileHandle, char *writeBuffer)
+{
+    SIMFS_OPEN_FILE_GLOBAL_TABLE_TYPE *file = openFileEntry(fileHandle);
+    if (file == NULL)
+        return SIMFS_SYSTEM_ERROR;
+
+    if (file->type != SIMFS_FILE_CONTENT_TYPE || !(file->accessRights & S_IWUSR))
+        return SIMFS_ACCESS_ERROR;
+
+    // acquire and fill the new index chain
+
+    SIMFS_FILE_DESCRIPTOR_TYPE *descriptor = &simfsVolume->block[file->fileDescriptor].content.fileDescriptor;
+    size_t size = strlen(writeBuffer);
+    struct chainBuilder chain = {SIMFS_INVALID_INDEX, NULL, SIMFS_INDEX_SIZE - 1};
+
+    bool stored = (descriptor->flags & SIMFS_FILE_COMPRESSED ? appendCompressed(&chain, writeBuffer, size)
+                   : appendData(&chain, writeBuffer, size));
+    if (!stored) {
+        freeIndexChain(chain.first);
+        return SIMFS_ALLOC_ERROR;
+    }
+
+    // release the old content and point the file descriptor to the new one
+
+    if (file->pinCount == 0)
+        freeIndexChain(descriptor->block_ref);
+    else
+        retireIndexChain(file, descriptor->block_ref);
+    retirePlainContent(file);
+
+    descriptor->block_ref = chain.first;
+    descriptor->size = size;
+    descriptor->lastAccessTime = descriptor->lastModificationTime = time(NULL);
+
+    file->size = descriptor->size;
+    file->lastAccessTime = descriptor->lastAccessTime;
+    file->lastModificationTime = descriptor->lastModificationTime;
+
+    // the read position referred to the old chain
+    file->nextReadOffset = 0;
+    file->nextReadIndexBlock = chain.first;
+    file->readaheadWindow = 0;
+
+    return SIMFS_NO_ERROR;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+/***
+ * Prefetches the index blocks and data blocks of the chain starting with indexBlock, until count data blocks
+ * have been covered or the chain ends. Following the links is cheap compared to the dependent loads a reader
+ * does when it reaches each block, since the prefetches of all the blocks are in flight at the same time.
+ */
+static void readahead(SIMFS_INDEX_TYPE indexBlock, int count)
+{
+    while (count > 0 && indexBlock != 0 && indexBlock != SIMFS_INVALID_INDEX) {
+        SIMFS_INDEX_TYPE *index = simfsVolume->block[indexBlock].content.index;
+        for (int j = 0; j < SIMFS_INDEX_SIZE - 1 && count > 0 && index[j] != 0; j++, count--)
+            __builtin_prefetch(&simfsVolume->block[index[j]], 0, 1);
+
+        indexBlock = index[SIMFS_INDEX_SIZE - 1];
+        if (indexBlock != 0)
+            __builtin_prefetch(&simfsVolume->block[indexBlock], 0, 1);
+    }
+}
+
+/***
+ * Records where a read ended and grows the readahead window of a sequential reader, or drops it back when
+ * the reader jumped. Returns the number of data blocks to prefetch past the end of the read.
+ */
+static int trackRead(SIMFS_OPEN_FILE_GLOBAL_TABLE_TYPE *file, size_t offset, size_t end, SIMFS_INDEX_TYPE indexBlock)
+{
+    if (offset == file->nextReadOffset && file->readaheadWindow != 0)
+        file->readaheadWindow = (file->readaheadWindow * 2 < SIMFS_READAHEAD_MAX_WINDOW
+                                 ? file->readaheadWindow * 2 : SIMFS_READAHEAD_MAX_WINDOW);
+    else if (offset == file->nextReadOffset)
+        file->readaheadWindow = SIMFS_READAHEAD_MIN_WINDOW;
+    else
+        file->readaheadWindow = 0;
+
+    file->nextReadOffset = end;
+    file->nextReadIndexBlock = indexBlock;
+    return file->readaheadWindow;
+}
+
+/***
+ * Walks the data blocks of an index chain in order.
+ */
+struct chainCursor {
+    SIMFS_INDEX_TYPE indexBlock;
+    int slot;
+};
+
+/***
+ * Returns the content of the next data block of the chain, or NULL if the chain ends or is broken.
+ */
+static char *nextData(struct chainCursor *cursor)
+{
+    if (cursor->indexBlock == 0 || cursor->indexBlock >= SIMFS_NUMBER_OF_BLOCKS)
+        return NULL;
+
+    SIMFS_INDEX_TYPE *index = simfsVolume->block[cursor->indexBlock].content.index;
+    SIMFS_INDEX_TYPE data = index[cursor->slot++];
+    if (cursor->slot == SIMFS_INDEX_SIZE - 1) {
+        cursor->indexBlock = index[SIMFS_INDEX_SIZE - 1];
+        cursor->slot = 0;
+    }
+
+    return (data == 0 || data >= SIMFS_NUMBER_OF_BLOCKS ? NULL : simfsVolume->block[data].content.data);
+}
+
+/***
+ * Copies the content of a file that is stored raw into buffer; returns false if the chain ends too early.
+ */
+static bool copyContent(SIMFS_FILE_DESCRIPTOR_TYPE *descriptor, char *buffer)
+{
+    size_t offset = 0;
+    SIMFS_INDEX_TYPE indexBlock = descriptor->block_ref;
+    while (offset < descriptor->size) {
+        if (indexBlock == 0 || indexBlock == SIMFS_INVALID_INDEX)
+            return false;
+
+        SIMFS_INDEX_TYPE *index = simfsVolume->block[indexBlock].content.index;
+        readahead(index[SIMFS_INDEX_SIZE - 1], SIMFS_READAHEAD_MIN_WINDOW); // the next index block, while this one is copied
+        for (int j = 0; j < SIMFS_INDEX_SIZE - 1 && offset < descriptor->size; ++j) {
+            size_t length = (descriptor->size - offset < SIMFS_DATA_SIZE ? descriptor->size - offset : SIMFS_DATA_SIZE);
+            memcpy(buffer + offset, simfsVolume->block[index[j]].content.data, length);
+            offset += length;
+        }
+        indexBlock = index[SIMFS_INDEX_SIZE - 1];
+    }
+    return true;
+}
+
+/***
+ * Decompresses the content of a file with the flag SIMFS_FILE_COMPRESSED into buffer; returns false if the chain
+ * ends too early or a chunk does not decompress to its share of the size of the file.
+ */
+static bool decompressContent(SIMFS_FILE_DESCRIPTOR_TYPE *descriptor, char *buffer)
+{
+    char stored[SIMFS_COMPRESSION_HEADER_SIZE + SIMFS_COMPRESSION_CHUNK_SIZE + SIMFS_DATA_SIZE]; // whole data blocks
+    struct chainCursor cursor = {descriptor->block_ref, 0};
+
+    for (size_t offset = 0; offset < descriptor->size; offset += SIMFS_COMPRESSION_CHUNK_SIZE) {
+        size_t length = (descriptor->size - offset < SIMFS_COMPRESSION_CHUNK_SIZE
+                         ? descriptor->size - offset : SIMFS_COMPRESSION_CHUNK_SIZE);
+
+        char *data = nextData(&cursor);
+        if (data == NULL)
+            return false;
+
+        uint16_t header;
+        memcpy(&header, data, SIMFS_COMPRESSION_HEADER_SIZE);
+        size_t storedLength = header & ~SIMFS_COMPRESSION_RAW;
+        if (storedLength > ((header & SIMFS_COMPRESSION_RAW) ? length : SIMFS_COMPRESSION_CHUNK_SIZE))
+            return false;
+
+        memcpy(stored, data, SIMFS_DATA_SIZE);
+        for (size_t gathered = SIMFS_DATA_SIZE; gathered < SIMFS_COMPRESSION_HEADER_SIZE + storedLength;
+             gathered += SIMFS_DATA_SIZE) {
+            if ((data = nextData(&cursor)) == NULL)
+                return false;
+            memcpy(stored + gathered, data, SIMFS_DATA_SIZE);
+        }
+
+        if (header & SIMFS_COMPRESSION_RAW) {
+            if (storedLength != length)
+                return false;
+            memcpy(buffer + offset, stored + SIMFS_COMPRESSION_HEADER_SIZE, length);
+        } else if (simfsLz4Decompress(stored + SIMFS_COMPRESSION_HEADER_SIZE, (int) storedLength, buffer + offset,
+                                      (int) length) != (int) length) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/***
+ * The function returns the complete content of the file to the caller through the parameter readBuffer.
+ *
+ * Checks if the file handle (i.e., an index to an entry in the per-process open files table) points to
+ * a valid file descriptor of an open file. Any issues should be reported by returning SIMFS_SYSTEM_ERROR.
+ * In this case, further code debugging is needed.
+ *
+ * Otherwise, it checks the user's access right to read the file. If the process owner is not allowed to read the file,
+ * then the function returns SIMFS_ACCESS_ERROR.
+ *
+ * Otherwise, the function allocates memory sufficient to hold the read content with an appended end of string
+ * character; the pointer to newly allocated memory is passed back through the readBuffer parameter. All the content
+ * of the blocks is concatenated using the allocated space, and an end of string character is appended at the end of
+ * the concatenated content.
+ *
+ * The function returns SIMFS_READ_ERROR in response to exception not specified earlier.
+ *
+ */
+static SIMFS_ERROR readFile(SIMFS_FILE_HANDLE_TYPE fileHandle, char **readBuffer);
+
+SIMFS_ERROR simfsReadFile(SIMFS_FILE_HANDLE_TYPE fileHandle, char **readBuffer)
+{
+    unsigned long long start = simfsStatsClock();
+    SIMFS_TRACE_BEGIN(SIMFS_TRACE_READ_FILE, fileHandle, 0);
+    SIMFS_ERROR error = readFile(fileHandle, readBuffer);
+    SIMFS_TRACE_END(SIMFS_TRACE_READ_FILE, TRACED_BLOCK_REF(fileHandle), error);
+    return simfsStatsRecord(SIMFS_STATS_READ_FILE, start, error);
+}
+
+static SIMFS_ERROR readFile(SIMFS_FILE_HANDLE_TYPE fileHandle, char **readBuffer)
+{
+    SIMFS_OPEN_FILE_GLOBAL_TABLE_TYPE *file = openFileEntry(fileHandle);
+    if (file == NULL)
+        return SIMFS_SYSTEM_ERROR;
+
+    if (file->type != SIMFS_FILE_CONTENT_TYPE || !(file->accessRights & S_IRUSR))
+        return SIMFS_ACCESS_ERROR;
+
+    SIMFS_FILE_DESCRIPTOR_TYPE *descriptor = &simfsVolume->block[file->fileDescriptor].content.fileDescriptor;
+    char *buffer = malloc(descriptor->size + 1);
+    if (buffer == NULL)
+        return SIMFS_ALLOC_ERROR;
+
+    bool copied = (descriptor->flags & SIMFS_FILE_COMPRESSED ? decompressContent(descriptor, buffer)
+                   : copyContent(descriptor, buffer));
+    if (!copied) {
+        free(buffer);
+        return SIMFS_READ_ERROR;
+    }
+    buffer[descriptor->size] = '\0';
+
+    descriptor->lastAccessTime = file->lastAccessTime = time(NULL);
+
+    *readBuffer = buffer;
+    return SIMFS_NO_ERROR;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+/***
+ * Returns the content of a file without copying it: the iovec array pointed to by the parameter vector is filled
+ * with pointers straight into the data blocks holding the bytes [offset, offset + size) of the file.
+ *
+ * On input, vectorCount holds the number of elements of the array; on output, the number of elements used. The
+ * content is truncated at the end of the file and when the array is full, so callers have to add up the lengths
+ * to see how much of the range they got.
+ *
+ * The blocks are pinned until simfsReleaseFileVector is called for the same file handle. A write in the meantime
+ * keeps the old blocks alive, so the vector keeps describing the content it was read from. Vectors have to be
+ * released before the file is closed.
+ *
+ * The content of a compressed file is decompressed by the first call, and the vector points into that copy; it is
+ * kept for the following calls until the file is written or closed.
+ *
+ * As for simfsReadFile, issues with the file handle are reported with SIMFS_SYSTEM_ERROR and missing access rights
+ * with SIMFS_ACCESS_ERROR.
+ */
+static SIMFS_ERROR readFileVector(SIMFS_FILE_HANDLE_TYPE fileHandle, size_t offset, size_t size,
+                                  struct iovec *vector, int *vectorCount);
+
+SIMFS_ERROR simfsReadFileVector(SIMFS_FILE_HANDLE_TYPE fileHandle, size_t offset, size_t size,
+                                struct iovec *vector, int *vectorCount)
+{
+    unsigned long long start = simfsStatsClock();
+    return simfsStatsRecord(SIMFS_STATS_READ_FILE_VECTOR, start,
+                            readFileVector(fileHandle, offset, size, vector, vectorCount));
+}
+
+/***
+ * Fills the vector for the bytes [offset, end) of a compressed file from its decompressed content.
+ */
+static SIMFS_ERROR readPlainVector(SIMFS_OPEN_FILE_GLOBAL_TABLE_TYPE *file, SIMFS_FILE_DESCRIPTOR_TYPE *descriptor,
+                                   size_t offset, size_t end, struct iovec *vector, int *vectorCount)
+{
+    if (file->plainContent == NULL) {
+        SIMFS_PLAIN_CONTENT_TYPE *plain = malloc(sizeof(SIMFS_PLAIN_CONTENT_TYPE) + descriptor->size);
+        if (plain == NULL)
+            return SIMFS_ALLOC_ERROR;
+        if (!decompressContent(descriptor, plain->data)) {
+            free(plain);
+            return SIMFS_READ_ERROR;
+        }
+        plain->next = NULL;
+        file->plainContent = plain;
+    }
+
+    int count = 0;
+    if (offset < end && *vectorCount > 0) {
+        vector[0].iov_base = file->plainContent->data + offset;
+        vector[0].iov_len = end - offset;
+        count = 1;
+    }
+
+    file->pinCount++;
+    descriptor->lastAccessTime = file->lastAccessTime = time(NULL);
+
+    *vectorCount = count;
+    return SIMFS_NO_ERROR;
+}
+
+static SIMFS_ERROR readFileVector(SIMFS_FILE_HANDLE_TYPE fileHandle, size_t offset, size_t size,
+                                  struct iovec *vector, int *vectorCount)
+{
+    SIMFS_OPEN_FILE_GLOBAL_TABLE_TYPE *file = openFileEntry(fileHandle);
+    if (file == NULL)
+        return SIMFS_SYSTEM_ERROR;
+
+    if (file->type != SIMFS_FILE_CONTENT_TYPE || !(file->accessRights & S_IRUSR))
+        return SIMFS_ACCESS_ERROR;
+
+    SIMFS_FILE_DESCRIPTOR_TYPE *descriptor = &simfsVolume->block[file->fileDescriptor].content.fileDescriptor;
+    size_t end = (offset + size < descriptor->size ? offset + size : descriptor->size);
+    if (descriptor->flags & SIMFS_FILE_COMPRESSED)
+        return readPlainVector(file, descriptor, offset, end, vector, vectorCount);
+
+    // skip the index blocks in front of the first requested data block, unless the read continues the last one
+
+    size_t start = offset;
+    size_t dataBlock = offset / SIMFS_DATA_SIZE;
+    SIMFS_INDEX_TYPE indexBlock = descriptor->block_ref;
+    if (offset == file->nextReadOffset && offset < end) {
+        indexBlock = file->nextReadIndexBlock;
+    } else {
+        for (size_t i = 0; i < dataBlock / (SIMFS_INDEX_SIZE - 1) && offset < end; i++) {
+            if (indexBlock == 0 || indexBlock == SIMFS_INVALID_INDEX)
+                return SIMFS_READ_ERROR;
+            indexBlock = simfsVolume->block[indexBlock].content.index[SIMFS_INDEX_SIZE - 1];
+        }
+    }
+
+    int count = 0;
+    int slot = dataBlock % (SIMFS_INDEX_SIZE - 1);
+    size_t ordinal = dataBlock / (SIMFS_INDEX_SIZE - 1); // position of indexBlock in the chain
+    SIMFS_INDEX_TYPE lastIndexBlock = indexBlock;
+    size_t lastOrdinal = ordinal;
+    while (offset < end && count < *vectorCount) {
+        if (indexBlock == 0 || indexBlock == SIMFS_INVALID_INDEX)
+            return SIMFS_READ_ERROR;
+
+        lastIndexBlock = indexBlock;
+        lastOrdinal = ordinal;
+        SIMFS_INDEX_TYPE *index = simfsVolume->block[indexBlock].content.index;
+        for (; slot < SIMFS_INDEX_SIZE - 1 && offset < end && count < *vectorCount; slot++) {
+            size_t inBlock = offset % SIMFS_DATA_SIZE;
+            size_t length = (end - offset < SIMFS_DATA_SIZE - inBlock ? end - offset : SIMFS_DATA_SIZE - inBlock);
+            vector[count].iov_base = simfsVolume->block[index[slot]].content.data + inBlock;
+            vector[count].iov_len = length;
+            count++;
+            offset += length;
+        }
+        indexBlock = index[SIMFS_INDEX_SIZE - 1];
+        ordinal++;
+        slot = 0;
+    }
+
+    // the read ended either inside the last index block visited or right at the start of the next one
+
+    if (count > 0) {
+        if (offset / SIMFS_DATA_SIZE / (SIMFS_INDEX_SIZE - 1) == lastOrdinal)
+            indexBlock = lastIndexBlock;
+        readahead(indexBlock, trackRead(file, start, offset, indexBlock));
+    }
 
+    file->pinCount++;
+    descriptor->lastAccessTime = file->lastAccessTime = time(NULL);
 
-    return SIMFS_WRITE_ERROR;
+    *vectorCount = count;
+    return SIMFS_NO_ERROR;
 }
 
+/***
+ * Releases the blocks pinned by a call to simfsReadFileVector. Content replaced while the file was pinned is freed
+ * with the last release.
+ */
+SIMFS_ERROR simfsReleaseFileVector(SIMFS_FILE_HANDLE_TYPE fileHandle)
+{
+    SIMFS_OPEN_FILE_GLOBAL_TABLE_TYPE *file = openFileEntry(fileHandle);
+    if (file == NULL || file->pinCount == 0)
+        return SIMFS_SYSTEM_ERROR;
+
+    file->pinCount--;
+    if (file->pinCount == 0 && file->retiredBlockRef != SIMFS_INVALID_INDEX) {
+        freeIndexChain(file->retiredBlockRef);
+        file->retiredBlockRef = SIMFS_INVALID_INDEX;
+        syncBitvector();
+    }
+    if (file->pinCount == 0) {
+        freePlainContent(file->retiredPlainContent);
+        file->retiredPlainContent = NULL;
+    }
 
-//////////////////////////////////////////////////////////////////////////
+    return SIMFS_NO_ERROR;
+}
 
 /***
- * Deletes a file from the file system.
+ * Turns the compression of the content of an open file on or off. The flag SIMFS_FILE_COMPRESSED is set or cleared
+ * in the file descriptor, and the content is read and written again, so that it is stored the new way. Writing the
+ * content takes new blocks before the old ones are freed, as for simfsWriteFile; if the volume has no room for it,
+ * SIMFS_ALLOC_ERROR is returned and the file is left as it was.
  *
- * Hashes the file name and check if the file is in the directory. If not, then it returns SIMFS_NOT_FOUND_ERROR.
- * Otherwise:
- *    - finds the reference to the file descriptor block
- *    - if the referenced block is a folder that is not empty, then returns SIMFS_NOT_EMPTY_ERROR.
- *    - Otherwise:
- *       - checks if the process owner can delete this file or folder; if not, it returns SIMFS_ACCESS_ERROR.
- *       - Otherwise:
- *          - frees all blocks belonging to the file by flipping the corresponding bits in the in-memory bitvector
- *          - frees the reference block by flipping the corresponding bit in the in-memory bitvector
- *          - clears the entry in the folder by removing the corresponding node in the list associated with
- *            the slot for this file
- *          - copies the in-memory bitvector to the bitvector blocks on the simulated disk
+ * As for simfsWriteFile, issues with the file handle are reported with SIMFS_SYSTEM_ERROR, and files the process
+ * may not read and write with SIMFS_ACCESS_ERROR.
  */
+static SIMFS_ERROR setFileCompression(SIMFS_FILE_HANDLE_TYPE fileHandle, int compressed);
 
+SIMFS_ERROR simfsSetFileCompression(SIMFS_FILE_HANDLE_TYPE fileHandle, int compressed)
+{
+    SIMFS_ERROR error = setFileCompression(fileHandle, compressed);
+    syncBitvector();
+    return error;
+}
 
-
-SIMFS_ERROR simfsDeleteFile(SIMFS_NAME_TYPE fileName)
+static SIMFS_ERROR setFileCompression(SIMFS_FILE_HANDLE_TYPE fileHandle, int compressed)
 {
-    // TODO: implement
-    struct ffret* indexPoint = findFile(fileName);
-    if (indexPoint == NULL){
-        return SIMFS_NOT_FOUND_ERROR;
-    }
-    SIMFS_INDEX_TYPE index2 = indexPoint->index[indexPoint->number];
-    SIMFS_INDEX_TYPE index = simfsVolume->block[index2].content.fileDescriptor.block_ref;
-    SIMFS_BLOCK_TYPE block = simfsVolume->block[index];
+    SIMFS_OPEN_FILE_GLOBAL_TABLE_TYPE *file = openFileEntry(fileHandle);
+    if (file == NULL)
+        return SIMFS_SYSTEM_ERROR;
+
+    if (file->type != SIMFS_FILE_CONTENT_TYPE || !(file->accessRights & S_IWUSR))
+        return SIMFS_ACCESS_ERROR;
 
+    SIMFS_FILE_DESCRIPTOR_TYPE *descriptor = &simfsVolume->block[file->fileDescriptor].content.fileDescriptor;
+    if (!(descriptor->flags & SIMFS_FILE_COMPRESSED) == !compressed)
+        return SIMFS_NO_ERROR;
+
+    char *content;
+    SIMFS_ERROR error = readFile(fileHandle, &content);
+    if (error != SIMFS_NO_ERROR)
+        return error;
+
+    descriptor->flags ^= SIMFS_FILE_COMPRESSED;
+    error = writeFile(fileHandle, content);
+    if (error != SIMFS_NO_ERROR)
+        descriptor->flags ^= SIMFS_FILE_COMPRESSED;
+
+    free(content);
+    return error;
+}
+
+/***
+ * Removes the entry for the file with the file handle provided as the parameter from the open file table
+ * for this process. It decreases the number of open files for the file in the process control block of
+ * this process, and if it becomes zero, then the process control block for this process is removed from
+ * the processControlBlocks list.
+ *
+ * Decreases the reference count in the global open file table, and if that number is 0, it also removes the entry
+ * for this file from the global open file table. In this case, it also removes the index to the global open file
+ * table from the directory entry for the file by overwriting it with SIMFS_INVALID_OPEN_FILE_TABLE_INDEX.
+ *
+ * The last reference is not closed while vectors of simfsReadFileVector are pinned, since they point into content
+ * that the close would free; the function returns SIMFS_ACCESS_ERROR until they are released.
+ *
+ */
+static SIMFS_ERROR closeFile(SIMFS_FILE_HANDLE_TYPE fileHandle);
 
+SIMFS_ERROR simfsCloseFile(SIMFS_FILE_HANDLE_TYPE fileHandle)
+{
+    unsigned long long start = simfsStatsClock();
+    return simfsStatsRecord(SIMFS_STATS_CLOSE_FILE, start, closeFile(fileHandle));
+}
 
-    if(block.type == SIMFS_INDEX_CONTENT_TYPE){
-        for (int i = 0; i < 7; ++i) {
-            if(block.content.index[i] != 0){
-                return SIMFS_NOT_EMPTY_ERROR;
+static SIMFS_ERROR closeFile(SIMFS_FILE_HANDLE_TYPE fileHandle)
+{
+    SIMFS_OPEN_FILE_GLOBAL_TABLE_TYPE* file = openFileEntry(fileHandle);
+    if (file == NULL)
+        return SIMFS_SYSTEM_ERROR;
+    if (file->referenceCount == 1 && file->pinCount > 0)
+        return SIMFS_ACCESS_ERROR;
+
+    // a handle opened by name and one opened by reference are the same index; the references without a slot in
+    // a process's open file table are released first, so the slot goes with the last reference that holds one
+    SIMFS_PROCESS_CONTROL_BLOCK_TYPE *process = simfsContext->processControlBlocks;
+    if (file->referenceCount == file->processReferences) {
+        for (int i = 0; i < SIMFS_MAX_NUMBER_OF_OPEN_FILES_PER_PROCESS; ++i) {
+            if (process->openFileTable[i].globalOpenFileTableIndex == (unsigned int) fileHandle) {
+                process->openFileTable[i].globalOpenFileTableIndex = SIMFS_INVALID_OPEN_FILE_TABLE_INDEX;
+                process->numberOfOpenFiles--;
+                file->processReferences--;
+                break;
             }
         }
-        simfsFlipBit(simfsVolume->bitvector, index);
-        simfsFlipBit(simfsContext->bitvector, index);
+    }
+
+    file->referenceCount--;
+    if (file->referenceCount == 0){
+        if (file->retiredBlockRef != SIMFS_INVALID_INDEX) {
+            freeIndexChain(file->retiredBlockRef);
+            syncBitvector();
+        }
+        freePlainContent(file->plainContent);
+        freePlainContent(file->retiredPlainContent);
 
-    } else if(simfsVolume->block[index].type == SIMFS_FILE_CONTENT_TYPE || simfsVolume->block[index].type == SIMFS_FOLDER_CONTENT_TYPE){
-        simfsFlipBit(simfsVolume->bitvector, simfsVolume->block[index].content.fileDescriptor.block_ref);
-        simfsFlipBit(simfsContext->bitvector, simfsVolume->block[index].content.fileDescriptor.block_ref);
-        simfsFlipBit(simfsVolume->bitvector, index);
-        simfsFlipBit(simfsContext->bitvector, index);
-        simfsVolume->block[indexPoint->index[indexPoint->number]].type = SIMFS_INVALID_CONTENT_TYPE;
+        SIMFS_DIR_ENT *entry = findDirEnt(file->fileDescriptor);
+        if (entry != NULL)
+            entry->globalOpenFileTableIndex = SIMFS_INVALID_OPEN_FILE_TABLE_INDEX;
+        file->type = SIMFS_INVALID_CONTENT_TYPE;
+        file->fileDescriptor = SIMFS_INVALID_INDEX;
     }
-    //todo remove file from hash
 
     return SIMFS_NO_ERROR;
 }
@@ -443,263 +2633,1028 @@ SIMFS_ERROR simfsDeleteFile(SIMFS_NAME_TYPE fileName)
 //////////////////////////////////////////////////////////////////////////
 
 /***
- * Finds the file in the in-memory directory and obtains the information about the file from the file descriptor
- * block referenced from the directory.
+ * Names referred to by the operations of a batch, in an open-addressing hash table that lives as long as
+ * the batch. Names are hashed and compared as the directory stores them, cut to SIMFS_MAX_NAME_LENGTH - 1
+ * characters.
+ */
+struct batchName {
+    char *name;
+    SIMFS_INDEX_TYPE node; // SIMFS_INVALID_INDEX if the folder holds no file with the name
+};
+
+static struct batchName *findBatchName(SIMFS_INDEX_TYPE folder, struct batchName *names, size_t capacity,
+                                       char *name, bool insert)
+{
+    size_t i = nameHash(name, nameLength(name)) & (capacity - 1);
+    while (names[i].name != NULL) {
+        if (strncmp(names[i].name, name, SIMFS_MAX_NAME_LENGTH - 1) == 0)
+            return &names[i];
+        i = (i + 1) & (capacity - 1);
+    }
+
+    if (!insert)
+        return NULL;
+
+    names[i].name = name;
+    names[i].node = findChild(folder, name);
+    return &names[i];
+}
+
+/***
+ * Executes an array of operations on the current working directory with one call. The result of each operation
+ * is returned in its result field and is the same as if the operation had been executed with the corresponding
+ * simfs function; operations are applied in the order of the array.
  *
- * If the file is not found, then it returns SIMFS_NOT_FOUND_ERROR
+ * Compared to separate calls:
+ *    - each name is looked up in the folder's directory once, however many operations refer to it,
+ *    - the blocks for all new folders and files are acquired with a single pass over the bitvector, and
+ *    - the in-memory bitvector is copied to the volume once, at the end of the batch.
+ *
+ * The function returns SIMFS_SYSTEM_ERROR for a missing array or a negative count, and SIMFS_ALLOC_ERROR if the
+ * batch could not be set up; otherwise it returns SIMFS_NO_ERROR, even if some of the operations failed.
  */
-SIMFS_ERROR simfsGetFileInfo(SIMFS_NAME_TYPE fileName, SIMFS_FILE_DESCRIPTOR_TYPE *infoBuffer)
+SIMFS_ERROR simfsSubmitBatch(SIMFS_BATCH_OPERATION_TYPE *operations, int count)
 {
-    // TODO: implement
-    struct ffret* ff = findFile(fileName);
-    SIMFS_BLOCK_TYPE file = simfsVolume->block[ff->index[ff->number]];
-    SIMFS_FILE_DESCRIPTOR_TYPE* fileDescriptor = &(file.content.fileDescriptor);
+    if (operations == NULL || count < 0)
+        return SIMFS_SYSTEM_ERROR;
+    if (count == 0)
+        return SIMFS_NO_ERROR;
 
-    infoBuffer->block_ref = fileDescriptor->block_ref;
-    infoBuffer->type = fileDescriptor->type;
-    infoBuffer->accessRights = fileDescriptor->accessRights;
-    infoBuffer->identifier = fileDescriptor->identifier;
-    strcpy(infoBuffer->name, fileDescriptor->name);
-    infoBuffer->creationTime = fileDescriptor->creationTime;
-    infoBuffer->lastAccessTime = fileDescriptor->lastAccessTime;
-    infoBuffer->lastModificationTime = fileDescriptor->lastModificationTime;
-    infoBuffer->owner = fileDescriptor->owner;
-    infoBuffer->size = fileDescriptor->size;
+    SIMFS_INDEX_TYPE folder = simfsContext->processControlBlocks->currentWorkingDirectory;
+
+    size_t capacity = 1;
+    while (capacity < 2 * (size_t) count)
+        capacity <<= 1;
+
+    struct batchName *names = calloc(capacity, sizeof(struct batchName));
+    SIMFS_INDEX_TYPE *blocks = malloc(2 * (count + 1) * sizeof(SIMFS_INDEX_TYPE));
+    if (names == NULL || blocks == NULL) {
+        free(names);
+        free(blocks);
+        return SIMFS_ALLOC_ERROR;
+    }
+
+    // collect and look up the names, and count the blocks needed by new folders and files
+
+    int needed = 0;
+    for (int i = 0; i < count; i++) {
+        switch (operations[i].operation) {
+            case SIMFS_CREATE_FILE_OPERATION:
+                needed += (operations[i].type == SIMFS_FOLDER_CONTENT_TYPE ? 2 : 1);
+                // fall through
+            case SIMFS_DELETE_FILE_OPERATION:
+            case SIMFS_GET_FILE_INFO_OPERATION:
+            case SIMFS_OPEN_FILE_OPERATION:
+                findBatchName(folder, names, capacity, operations[i].fileName, true);
+                break;
+            default:
+                break;
+        }
+    }
+
+    // acquire the blocks for all new folders and files at once
+
+    int available = allocateBlocks(SIMFS_METADATA_GROUP, needed, blocks);
+    int used = 0;
+
+    for (int i = 0; i < count; i++) {
+        SIMFS_BATCH_OPERATION_TYPE *operation = &operations[i];
+        struct batchName *entry = NULL;
+        if (operation->operation != SIMFS_WRITE_FILE_OPERATION && operation->operation != SIMFS_CLOSE_FILE_OPERATION)
+            entry = findBatchName(folder, names, capacity, operation->fileName, false);
+
+        switch (operation->operation) {
+            case SIMFS_CREATE_FILE_OPERATION: {
+                int blocksNeeded = (operation->type == SIMFS_FOLDER_CONTENT_TYPE ? 2 : 1);
+                if (entry->node != SIMFS_INVALID_INDEX) {
+                    operation->result = SIMFS_DUPLICATE_ERROR;
+                    break;
+                }
+                if (used + blocksNeeded > available) {
+                    operation->result = SIMFS_ALLOC_ERROR;
+                    break;
+                }
+
+                SIMFS_INDEX_TYPE node = blocks[used];
+                SIMFS_INDEX_TYPE blockRef = (blocksNeeded == 2 ? blocks[used + 1] : SIMFS_INVALID_INDEX);
+                if (!addRecord(folder, operation->fileName, node)) {
+                    operation->result = SIMFS_ALLOC_ERROR;
+                    break;
+                }
+
+                if (blockRef != SIMFS_INVALID_INDEX) {
+                    simfsVolume->block[blockRef].type = SIMFS_DIRECTORY_CONTENT_TYPE;
+                    memset(simfsVolume->block[blockRef].content.bucket, 0,
+                           sizeof(simfsVolume->block[blockRef].content.bucket));
+                }
+                if (!initDescriptor(node, operation->fileName, operation->type, blockRef)) {
+                    // the blocks are left for the next operation
+                    removeRecord(folder, simfsVolume->block[node].content.fileDescriptor.name);
+                    simfsVolume->block[node].type = SIMFS_INVALID_CONTENT_TYPE;
+                    if (blockRef != SIMFS_INVALID_INDEX)
+                        simfsVolume->block[blockRef].type = SIMFS_INVALID_CONTENT_TYPE;
+                    operation->result = SIMFS_ALLOC_ERROR;
+                    break;
+                }
+                used += blocksNeeded;
+
+                entry->node = node;
+                operation->result = SIMFS_NO_ERROR;
+                break;
+            }
+            case SIMFS_DELETE_FILE_OPERATION:
+                if (entry->node == SIMFS_INVALID_INDEX) {
+                    operation->result = SIMFS_NOT_FOUND_ERROR;
+                    break;
+                }
+                operation->result = deleteChild(folder, entry->node);
+                if (operation->result == SIMFS_NO_ERROR)
+                    entry->node = SIMFS_INVALID_INDEX;
+                break;
+            case SIMFS_GET_FILE_INFO_OPERATION:
+                operation->result = (entry->node == SIMFS_INVALID_INDEX ? SIMFS_NOT_FOUND_ERROR
+                                     : getFileInfo(entry->node, operation->infoBuffer));
+                break;
+            case SIMFS_OPEN_FILE_OPERATION:
+                operation->result = (entry->node == SIMFS_INVALID_INDEX ? SIMFS_NOT_FOUND_ERROR
+                                     : openFile(entry->node, &operation->fileHandle));
+                break;
+            case SIMFS_WRITE_FILE_OPERATION:
+                operation->result = writeFile(operation->fileHandle, operation->writeBuffer);
+                break;
+            case SIMFS_CLOSE_FILE_OPERATION:
+                operation->result = closeFile(operation->fileHandle);
+                break;
+            default:
+                operation->result = SIMFS_SYSTEM_ERROR;
+        }
+    }
+
+    // return the blocks that were not needed and update the volume's bitvector once
+
+    for (int i = used; i < available; i++)
+        simfsClearBit(simfsContext->bitvector, blocks[i]);
+    simfsStatsBlocks(0, available - used);
+    syncBitvector();
 
+    free(names);
+    free(blocks);
     return SIMFS_NO_ERROR;
 }
 
 //////////////////////////////////////////////////////////////////////////
 
 /***
- * Creates an in-memory description of the file for fast access.
- *
- * - hashes the name and searches for it in the in-memory directory resolving potential conflicts using the
- *   unique identifier.
- *
- *   If the file does not exist (i.e., the slot obtained by hashing is NULL), the SIMFS_NOT_FOUND_ERROR is returned.
- *
- * Otherwise:
- *
- *    - if there is a global entry for the file (as indicated by the index to the global open file table in the
- *      directory entry), then:
- *
- *       - it increases the reference count for this file
- *
- *       - otherwise
- *          - finds an empty slot in the global open file table and adds an entry for the file
- *          - copies the information from the file descriptor block referenced from the directory entry for
- *            this file to the new entry in the global open file table
- *          - sets the reference count of the file to 1
- *          - adds the index of the entry in the global open file table to the directory entry for this file
- *
- *   - checks if the process has its process control block in the processControlBlocks list
- *      - if not, then a file control block for the process is created and added to the list; the current
- *        working directory is initialized to the root of the volume and the number of the open files is
- *        initialized to 1; the process id should be simulated for testing; it will be possible to obtain
- *        the actual pid after integration with FUSE
- *
- *     - scans the per-process open file table of the process checking if an entry for the file already
- *      exists in the table (i.e., the file has already been opened)
- *
- *       - if the entry indeed does exists, the function returns the index of the entry through the parameter
- *         fileHandle, and then returns SIMFS_DUPLICATE_ERROR as the return value. This is not a fatal error.
+ * Finds the first run of length free blocks of an allocation group in the in-memory bitvector, or of the other
+ * group if that one has none, and marks it as used; returns SIMFS_INVALID_INDEX if there is no such run.
+ */
+static SIMFS_INDEX_TYPE takeFreeRun(SIMFS_ALLOCATION_GROUP_TYPE group, int length)
+{
+    if (length == 0)
+        return 0;
+
+    for (int g = 0; g < SIMFS_NUMBER_OF_GROUPS; g++) {
+        int from = (group + g) % SIMFS_NUMBER_OF_GROUPS, run = 0;
+        for (int i = groupStart[from]; i < groupStart[from + 1]; i++) {
+            if (i % 8 == 0 && simfsContext->bitvector[i / 8] == 0xFF) {
+                run = 0;
+                i += 7;
+                continue;
+            }
+            run = (simfsContext->bitvector[i / 8] & (0x80 >> (i % 8)) ? 0 : run + 1);
+            if (run == length) {
+                for (int j = i - length + 1; j <= i; j++)
+                    simfsSetBit(simfsContext->bitvector, j);
+                simfsStatsBlocks(length, 0);
+                return i - length + 1;
+            }
+        }
+    }
+    return SIMFS_INVALID_INDEX;
+}
+
+static void releaseRun(SIMFS_INDEX_TYPE start, int length)
+{
+    for (int i = 0; i < length; i++)
+        simfsClearBit(simfsContext->bitvector, start + i);
+    simfsStatsBlocks(0, length);
+}
+
+/***
+ * Counts the index blocks, returned, and the data blocks, through the parameter dataBlocks, of the index chain of a
+ * file. Sets the parameter contiguous if the index blocks follow each other in the metadata group and the data
+ * blocks, in the order in which a reader visits them, in the data group. Data blocks shared with other files by
+ * deduplication stay where they are, so they are neither counted nor expected to follow the others.
+ */
+static int chainLength(SIMFS_INDEX_TYPE first, int *dataBlocks, bool *contiguous)
+{
+    int indexBlocks = 0;
+    SIMFS_INDEX_TYPE firstData = SIMFS_INVALID_INDEX;
+    *dataBlocks = 0;
+    *contiguous = (first == SIMFS_INVALID_INDEX || first < SIMFS_METADATA_GROUP_SIZE);
+    for (SIMFS_INDEX_TYPE indexBlock = first; indexBlock != 0 && indexBlock != SIMFS_INVALID_INDEX;) {
+        *contiguous = *contiguous && indexBlock == first + indexBlocks;
+        indexBlocks++;
+
+        SIMFS_INDEX_TYPE *index = simfsVolume->block[indexBlock].content.index;
+        for (int j = 0; j < SIMFS_INDEX_SIZE - 1; j++) {
+            if (index[j] != 0 && simfsContext->dataReferences[index[j]] <= 1) {
+                if (firstData == SIMFS_INVALID_INDEX)
+                    firstData = index[j];
+                *contiguous = *contiguous && firstData >= SIMFS_METADATA_GROUP_SIZE
+                              && index[j] == firstData + *dataBlocks;
+                (*dataBlocks)++;
+            }
+        }
+        indexBlock = index[SIMFS_INDEX_SIZE - 1];
+    }
+    return indexBlocks;
+}
+
+/***
+ * Counts the blocks of a folder's directory. Sets the parameter contiguous if they follow each other in the
+ * metadata group in the order in which a listing visits them: the root, then the leaves bucket by bucket.
+ */
+static int directoryLength(SIMFS_INDEX_TYPE root, bool *contiguous)
+{
+    int length = 1;
+    *contiguous = (root < SIMFS_METADATA_GROUP_SIZE);
+    for (int i = 0; i < SIMFS_DIRECTORY_BUCKETS; i++) {
+        for (SIMFS_INDEX_TYPE leaf = simfsVolume->block[root].content.bucket[i]; leaf != 0;
+             leaf = simfsVolume->block[leaf].content.leaf.next) {
+            *contiguous = *contiguous && leaf == root + length;
+            length++;
+        }
+    }
+    return length;
+}
+
+/***
+ * Counts the blocks that a relocation of the folder or file held in the given file descriptor block moves into the
+ * metadata group and into the data group; returns true if they are in place already.
+ */
+static bool chainInPlace(SIMFS_INDEX_TYPE node, int *metadataBlocks, int *dataBlocks)
+{
+    SIMFS_INDEX_TYPE first = simfsVolume->block[node].content.fileDescriptor.block_ref;
+    bool contiguous;
+    if (simfsVolume->block[node].type == SIMFS_FOLDER_CONTENT_TYPE) {
+        *metadataBlocks = directoryLength(first, &contiguous);
+        *dataBlocks = 0;
+    } else {
+        *metadataBlocks = chainLength(first, dataBlocks, &contiguous);
+    }
+    return contiguous;
+}
+
+/***
+ * Copies the index chain of a file into the index blocks starting with indexStart and the data blocks starting
+ * with dataStart, and returns the first block of the copy. A shared data block is not copied; the copy of the chain
+ * takes another reference to it, which the release of the old chain drops again.
+ */
+static SIMFS_INDEX_TYPE copyChain(SIMFS_INDEX_TYPE first, SIMFS_INDEX_TYPE indexStart, SIMFS_INDEX_TYPE dataStart)
+{
+    SIMFS_INDEX_TYPE indexCursor = indexStart, dataCursor = dataStart;
+    for (SIMFS_INDEX_TYPE indexBlock = first; indexBlock != 0 && indexBlock != SIMFS_INVALID_INDEX;) {
+        SIMFS_INDEX_TYPE *index = simfsVolume->block[indexBlock].content.index;
+        SIMFS_BLOCK_TYPE *copy = &simfsVolume->block[indexCursor++];
+        copy->type = SIMFS_INDEX_CONTENT_TYPE;
+
+        for (int j = 0; j < SIMFS_INDEX_SIZE - 1; j++) {
+            if (index[j] != 0 && simfsContext->dataReferences[index[j]] > 1) {
+                simfsContext->dataReferences[index[j]]++;
+                copy->content.index[j] = index[j];
+            } else if (index[j] != 0) {
+                if (simfsContext->fingerprints != NULL)
+                    unindexDataBlock(index[j]);
+                simfsVolume->block[dataCursor] = simfsVolume->block[index[j]];
+                simfsContext->dataReferences[dataCursor] = 1;
+                if (simfsContext->fingerprints != NULL)
+                    indexDataBlock(dataCursor);
+                copy->content.index[j] = dataCursor++;
+            } else {
+                copy->content.index[j] = 0;
+            }
+        }
+
+        indexBlock = index[SIMFS_INDEX_SIZE - 1];
+        copy->content.index[SIMFS_INDEX_SIZE - 1] = (indexBlock != 0 ? indexCursor : 0);
+    }
+    return indexStart;
+}
+
+/***
+ * Copies a folder's directory into the blocks starting with start and returns the root of the copy.
+ */
+static SIMFS_INDEX_TYPE copyDirectory(SIMFS_INDEX_TYPE root, SIMFS_INDEX_TYPE start)
+{
+    simfsVolume->block[start] = simfsVolume->block[root];
+    SIMFS_INDEX_TYPE cursor = start + 1;
+    for (int i = 0; i < SIMFS_DIRECTORY_BUCKETS; i++) {
+        SIMFS_INDEX_TYPE *link = &simfsVolume->block[start].content.bucket[i];
+        for (SIMFS_INDEX_TYPE leaf = *link; leaf != 0; leaf = simfsVolume->block[leaf].content.leaf.next) {
+            simfsVolume->block[cursor] = simfsVolume->block[leaf];
+            *link = cursor;
+            link = &simfsVolume->block[cursor++].content.leaf.next;
+        }
+    }
+    return start;
+}
+
+/***
+ * Moves the directory of the folder or the index chain of the file held in the given file descriptor block into one
+ * run of free blocks in the metadata group and, for a file, one run of free data blocks in the data group.
  *
- *       - otherwise:
- *          - the function finds an empty slot in the table and fills it with the information including
- *            the index to the entry for this file in the global open file table
+ * The copy is complete before block_ref is switched to it, so the folder or file is never seen half moved. The file
+ * descriptor block itself stays where it is, which keeps the slot in the parent folder, the directory entry, open
+ * file handles and the inode numbers of the FUSE driver valid. Content pinned by simfsReadFileVector is retired as
+ * for a write.
  *
- *          - returns the index to the new element of the per-process open file table through the parameter
- *            fileHandle and SIMFS_NO_ERROR as the return value.
+ * Returns the number of blocks moved, 0 if the chain is contiguous already, or -1 if no free run is long enough.
+ */
+static int relocateChain(SIMFS_INDEX_TYPE node)
+{
+    SIMFS_FILE_DESCRIPTOR_TYPE *descriptor = &simfsVolume->block[node].content.fileDescriptor;
+    bool isFile = (simfsVolume->block[node].type == SIMFS_FILE_CONTENT_TYPE);
+    SIMFS_INDEX_TYPE old = descriptor->block_ref;
+    if (old == SIMFS_INVALID_INDEX)
+        return 0;
+
+    int indexBlocks, dataBlocks;
+    if (chainInPlace(node, &indexBlocks, &dataBlocks))
+        return 0;
+
+    SIMFS_INDEX_TYPE indexStart = takeFreeRun(SIMFS_METADATA_GROUP, indexBlocks);
+    if (indexStart == SIMFS_INVALID_INDEX)
+        return -1;
+    SIMFS_INDEX_TYPE dataStart = takeFreeRun(SIMFS_DATA_GROUP, dataBlocks);
+    if (dataStart == SIMFS_INVALID_INDEX) {
+        releaseRun(indexStart, indexBlocks);
+        return -1;
+    }
+
+    descriptor->block_ref = (isFile ? copyChain(old, indexStart, dataStart) : copyDirectory(old, indexStart));
+
+    SIMFS_DIR_ENT *entry = findDirEnt(node);
+    SIMFS_OPEN_FILE_GLOBAL_TABLE_TYPE *file = NULL;
+    if (entry != NULL && entry->globalOpenFileTableIndex != SIMFS_INVALID_OPEN_FILE_TABLE_INDEX)
+        file = &simfsContext->globalOpenFileTable[entry->globalOpenFileTableIndex];
+
+    if (file != NULL) {
+        // the read position referred to the old chain
+        file->nextReadOffset = 0;
+        file->nextReadIndexBlock = descriptor->block_ref;
+        file->readaheadWindow = 0;
+    }
+
+    if (isFile && file != NULL && file->pinCount > 0) {
+        retireIndexChain(file, old);
+    } else if (isFile) {
+        freeIndexChain(old);
+    } else {
+        freeDirectory(old);
+    }
+
+    return indexBlocks + dataBlocks;
+}
+
+/***
+ * Performs a step of the compaction of the volume: the directories of folders and the index chains of files are
+ * moved, one at a time, into runs of consecutive free blocks of their allocation groups, so that a sequential
+ * reader finds the blocks of a folder or file next to each other.
  *
- * If there is no free slot for the file in either the global file table or in the per-process
- * file table, or if there is any other allocation problem, then the function returns SIMFS_ALLOC_ERROR.
+ * The function returns after moving about blockBudget blocks, remembering where to continue in the parameter
+ * compaction; calling it with a small budget between other operations, or when they are idle, spreads the work
+ * so that the operations are not held up for long. A chain longer than the budget is still moved if it is the
+ * first one of the step, so every chain gets its turn.
  *
+ * The first free run that is long enough is taken, so moved chains gather towards the start of their groups.
+ */
+SIMFS_ERROR simfsCompact(SIMFS_COMPACTION_TYPE *compaction, int blockBudget)
+{
+    if (compaction == NULL || simfsContext == NULL || simfsVolume == NULL)
+        return SIMFS_SYSTEM_ERROR;
+
+    int moved = 0;
+    while (compaction->next < SIMFS_NUMBER_OF_BLOCKS && (moved == 0 || moved < blockBudget)) {
+        SIMFS_INDEX_TYPE node = compaction->next;
+        SIMFS_CONTENT_TYPE type = simfsVolume->block[node].type;
+        if (type != SIMFS_FOLDER_CONTENT_TYPE && type != SIMFS_FILE_CONTENT_TYPE) {
+            compaction->next++;
+            continue;
+        }
+
+        int metadataBlocks, dataBlocks;
+        chainInPlace(node, &metadataBlocks, &dataBlocks);
+        int length = metadataBlocks + dataBlocks;
+        if (moved > 0 && moved + length > blockBudget)
+            break;
+        compaction->next++;
+
+        int relocated = relocateChain(node);
+        if (relocated < 0) {
+            compaction->skippedFiles++;
+        } else if (relocated > 0) {
+            compaction->relocatedFiles++;
+            compaction->relocatedBlocks += relocated;
+        }
+        moved += length;
+    }
+
+    syncBitvector();
+    return SIMFS_NO_ERROR;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+//
+// state of a consistency check shared by its threads
+//
+// Each block is counted once for every reference to it, and remembers the folder or file that referenced it last;
+// for a folder or file, that is a folder listing it.
+//
+struct checkScan {
+    uint32_t references[SIMFS_NUMBER_OF_BLOCKS];
+    SIMFS_INDEX_TYPE owner[SIMFS_NUMBER_OF_BLOCKS];
+    bool live[SIMFS_NUMBER_OF_BLOCKS];
+    SIMFS_INDEX_TYPE root;
+};
+
+//
+// a contiguous range of blocks checked by one thread, with the partial findings and directory table of the range
+//
+struct checkRange {
+    SIMFS_INSTANCE_TYPE *instance;
+    struct checkScan *scan;
+    int start;
+    int end;
+    SIMFS_CHECK_TYPE found;
+    SIMFS_INDEX_TYPE *nodes; // the live folders and files of the range, for rebuilding the directory
+    int numberOfNodes;
+};
+
+static bool holdsType(SIMFS_INDEX_TYPE block, SIMFS_CONTENT_TYPE type)
+{
+    return block < SIMFS_NUMBER_OF_BLOCKS && simfsVolume->block[block].type == type;
+}
+
+static void addReference(struct checkRange *range, SIMFS_INDEX_TYPE block, SIMFS_INDEX_TYPE owner)
+{
+    __atomic_fetch_add(&range->scan->references[block], 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&range->scan->owner[block], owner, __ATOMIC_RELAXED);
+}
+
+/***
+ * Counts the references of a file to its index and data blocks. The walks of the check do not trust the volume:
+ * they stop at a reference to a block of the wrong type and after as many blocks as the volume has.
+ */
+static void checkFile(struct checkRange *range, SIMFS_INDEX_TYPE node)
+{
+    SIMFS_INDEX_TYPE indexBlock = simfsVolume->block[node].content.fileDescriptor.block_ref;
+    for (int depth = 0; indexBlock != 0 && indexBlock != SIMFS_INVALID_INDEX; depth++) {
+        if (!holdsType(indexBlock, SIMFS_INDEX_CONTENT_TYPE) || depth == SIMFS_NUMBER_OF_BLOCKS) {
+            range->found.brokenReferences++;
+            return;
+        }
+        addReference(range, indexBlock, node);
+
+        SIMFS_INDEX_TYPE *index = simfsVolume->block[indexBlock].content.index;
+        for (int j = 0; j < SIMFS_INDEX_SIZE - 1; j++) {
+            if (holdsType(index[j], SIMFS_DATA_CONTENT_TYPE))
+                addReference(range, index[j], node);
+            else if (index[j] != 0)
+                range->found.brokenReferences++;
+        }
+        indexBlock = index[SIMFS_INDEX_SIZE - 1];
+    }
+}
+
+/***
+ * Counts the references of a folder to the blocks of its directory and to its children.
  */
+static void checkFolder(struct checkRange *range, SIMFS_INDEX_TYPE node)
+{
+    SIMFS_INDEX_TYPE root = simfsVolume->block[node].content.fileDescriptor.block_ref;
+    if (!holdsType(root, SIMFS_DIRECTORY_CONTENT_TYPE)) {
+        range->found.brokenReferences++;
+        return;
+    }
+    addReference(range, root, node);
+
+    int leaves = 0;
+    for (int i = 0; i < SIMFS_DIRECTORY_BUCKETS; i++) {
+        for (SIMFS_INDEX_TYPE leaf = simfsVolume->block[root].content.bucket[i]; leaf != 0;
+             leaf = simfsVolume->block[leaf].content.leaf.next) {
+            if (!holdsType(leaf, SIMFS_DIRECTORY_CONTENT_TYPE) || leaves++ == SIMFS_NUMBER_OF_BLOCKS) {
+                range->found.brokenReferences++;
+                break;
+            }
+            addReference(range, leaf, node);
+
+            int used = simfsVolume->block[leaf].content.leaf.used;
+            if (used > (int) SIMFS_DIRECTORY_LEAF_SIZE)
+                used = SIMFS_DIRECTORY_LEAF_SIZE;
+            for (int offset = 0; offset + (int) RECORD_SIZE(0) <= used;) {
+                SIMFS_DIRECTORY_RECORD_TYPE *record = leafRecord(leaf, offset);
+                SIMFS_INDEX_TYPE child = record->node;
+                if (holdsType(child, SIMFS_FOLDER_CONTENT_TYPE) || holdsType(child, SIMFS_FILE_CONTENT_TYPE))
+                    addReference(range, child, node);
+                else
+                    range->found.brokenReferences++;
+                offset += RECORD_SIZE(record->nameLength);
+            }
+        }
+    }
+}
+
+/***
+ * First pass over a range: classifies its blocks by content type and counts the references made by its folders and
+ * files. It runs as the start routine of a thread, like the other passes.
+ */
+static void *scanCheckRange(void *argument)
+{
+    struct checkRange *range = argument;
+    currentInstance = range->instance;
+
+    for (int i = range->start; i < range->end; i++) {
+        SIMFS_CONTENT_TYPE type = simfsVolume->block[i].type;
+        range->found.blocksByType[type <= SIMFS_INVALID_CONTENT_TYPE ? type : SIMFS_INVALID_CONTENT_TYPE]++;
+        if (type == SIMFS_FILE_CONTENT_TYPE)
+            checkFile(range, i);
+        else if (type == SIMFS_FOLDER_CONTENT_TYPE)
+            checkFolder(range, i);
+    }
+    return NULL;
+}
 
+/***
+ * Returns true if a folder or file is listed, through its ancestors, below the root folder.
+ */
+static bool isReachable(struct checkScan *scan, SIMFS_INDEX_TYPE node)
+{
+    for (int depth = 0; depth < SIMFS_NUMBER_OF_BLOCKS; depth++) {
+        if (node == scan->root)
+            return true;
+        if (scan->references[node] == 0 || !holdsType(scan->owner[node], SIMFS_FOLDER_CONTENT_TYPE))
+            return false;
+        node = scan->owner[node];
+    }
+    return false; // a cycle of folders
+}
 
-int findEmptyInFileTable(){
-    for (int i = 0; i < SIMFS_MAX_NUMBER_OF_OPEN_FILES; ++i) {
-        if(simfsContext->globalOpenFileTable[i].type == SIMFS_INVALID_CONTENT_TYPE){
-            return i;
+/***
+ * Second pass over a range: decides which of its blocks are live and compares that with the bitvector.
+ */
+static void *settleCheckRange(void *argument)
+{
+    struct checkRange *range = argument;
+    currentInstance = range->instance;
+    struct checkScan *scan = range->scan;
+
+    for (int i = range->start; i < range->end; i++) {
+        SIMFS_CONTENT_TYPE type = simfsVolume->block[i].type;
+        bool descriptor = (type == SIMFS_FOLDER_CONTENT_TYPE || type == SIMFS_FILE_CONTENT_TYPE);
+        bool live;
+        if (scan->references[i] > 1 && type == SIMFS_DATA_CONTENT_TYPE) {
+            range->found.sharedBlocks++; // shared by deduplication
+            live = true;
+        } else if (scan->references[i] > 1) {
+            range->found.doublyReferencedBlocks++;
+            live = true;
+        } else if (descriptor) {
+            live = isReachable(scan, i);
+            if (!live)
+                range->found.orphanedDescriptors++;
+        } else {
+            live = (scan->references[i] == 1 && isReachable(scan, scan->owner[i]));
         }
+
+        bool used = simfsContext->bitvector[i / 8] & (0x80 >> (i % 8));
+        if (used && !live)
+            range->found.orphanedBlocks++;
+        else if (live && !used)
+            range->found.unmarkedBlocks++;
+
+        scan->live[i] = live;
+        if (!live)
+            continue;
+        range->found.liveBlocks++;
+        if (type == SIMFS_FOLDER_CONTENT_TYPE)
+            range->found.folders++;
+        else if (type == SIMFS_FILE_CONTENT_TYPE)
+            range->found.files++;
+        if (descriptor && range->nodes != NULL)
+            range->nodes[range->numberOfNodes++] = i;
     }
-    return -1;
+    return NULL;
 }
 
-void setGOFTV(int fileIndex, SIMFS_INDEX_TYPE fileDescriptorType){
-    SIMFS_BLOCK_TYPE file = simfsVolume->block[fileDescriptorType];
-    SIMFS_OPEN_FILE_GLOBAL_TABLE_TYPE* globalTableType = &(simfsContext->globalOpenFileTable[fileIndex]);
-
-    globalTableType->type = file.type;
-    globalTableType->fileDescriptor = fileDescriptorType;
-    globalTableType->referenceCount = 1;
-    globalTableType->accessRights = file.content.fileDescriptor.accessRights;
-    globalTableType->creationTime = file.content.fileDescriptor.creationTime;
-    globalTableType->lastAccessTime = file.content.fileDescriptor.lastAccessTime;
-    globalTableType->lastModificationTime = file.content.fileDescriptor.lastModificationTime;
-    globalTableType->owner = file.content.fileDescriptor.owner;
-    globalTableType->size = file.content.fileDescriptor.size;
+/***
+ * Takes a block dropped by a live file out of the live ones, unless other references keep it.
+ */
+static void dropReference(struct checkScan *scan, SIMFS_INDEX_TYPE block)
+{
+    if (scan->references[block] > 1)
+        scan->references[block]--;
+    else
+        scan->live[block] = false;
 }
 
-//SIMFS_FILE_DESCRIPTOR_TYPE* searchFileTable(SIMFS_NAME_TYPE name, unsigned long long int identifier){
-//    SIMFS_PROCESS_CONTROL_BLOCK_TYPE* current = simfsContext->processControlBlocks;
-//
-//    while (current != NULL){
-//        if(simfsVolume->block[simfsContext->globalOpenFileTable[current->openFileTable->globalOpenFileTableIndex].fileDescriptor].content.fileDescriptor.identifier == identifier){
-//            return &(simfsVolume->block[simfsContext->globalOpenFileTable[current->openFileTable->globalOpenFileTableIndex].fileDescriptor].content.fileDescriptor);
-//        }
-//        current = current->next;
-//    }
-//
-//
-//    return NULL;
-//}
+/***
+ * Cuts a live file at its first reference to a block that is not live or not of the right type. The references
+ * after the cut are zeroed and the blocks they lead to dropped, and the size is reduced to the data blocks kept. A
+ * compressed file that is cut is left empty, since its chunks cannot be told apart without the rest of the chain.
+ */
+static void truncateCheckedFile(struct checkScan *scan, SIMFS_INDEX_TYPE node)
+{
+    SIMFS_FILE_DESCRIPTOR_TYPE *descriptor = &simfsVolume->block[node].content.fileDescriptor;
+    SIMFS_INDEX_TYPE *link = &descriptor->block_ref;
+    SIMFS_INDEX_TYPE indexBlock = *link;
+    size_t kept = 0;
+    bool cut = false, damaged = false;
+
+    for (int depth = 0; indexBlock != 0 && indexBlock != SIMFS_INVALID_INDEX; depth++) {
+        if (!holdsType(indexBlock, SIMFS_INDEX_CONTENT_TYPE) || !scan->live[indexBlock]
+            || depth == SIMFS_NUMBER_OF_BLOCKS) {
+            if (!cut)
+                *link = 0;
+            damaged = true;
+            break;
+        }
+        if (cut)
+            dropReference(scan, indexBlock);
+
+        SIMFS_INDEX_TYPE *index = simfsVolume->block[indexBlock].content.index;
+        for (int j = 0; j < SIMFS_INDEX_SIZE - 1; j++) {
+            bool valid = holdsType(index[j], SIMFS_DATA_CONTENT_TYPE) && scan->live[index[j]];
+            if (!cut && valid) {
+                kept++;
+                continue;
+            }
+            cut = true;
+            if (index[j] == 0)
+                continue;
+            if (valid)
+                dropReference(scan, index[j]);
+            index[j] = 0;
+            damaged = true;
+        }
 
-SIMFS_ERROR simfsOpenFile(SIMFS_NAME_TYPE fileName, SIMFS_FILE_HANDLE_TYPE *fileHandle)
+        indexBlock = index[SIMFS_INDEX_SIZE - 1];
+        link = &index[SIMFS_INDEX_SIZE - 1];
+        if (cut && indexBlock != 0)
+            *link = 0;
+    }
+
+    if (damaged && descriptor->flags & SIMFS_FILE_COMPRESSED) {
+        descriptor->flags &= ~SIMFS_FILE_COMPRESSED;
+        descriptor->size = 0;
+    } else if (descriptor->size > kept * SIMFS_DATA_SIZE) {
+        descriptor->size = kept * SIMFS_DATA_SIZE;
+    }
+}
+
+/***
+ * Removes from the directory of a live folder the records of folders and files that are not live, after cutting
+ * its buckets at the first leaf that is not live, and counts the records left into the size of the folder.
+ * Returns false if the root block of the directory is lost, which leaves the folder as it is.
+ */
+static bool pruneCheckedFolder(struct checkScan *scan, SIMFS_INDEX_TYPE folder)
 {
-    // TODO: implement
-    struct ffret* hashLocation = findFile(fileName);
-    if(hashLocation == NULL){
-        return SIMFS_NOT_FOUND_ERROR;
+    SIMFS_FILE_DESCRIPTOR_TYPE *descriptor = &simfsVolume->block[folder].content.fileDescriptor;
+    SIMFS_INDEX_TYPE root = descriptor->block_ref;
+    if (!holdsType(root, SIMFS_DIRECTORY_CONTENT_TYPE) || !scan->live[root])
+        return false;
+
+    int leaves = 0;
+    bool cut = false;
+    for (int i = 0; i < SIMFS_DIRECTORY_BUCKETS; i++) {
+        for (SIMFS_INDEX_TYPE *link = &simfsVolume->block[root].content.bucket[i]; *link != 0;
+             link = &simfsVolume->block[*link].content.leaf.next) {
+            if (!holdsType(*link, SIMFS_DIRECTORY_CONTENT_TYPE) || !scan->live[*link]
+                || leaves++ == SIMFS_NUMBER_OF_BLOCKS) {
+                *link = 0;
+                cut = true;
+                break;
+            }
+            if (simfsVolume->block[*link].content.leaf.used > SIMFS_DIRECTORY_LEAF_SIZE)
+                simfsVolume->block[*link].content.leaf.used = SIMFS_DIRECTORY_LEAF_SIZE;
+        }
     }
 
-    if(simfsContext->directory[hashLocation->index[hashLocation->number]] != NULL && simfsContext->directory[hashLocation->index[hashLocation->number]]->globalOpenFileTableIndex != SIMFS_INVALID_OPEN_FILE_TABLE_INDEX){
-        simfsContext->globalOpenFileTable[simfsContext->directory[hashLocation->index[hashLocation->number]]->globalOpenFileTableIndex].referenceCount++;
-        *fileHandle = simfsContext->directory[hashLocation->index[hashLocation->number]]->globalOpenFileTableIndex;
-        if(simfsContext->processControlBlocks->openFileTable->globalOpenFileTableIndex == SIMFS_INVALID_OPEN_FILE_TABLE_INDEX){
-            simfsContext->processControlBlocks->openFileTable->globalOpenFileTableIndex = *fileHandle;
-            simfsContext->processControlBlocks->numberOfOpenFiles = 1;
-        } else{
-            SIMFS_PROCESS_CONTROL_BLOCK_TYPE* previous = simfsContext->processControlBlocks;
-            simfsContext->processControlBlocks = malloc(sizeof(SIMFS_PROCESS_CONTROL_BLOCK_TYPE));
-            simfsContext->processControlBlocks->next = previous;
-            simfsContext->processControlBlocks->numberOfOpenFiles++;
+    // the walk starts over after each removal, which moves the records behind the one removed
+    struct directoryCursor cursor;
+    startDirectoryWalk(&cursor, folder);
+    for (SIMFS_DIRECTORY_RECORD_TYPE *record = nextRecord(&cursor); record != NULL;) {
+        SIMFS_INDEX_TYPE child = record->node;
+        if ((holdsType(child, SIMFS_FOLDER_CONTENT_TYPE) || holdsType(child, SIMFS_FILE_CONTENT_TYPE))
+            && scan->live[child]) {
+            record = nextRecord(&cursor);
+            continue;
         }
-    } else {
-        int fileIndex = findEmptyInFileTable();
-        if (fileIndex == -1) {
-            return SIMFS_ALLOC_ERROR;
+
+        char name[SIMFS_MAX_NAME_LENGTH] = {0};
+        memcpy(name, record->name, record->nameLength < SIMFS_MAX_NAME_LENGTH ? record->nameLength
+                                                                              : SIMFS_MAX_NAME_LENGTH - 1);
+        if (findRecord(folder, name, NULL) != record) {
+            record = nextRecord(&cursor); // a record that its name does not find is left to the next check
+            continue;
         }
-        setGOFTV(fileIndex, hashLocation->index[hashLocation->number]);
-        simfsContext->directory[hashLocation->index[hashLocation->number]] = malloc(sizeof(SIMFS_OPEN_FILE_GLOBAL_TABLE_TYPE));
-        simfsContext->directory[hashLocation->index[hashLocation->number]]->globalOpenFileTableIndex = fileIndex;
-        *fileHandle = fileIndex;
-        return SIMFS_NO_ERROR;
+        removeRecord(folder, name);
+        startDirectoryWalk(&cursor, folder);
+        record = nextRecord(&cursor);
     }
 
-    return SIMFS_DUPLICATE_ERROR;
+    // the records of the leaves cut off are gone without removeRecord counting them out
+    unsigned int size = 0;
+    startDirectoryWalk(&cursor, folder);
+    while (nextRecord(&cursor) != NULL)
+        size++;
+    if (cut || descriptor->size != size) {
+        descriptor->size = size;
+        freeNameFilter(folder); // it still counts the names cut off, and is built again when needed
+        simfsContext->folderGeneration[folder]++;
+    }
+    return true;
 }
 
-//////////////////////////////////////////////////////////////////////////
+/***
+ * Gives a live folder whose directory is lost a new, empty one, in the first block of the metadata group, then of
+ * the data group, that is not live. Returns false if every block is live.
+ */
+static bool replaceCheckedDirectory(struct checkScan *scan, SIMFS_INDEX_TYPE folder)
+{
+    for (int g = 0; g < SIMFS_NUMBER_OF_GROUPS; g++) {
+        for (int i = groupStart[g]; i < groupStart[g + 1]; i++) {
+            if (scan->live[i])
+                continue;
+
+            scan->live[i] = true;
+            simfsVolume->block[i].type = SIMFS_DIRECTORY_CONTENT_TYPE;
+            memset(simfsVolume->block[i].content.bucket, 0, sizeof(simfsVolume->block[i].content.bucket));
+            simfsVolume->block[folder].content.fileDescriptor.block_ref = i;
+            simfsVolume->block[folder].content.fileDescriptor.size = 0;
+            freeNameFilter(folder);
+            simfsContext->folderGeneration[folder]++;
+            return true;
+        }
+    }
+    return false;
+}
 
 /***
- * The function replaces content of a file with new one pointed to by the parameter writeBuffer.
- *
- * Checks if the file handle points to a valid file descriptor of an open file. Any issues should be reported by
- * returning SIMFS_SYSTEM_ERROR. In this case, further code debugging is needed.
- *
- * Otherwise, it checks the access rights for writing. If the process owner is not allowed to write to the file,
- * then the function returns SIMFS_ACCESS_ERROR.
- *
- * Then, the function calculates the space needed for the new content and checks if the write buffer can fit into
- * the remaining free space in the file system. If not, then the SIMFS_ALLOC_ERROR is returned.
- *
- * Otherwise, the function:
- *    - acquires as many new blocks as needed to hold the new content modifying corresponding bits in
- *      the in-memory bitvector,
- *    - copies the characters pointed to by the parameter writeBuffer (until '\0' but excluding it) to the
- *      new just acquired blocks,
- *    - copies any modified block of the in-memory bitvector to the corresponding bitvector block on the disk.
- *
- * If the new content has been written successfully, the function then removes all blocks currently held by
- * this file and modifies the file descriptor to reflect the new location, the new size of the file, and the new
- * times of last modification and access.
+ * Third pass over a range, when repairing: clears the blocks that are not live and marks in the bitvector exactly the
+ * ones that are. Ranges are multiples of 8 blocks, so no byte of the bitvector is shared between threads.
  *
- * This order of actions prevents file corruption, since in case of any error with writing new content, the file's
- * old version is intact. This technique is called copy-on-write and is an alternative to journalling.
+ * A directory leaf that the pruning of its folder emptied has been freed already, and stays free.
+ */
+static void *repairCheckRange(void *argument)
+{
+    struct checkRange *range = argument;
+    currentInstance = range->instance;
+
+    for (int i = range->start; i < range->end; i++) {
+        if (range->scan->live[i] && simfsVolume->block[i].type != SIMFS_INVALID_CONTENT_TYPE)
+            simfsSetBit(simfsContext->bitvector, i);
+        else {
+            simfsClearBit(simfsContext->bitvector, i);
+            simfsVolume->block[i].type = SIMFS_INVALID_CONTENT_TYPE;
+            freeNameFilter(i);
+        }
+    }
+    return NULL;
+}
+
+/***
+ * Runs a pass over all ranges, the first on the calling thread and the others on threads of their own; a range
+ * whose thread cannot be started is done by the calling thread as well.
+ */
+static void runCheckPass(struct checkRange *ranges, int count, void *(*pass)(void *))
+{
+    pthread_t threads[SIMFS_CHECK_MAX_THREADS];
+    bool started[SIMFS_CHECK_MAX_THREADS] = {false};
+    for (int r = count - 1; r >= 0; r--) {
+        if (r == 0 || pthread_create(&threads[r], NULL, pass, &ranges[r]) != 0)
+            pass(&ranges[r]);
+        else
+            started[r] = true;
+    }
+    for (int r = 1; r < count; r++)
+        if (started[r])
+            pthread_join(threads[r], NULL);
+}
+
+/***
+ * Checks the consistency of the mounted volume with a full scan of its blocks, as is needed after a crash, split
+ * into one contiguous range of blocks per thread.
  *
- * The function returns SIMFS_WRITE_ERROR in response to exception not specified earlier.
+ * The first pass classifies the blocks of each range and counts the references that its folders and files make to
+ * other blocks; the second decides which blocks of each range are live by following the references back to the
+ * root folder. The findings of the ranges are then added up into the parameter check.
  *
+ * With repair set, the live folders first drop the records of the folders and files that are not live, and the live
+ * files are cut at their first reference to a block that is not; a folder whose directory is lost gets an empty
+ * one. A third pass then clears the blocks that are not live and rebuilds the bitvector from the live ones, and the
+ * in-memory directory is rebuilt from the live folders and files that the ranges collected. Repairing is
+ * refused with SIMFS_ACCESS_ERROR while files are open. If the root folder itself is damaged, nothing is checked
+ * and SIMFS_READ_ERROR is returned.
  */
-SIMFS_ERROR simfsWriteFile(SIMFS_FILE_HANDLE_TYPE fileHandle, char *writeBuffer)
+SIMFS_ERROR simfsCheckFileSystem(SIMFS_CHECK_TYPE *check)
 {
-    // TODO: implement
-    SIMFS_INDEX_TYPE fileDescriptor = simfsContext->globalOpenFileTable[fileHandle].fileDescriptor;
-    if(fileDescriptor == SIMFS_INVALID_INDEX)
-        return SIMFS_NOT_FOUND_ERROR;
-    SIMFS_BLOCK_TYPE file = simfsVolume->block[fileDescriptor];
-    if(file.type == SIMFS_INVALID_CONTENT_TYPE)
-        return SIMFS_NOT_FOUND_ERROR;
-    if(file.content.fileDescriptor.block_ref == SIMFS_INVALID_INDEX){
-        file.content.fileDescriptor.block_ref = simfsFindFreeBlock(simfsVolume->bitvector);
-        simfsFlipBit(simfsVolume->bitvector, file.content.fileDescriptor.block_ref);
-        simfsFlipBit(simfsContext->bitvector, file.content.fileDescriptor.block_ref);
+    if (check == NULL || simfsContext == NULL || simfsVolume == NULL)
+        return SIMFS_SYSTEM_ERROR;
+    if (!holdsType(simfsVolume->superblock.attr.rootNodeIndex, SIMFS_FOLDER_CONTENT_TYPE))
+        return SIMFS_READ_ERROR;
+    if (check->repair)
+        for (int i = 0; i < SIMFS_MAX_NUMBER_OF_OPEN_FILES; i++)
+            if (simfsContext->globalOpenFileTable[i].type != SIMFS_INVALID_CONTENT_TYPE)
+                return SIMFS_ACCESS_ERROR;
+
+    int numberOfThreads = (check->numberOfThreads > 0 ? check->numberOfThreads : (int) sysconf(_SC_NPROCESSORS_ONLN));
+    if (numberOfThreads < 1)
+        numberOfThreads = 1;
+    if (numberOfThreads > SIMFS_CHECK_MAX_THREADS)
+        numberOfThreads = SIMFS_CHECK_MAX_THREADS;
+    int rangeSize = (SIMFS_NUMBER_OF_BLOCKS / 8 + numberOfThreads - 1) / numberOfThreads * 8;
+    int count = (SIMFS_NUMBER_OF_BLOCKS + rangeSize - 1) / rangeSize;
+
+    struct checkScan *scan = calloc(1, sizeof(struct checkScan));
+    struct checkRange *ranges = calloc(count, sizeof(struct checkRange));
+    SIMFS_INDEX_TYPE *nodes = (check->repair ? malloc(SIMFS_NUMBER_OF_BLOCKS * sizeof(SIMFS_INDEX_TYPE)) : NULL);
+    if (scan == NULL || ranges == NULL || (check->repair && nodes == NULL)) {
+        free(scan);
+        free(ranges);
+        free(nodes);
+        return SIMFS_ALLOC_ERROR;
     }
-    memcpy(simfsVolume->block[file.content.fileDescriptor.block_ref].content.data,writeBuffer,14);
 
-    return SIMFS_NO_ERROR;
+    scan->root = simfsVolume->superblock.attr.rootNodeIndex;
+    for (int r = 0; r < count; r++) {
+        ranges[r].instance = currentInstance;
+        ranges[r].scan = scan;
+        ranges[r].start = r * rangeSize;
+        ranges[r].end = (r == count - 1 ? SIMFS_NUMBER_OF_BLOCKS : (r + 1) * rangeSize);
+        ranges[r].nodes = (nodes != NULL ? nodes + ranges[r].start : NULL);
+    }
+
+    runCheckPass(ranges, count, scanCheckRange);
+    runCheckPass(ranges, count, settleCheckRange);
+
+    int numberOfThreadsAsked = check->numberOfThreads, repair = check->repair;
+    memset(check, 0, sizeof(SIMFS_CHECK_TYPE));
+    check->numberOfThreads = numberOfThreadsAsked;
+    check->repair = repair;
+    for (int r = 0; r < count; r++) {
+        SIMFS_CHECK_TYPE *found = &ranges[r].found;
+        for (int i = 0; i <= SIMFS_INVALID_CONTENT_TYPE; i++)
+            check->blocksByType[i] += found->blocksByType[i];
+        check->liveBlocks += found->liveBlocks;
+        check->folders += found->folders;
+        check->files += found->files;
+        check->orphanedDescriptors += found->orphanedDescriptors;
+        check->orphanedBlocks += found->orphanedBlocks;
+        check->unmarkedBlocks += found->unmarkedBlocks;
+        check->doublyReferencedBlocks += found->doublyReferencedBlocks;
+        check->sharedBlocks += found->sharedBlocks;
+        check->brokenReferences += found->brokenReferences;
+    }
+
+    SIMFS_ERROR error = SIMFS_NO_ERROR;
+    if (repair) {
+        // on the calling thread, since removing a record may free a leaf in the range of another thread; the folders
+        // whose directory is lost get new ones once nothing else is pruned, so no reference is kept to the new block
+        bool *lost = calloc(SIMFS_NUMBER_OF_BLOCKS, sizeof(bool));
+        if (lost == NULL) {
+            free(nodes);
+            free(ranges);
+            free(scan);
+            return SIMFS_ALLOC_ERROR;
+        }
+        for (int i = 0; i < SIMFS_NUMBER_OF_BLOCKS; i++) {
+            if (!scan->live[i])
+                continue;
+            if (simfsVolume->block[i].type == SIMFS_FOLDER_CONTENT_TYPE)
+                lost[i] = !pruneCheckedFolder(scan, i);
+            else if (simfsVolume->block[i].type == SIMFS_FILE_CONTENT_TYPE)
+                truncateCheckedFile(scan, i);
+        }
+        bool full = false; // a folder is left without a directory, reported once the rest is repaired
+        for (int i = 0; i < SIMFS_NUMBER_OF_BLOCKS; i++)
+            if (lost[i] && !replaceCheckedDirectory(scan, i))
+                full = true;
+        free(lost);
+
+        runCheckPass(ranges, count, repairCheckRange);
+        syncBitvector();
+        countDataReferences();
+        if (simfsContext->fingerprints != NULL)
+            indexDataBlocks();
+        memset(simfsContext->dentryCache, 0, sizeof(simfsContext->dentryCache));
+
+        // the partial directory tables of the ranges are merged into a new in-memory directory
+        memset(simfsContext->directory, 0, sizeof(simfsContext->directory));
+        destroySlab(&simfsContext->directoryEntries);
+        initSlab(&simfsContext->directoryEntries, sizeof(SIMFS_DIR_ENT));
+        for (int r = 0; r < count && error == SIMFS_NO_ERROR; r++) {
+            for (int i = 0; i < ranges[r].numberOfNodes; i++) {
+                SIMFS_FILE_DESCRIPTOR_TYPE *descriptor = &simfsVolume->block[ranges[r].nodes[i]].content.fileDescriptor;
+                SIMFS_DIR_ENT *entry = slabAllocate(&simfsContext->directoryEntries);
+                if (entry == NULL) {
+                    error = SIMFS_ALLOC_ERROR;
+                    break;
+                }
+                SIMFS_DIR_ENT **head = &simfsContext->directory[hash((unsigned char *) descriptor->name)];
+                entry->nodeReference = ranges[r].nodes[i];
+                entry->uniqueFileIdentifier = descriptor->identifier;
+                entry->globalOpenFileTableIndex = SIMFS_INVALID_OPEN_FILE_TABLE_INDEX;
+                entry->next = *head;
+                *head = entry;
+            }
+        }
+        if (error == SIMFS_NO_ERROR && full)
+            error = SIMFS_ALLOC_ERROR;
+    }
+
+    free(nodes);
+    free(ranges);
+    free(scan);
+    return error;
 }
 
 //////////////////////////////////////////////////////////////////////////
 
 /***
- * The function returns the complete content of the file to the caller through the parameter readBuffer.
- *
- * Checks if the file handle (i.e., an index to an entry in the per-process open files table) points to
- * a valid file descriptor of an open file. Any issues should be reported by returning SIMFS_SYSTEM_ERROR.
- * In this case, further code debugging is needed.
- *
- * Otherwise, it checks the user's access right to read the file. If the process owner is not allowed to read the file,
- * then the function returns SIMFS_ACCESS_ERROR.
- *
- * Otherwise, the function allocates memory sufficient to hold the read content with an appended end of string
- * character; the pointer to newly allocated memory is passed back through the readBuffer parameter. All the content
- * of the blocks is concatenated using the allocated space, and an end of string character is appended at the end of
- * the concatenated content.
- *
- * The function returns SIMFS_READ_ERROR in response to exception not specified earlier.
+ * Turns the deduplication of data blocks on or off for the mounted volume; it is off after mounting.
  *
+ * While it is on, a data block being written whose content the volume holds already refers to the existing block
+ * instead of taking a new one, and the fingerprints of the data blocks in use are kept in an in-memory index. Blocks
+ * shared before stay shared when it is turned off.
  */
-SIMFS_ERROR simfsReadFile(SIMFS_FILE_HANDLE_TYPE fileHandle, char **readBuffer)
+SIMFS_ERROR simfsSetDeduplication(int enabled)
 {
-    // TODO: implement
-    SIMFS_INDEX_TYPE fileDescriptor = simfsContext->globalOpenFileTable[fileHandle].fileDescriptor;
-    if(fileDescriptor == SIMFS_INVALID_INDEX)
-        return SIMFS_NOT_FOUND_ERROR;
-    SIMFS_BLOCK_TYPE file = simfsVolume->block[fileDescriptor];
-    if(file.type == SIMFS_INVALID_CONTENT_TYPE)
-        return SIMFS_NOT_FOUND_ERROR;
-    *readBuffer = simfsVolume->block[file.content.fileDescriptor.block_ref].content.data;
+    if (simfsContext == NULL || simfsVolume == NULL)
+        return SIMFS_SYSTEM_ERROR;
+
+    if (!enabled) {
+        free(simfsContext->fingerprints);
+        simfsContext->fingerprints = NULL;
+        return SIMFS_NO_ERROR;
+    }
+
+    if (simfsContext->fingerprints == NULL) {
+        simfsContext->fingerprints = malloc(sizeof(SIMFS_FINGERPRINT_INDEX_TYPE));
+        if (simfsContext->fingerprints == NULL)
+            return SIMFS_ALLOC_ERROR;
+        indexDataBlocks();
+    }
     return SIMFS_NO_ERROR;
 }
 
 //////////////////////////////////////////////////////////////////////////
 
 /***
- * Removes the entry for the file with the file handle provided as the parameter from the open file table
- * for this process. It decreases the number of open files for the file in the process control block of
- * this process, and if it becomes zero, then the process control block for this process is removed from
- * the processControlBlocks list.
- *
- * Decreases the reference count in the global open file table, and if that number is 0, it also removes the entry
- * for this file from the global open file table. In this case, it also removes the index to the global open file
- * table from the directory entry for the file by overwriting it with SIMFS_INVALID_OPEN_FILE_TABLE_INDEX.
+ * Returns the statistics gathered since the program started: the counters of the simfs functions, merged
+ * across threads, and the state of the mounted volume's in-memory structures.
  *
+ * The sampled fields are left at 0 if no volume is mounted.
  */
-
-SIMFS_ERROR simfsCloseFile(SIMFS_FILE_HANDLE_TYPE fileHandle)
+SIMFS_ERROR simfsGetStats(SIMFS_STATS_TYPE *stats)
 {
-    // TODO: implement
-    SIMFS_OPEN_FILE_GLOBAL_TABLE_TYPE* file = &(simfsContext->globalOpenFileTable[fileHandle]);
+    if (stats == NULL)
+        return SIMFS_SYSTEM_ERROR;
+
+    simfsStatsMerge(stats, currentInstance->stats);
+
+    stats->freeBlocks = 0;
+    stats->directoryEntries = 0;
+    stats->usedDirectorySlots = 0;
+    stats->longestHashChain = 0;
+    stats->openFiles = 0;
+    stats->sharedBlocks = 0;
+    if (simfsContext == NULL || simfsVolume == NULL)
+        return SIMFS_NO_ERROR;
 
-    file->referenceCount--;
-    if (file->referenceCount == 0){
-        file->type = SIMFS_INVALID_OPEN_FILE_TABLE_INDEX;
-        simfsContext->directory[file->fileDescriptor]->globalOpenFileTableIndex = SIMFS_INVALID_OPEN_FILE_TABLE_INDEX;
-        file->fileDescriptor = SIMFS_INVALID_INDEX;
+    for (int i = 0; i < SIMFS_NUMBER_OF_BLOCKS / 8; i++)
+        stats->freeBlocks += 8 - __builtin_popcount(simfsContext->bitvector[i]);
+    for (int i = 0; i < SIMFS_NUMBER_OF_BLOCKS; i++)
+        if (simfsContext->dataReferences[i] > 1)
+            stats->sharedBlocks++;
+
+    for (int i = 0; i < SIMFS_DIRECTORY_SIZE; i++) {
+        int length = 0;
+        for (SIMFS_DIR_ENT *entry = simfsContext->directory[i]; entry != NULL; entry = entry->next)
+            length++;
+
+        stats->directoryEntries += length;
+        if (length > 0)
+            stats->usedDirectorySlots++;
+        if (length > stats->longestHashChain)
+            stats->longestHashChain = length;
     }
 
+    for (int i = 0; i < SIMFS_MAX_NUMBER_OF_OPEN_FILES; i++)
+        if (simfsContext->globalOpenFileTable[i].type != SIMFS_INVALID_CONTENT_TYPE)
+            stats->openFiles++;
+
     return SIMFS_NO_ERROR;
 }
 
@@ -714,6 +3669,9 @@ SIMFS_ERROR simfsCloseFile(SIMFS_FILE_HANDLE_TYPE fileHandle)
 
 /***
  * Simulates FUSE context to get values for user ID, process ID, and umask through fuse_context
+ *
+ * Like fuse_get_context(), it returns a context of the calling thread that is overwritten by the next call and must
+ * not be freed.
  */
 
 struct fuse_context *simfs_debug_get_context()
@@ -721,7 +3679,8 @@ struct fuse_context *simfs_debug_get_context()
 
     // TODO: replace its use with FUSE's fuse_get_context()
 
-    struct fuse_context *context = malloc(sizeof(struct fuse_context));
+    static _Thread_local struct fuse_context threadContext;
+    struct fuse_context *context = &threadContext;
 
     context->fuse = NULL;
     context->uid = (uid_t) rand() % 10 + 1;
@@ -752,3 +3711,193 @@ char *simfsGenerateContent(int size)
     content[size - 1] = '\0';
     return content;
 }
+
+//////////////////////////////////////////////////////////////////////////
+//
+// instances
+//
+// The functions taking an instance make it the current instance of the calling thread, call the function of the same
+// name without the instance parameter, and switch back.
+//
+//////////////////////////////////////////////////////////////////////////
+
+SIMFS_INSTANCE_TYPE *simfsCreateInstance()
+{
+    SIMFS_INSTANCE_TYPE *instance = calloc(1, sizeof(SIMFS_INSTANCE_TYPE));
+    if (instance == NULL)
+        return NULL;
+
+    instance->stats = simfsStatsCreateCounters();
+    if (instance->stats == NULL) {
+        free(instance);
+        return NULL;
+    }
+    return instance;
+}
+
+/***
+ * Frees an instance; a volume that is still mounted is dropped without being saved.
+ */
+void simfsDestroyInstance(SIMFS_INSTANCE_TYPE *instance)
+{
+    if (instance->context != NULL)
+        destroyContext(instance->context);
+    free(instance->volume);
+    simfsStatsDestroyCounters(instance->stats);
+    free(instance);
+}
+
+static SIMFS_INSTANCE_TYPE *enterInstance(SIMFS_INSTANCE_TYPE *instance)
+{
+    SIMFS_INSTANCE_TYPE *previous = currentInstance;
+    currentInstance = instance;
+    simfsStatsSelect(instance->stats);
+    return previous;
+}
+
+static SIMFS_ERROR leaveInstance(SIMFS_INSTANCE_TYPE *previous, SIMFS_ERROR result)
+{
+    currentInstance = previous;
+    simfsStatsSelect(previous->stats);
+    return result;
+}
+
+#define SIMFS_ON_INSTANCE(instance, call) do { \
+        SIMFS_INSTANCE_TYPE *previous = enterInstance(instance); \
+        return leaveInstance(previous, call); \
+    } while (0)
+
+SIMFS_ERROR simfsInstanceCreateFileSystem(SIMFS_INSTANCE_TYPE *instance, char *simfsFileSystemName)
+{
+    SIMFS_ON_INSTANCE(instance, simfsCreateFileSystem(simfsFileSystemName));
+}
+
+SIMFS_ERROR simfsInstanceUmountFileSystem(SIMFS_INSTANCE_TYPE *instance, char *simfsFileSystemName)
+{
+    SIMFS_ON_INSTANCE(instance, simfsUmountFileSystem(simfsFileSystemName));
+}
+
+SIMFS_ERROR simfsInstanceMountFileSystem(SIMFS_INSTANCE_TYPE *instance, char *simfsFileSystemName)
+{
+    SIMFS_ON_INSTANCE(instance, simfsMountFileSystem(simfsFileSystemName));
+}
+
+SIMFS_ERROR simfsInstanceCreateFile(SIMFS_INSTANCE_TYPE *instance, SIMFS_NAME_TYPE fileName, SIMFS_CONTENT_TYPE type)
+{
+    SIMFS_ON_INSTANCE(instance, simfsCreateFile(fileName, type));
+}
+
+SIMFS_ERROR simfsInstanceDeleteFile(SIMFS_INSTANCE_TYPE *instance, SIMFS_NAME_TYPE fileName)
+{
+    SIMFS_ON_INSTANCE(instance, simfsDeleteFile(fileName));
+}
+
+SIMFS_ERROR simfsInstanceGetFileInfo(SIMFS_INSTANCE_TYPE *instance, SIMFS_NAME_TYPE fileName,
+                                     SIMFS_FILE_DESCRIPTOR_TYPE *infoBuffer)
+{
+    SIMFS_ON_INSTANCE(instance, simfsGetFileInfo(fileName, infoBuffer));
+}
+
+SIMFS_ERROR simfsInstanceOpenFile(SIMFS_INSTANCE_TYPE *instance, SIMFS_NAME_TYPE fileName,
+                                  SIMFS_FILE_HANDLE_TYPE *fileHandle)
+{
+    SIMFS_ON_INSTANCE(instance, simfsOpenFile(fileName, fileHandle));
+}
+
+SIMFS_ERROR simfsInstanceWriteFile(SIMFS_INSTANCE_TYPE *instance, SIMFS_FILE_HANDLE_TYPE fileHandle, char *writeBuffer)
+{
+    SIMFS_ON_INSTANCE(instance, simfsWriteFile(fileHandle, writeBuffer));
+}
+
+SIMFS_ERROR simfsInstanceReadFile(SIMFS_INSTANCE_TYPE *instance, SIMFS_FILE_HANDLE_TYPE fileHandle, char **readBuffer)
+{
+    SIMFS_ON_INSTANCE(instance, simfsReadFile(fileHandle, readBuffer));
+}
+
+SIMFS_ERROR simfsInstanceCloseFile(SIMFS_INSTANCE_TYPE *instance, SIMFS_FILE_HANDLE_TYPE fileHandle)
+{
+    SIMFS_ON_INSTANCE(instance, simfsCloseFile(fileHandle));
+}
+
+SIMFS_ERROR simfsInstanceReadFileVector(SIMFS_INSTANCE_TYPE *instance, SIMFS_FILE_HANDLE_TYPE fileHandle, size_t offset,
+                                        size_t size, struct iovec *vector, int *vectorCount)
+{
+    SIMFS_ON_INSTANCE(instance, simfsReadFileVector(fileHandle, offset, size, vector, vectorCount));
+}
+
+SIMFS_ERROR simfsInstanceReleaseFileVector(SIMFS_INSTANCE_TYPE *instance, SIMFS_FILE_HANDLE_TYPE fileHandle)
+{
+    SIMFS_ON_INSTANCE(instance, simfsReleaseFileVector(fileHandle));
+}
+
+SIMFS_ERROR simfsInstanceSetFileCompression(SIMFS_INSTANCE_TYPE *instance, SIMFS_FILE_HANDLE_TYPE fileHandle,
+                                            int compressed)
+{
+    SIMFS_ON_INSTANCE(instance, simfsSetFileCompression(fileHandle, compressed));
+}
+
+SIMFS_ERROR simfsInstanceSubmitBatch(SIMFS_INSTANCE_TYPE *instance, SIMFS_BATCH_OPERATION_TYPE *operations, int count)
+{
+    SIMFS_ON_INSTANCE(instance, simfsSubmitBatch(operations, count));
+}
+
+SIMFS_ERROR simfsInstanceCompact(SIMFS_INSTANCE_TYPE *instance, SIMFS_COMPACTION_TYPE *compaction, int blockBudget)
+{
+    SIMFS_ON_INSTANCE(instance, simfsCompact(compaction, blockBudget));
+}
+
+SIMFS_ERROR simfsInstanceCheckFileSystem(SIMFS_INSTANCE_TYPE *instance, SIMFS_CHECK_TYPE *check)
+{
+    SIMFS_ON_INSTANCE(instance, simfsCheckFileSystem(check));
+}
+
+SIMFS_ERROR simfsInstanceSetDeduplication(SIMFS_INSTANCE_TYPE *instance, int enabled)
+{
+    SIMFS_ON_INSTANCE(instance, simfsSetDeduplication(enabled));
+}
+
+SIMFS_ERROR simfsInstanceGetStats(SIMFS_INSTANCE_TYPE *instance, SIMFS_STATS_TYPE *stats)
+{
+    SIMFS_ON_INSTANCE(instance, simfsGetStats(stats));
+}
+
+SIMFS_ERROR simfsInstanceResolvePath(SIMFS_INSTANCE_TYPE *instance, char *path, SIMFS_INDEX_TYPE *node)
+{
+    SIMFS_ON_INSTANCE(instance, simfsResolvePath(path, node));
+}
+
+SIMFS_ERROR simfsInstanceChangeDirectory(SIMFS_INSTANCE_TYPE *instance, char *path)
+{
+    SIMFS_ON_INSTANCE(instance, simfsChangeDirectory(path));
+}
+
+SIMFS_ERROR simfsInstanceLookupFile(SIMFS_INSTANCE_TYPE *instance, SIMFS_INDEX_TYPE folder, SIMFS_NAME_TYPE fileName,
+                                    SIMFS_INDEX_TYPE *node)
+{
+    SIMFS_ON_INSTANCE(instance, simfsLookupFile(folder, fileName, node));
+}
+
+SIMFS_ERROR simfsInstanceGetFileInfoByReference(SIMFS_INSTANCE_TYPE *instance, SIMFS_INDEX_TYPE node,
+                                                SIMFS_FILE_DESCRIPTOR_TYPE *infoBuffer)
+{
+    SIMFS_ON_INSTANCE(instance, simfsGetFileInfoByReference(node, infoBuffer));
+}
+
+SIMFS_ERROR simfsInstanceGetFolderEntry(SIMFS_INSTANCE_TYPE *instance, SIMFS_INDEX_TYPE folder, int position,
+                                        SIMFS_INDEX_TYPE *node)
+{
+    SIMFS_ON_INSTANCE(instance, simfsGetFolderEntry(folder, position, node));
+}
+
+SIMFS_ERROR simfsInstanceReadDir(SIMFS_INSTANCE_TYPE *instance, SIMFS_INDEX_TYPE folder,
+                                 SIMFS_FOLDER_CURSOR_TYPE *cursor, SIMFS_FOLDER_ENTRY_TYPE *buffer, int max,
+                                 int *count)
+{
+    SIMFS_ON_INSTANCE(instance, simfsReadDir(folder, cursor, buffer, max, count));
+}
+
+SIMFS_ERROR simfsInstanceOpenFileByReference(SIMFS_INSTANCE_TYPE *instance, SIMFS_INDEX_TYPE node,
+                                             SIMFS_FILE_HANDLE_TYPE *fileHandle)
+{
+    SIMFS_ON_INSTANCE(instance, simfsOpenFileByReference(node, fileHandle));
+}
@@ -2,10 +2,13 @@
 #define __SIMFS_H_
 
 #include <time.h>
+#include <stdint.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <fuse.h>
 #include <stdio.h>
+#include <sys/uio.h>
 
 //////////////////////////////////////////////////////////////////////////
 //
@@ -20,6 +23,26 @@
 #define SIMFS_INDEX_SIZE 7 // 127 // two bytes => x0000 - xFFFF => 2^16 range
 #define SIMFS_ROOT_NODE_INDEX 0
 
+//////////////////////////////////////////////////////////////////////////
+//
+// allocation groups
+//
+// The blocks are split into groups, each with its own section of the bitvector: folder and file descriptors,
+// directory blocks and index blocks are taken from the metadata group at the start of the volume, and data blocks
+// from the data group behind it, so listing a folder or getting the attributes of its files stays within a small
+// part of the volume.
+// A group that is full borrows blocks from the other one.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#define SIMFS_METADATA_GROUP_SIZE (SIMFS_NUMBER_OF_BLOCKS / 4) // a multiple of 8, so groups start on a bitvector byte
+
+typedef enum {
+    SIMFS_METADATA_GROUP,
+    SIMFS_DATA_GROUP,
+    SIMFS_NUMBER_OF_GROUPS
+} SIMFS_ALLOCATION_GROUP_TYPE;
+
 //////////////////////////////////////////////////////////////////////////
 //
 // each file/folder gets a unique identifier, and this is the initial value
@@ -51,11 +74,12 @@ typedef enum {
     SIMFS_FILE_CONTENT_TYPE,
     SIMFS_INDEX_CONTENT_TYPE,
     SIMFS_DATA_CONTENT_TYPE,
+    SIMFS_DIRECTORY_CONTENT_TYPE,
     SIMFS_INVALID_CONTENT_TYPE
 } SIMFS_CONTENT_TYPE;
 
 typedef unsigned short SIMFS_INDEX_TYPE; // is used to index blocks in the file system
-#define SIMFS_INVALID_INDEX 0xFF
+#define SIMFS_INVALID_INDEX 0xFFFF
 
 //
 // superblock starting block in the whole file system
@@ -67,14 +91,23 @@ typedef unsigned short SIMFS_INDEX_TYPE; // is used to index blocks in the file
 // rootNodeIndex points to the block which is the root folder of the files system
 // numberOfBlock determines the size of the file system
 // blockSize is the size of a single block of the file system
+// stripeCount and stripeBlocks describe how the blocks are spread over the image files (see below); both are 0 in
+//        volumes written before striping, which are laid out like a volume of one file
+// stripeIndex is the position of the image file holding the superblock, which differs between the files
+//
+// All fields of the volume have fixed widths and explicit padding, so an image written on one little-endian host
+// can be mounted on another regardless of the sizes of long, time_t and the like.
 //todo superblock type
 typedef union simfs_superblock_type { // size of the block with some unused part
     char spacer_dummy[SIMFS_BLOCK_SIZE]; // this makes the struct exactly one block
     struct attr {
-        unsigned long long nextUniqueIdentifier; // unique identifier generator for files and folders
+        uint64_t nextUniqueIdentifier; // unique identifier generator for files and folders
         SIMFS_INDEX_TYPE rootNodeIndex; // should point to the first block after the last bitvector block
-        int numberOfBlocks;
-        int blockSize;
+        uint16_t stripeCount; // image files
+        int32_t numberOfBlocks;
+        int32_t blockSize;
+        uint16_t stripeBlocks; // consecutive blocks in one image file
+        uint16_t stripeIndex; // position of the image file in the stripe set
     } attr;
 } SIMFS_SUPERBLOCK_TYPE;
 
@@ -88,41 +121,94 @@ typedef union simfs_superblock_type { // size of the block with some unused part
 //
 //   for directories:
 //       the size indicates the number of files or directories in this folder
-//       the block reference points to an index block that holds references to the file and folder blocks
+//       the block reference points to the root block of the folder's directory (see below)
+//
+// The descriptor is packed, and follows the two-byte type of its block. The fields that getting the attributes
+// of a file, opening it and walking its content need come first and end with the first 32 bytes of the block, half
+// a cache line; the identifier, the other times and the name, which only lookups by name and listings need, are
+// stored in the tail. The offsets are chosen so that every field is naturally aligned within the block.
 //
 typedef char SIMFS_NAME_TYPE[SIMFS_MAX_NAME_LENGTH]; // for folder and file names
 
-typedef struct simfs_file_descriptor_type {
-    unsigned long long identifier; // unique folder/file identifier
-    SIMFS_CONTENT_TYPE type; // folder or file
-    SIMFS_NAME_TYPE name;
-    time_t creationTime; // creation time
-    time_t lastAccessTime; // last access
-    time_t lastModificationTime; // last modification
-    mode_t accessRights; // access rights for the file
-    uid_t owner; // owner ID
-    size_t size; // capacity limited for this project to 2s^16
+#define SIMFS_DESCRIPTOR_HOT_SIZE 32 // bytes of a block up to the end of the hot fields of its descriptor
+
+typedef struct __attribute__((packed, aligned(2))) simfs_file_descriptor_type {
+    // hot fields
     SIMFS_INDEX_TYPE block_ref; // reference to the data or index block
+    uint32_t accessRights; // access rights for the file
+    uint64_t size; // capacity limited for this project to 2s^16
+    int64_t lastModificationTime; // last modification
+    uint32_t owner; // owner ID
+    uint8_t type; // folder or file; the same as the type of the block, repeated for simfsGetFileInfo
+    uint8_t flags; // SIMFS_FILE_COMPRESSED
+    uint8_t reserved[2];
+    // cold fields
+    uint64_t identifier; // unique folder/file identifier
+    int64_t creationTime; // creation time
+    int64_t lastAccessTime; // last access
+    SIMFS_NAME_TYPE name;
 } SIMFS_FILE_DESCRIPTOR_TYPE;
 
+//
+// directory of a folder
+//
+// The root block of a directory holds one reference per bucket to the first leaf block of the bucket, or 0 if the
+// bucket is empty; each leaf links to the next leaf of its bucket. A leaf holds packed records of the children whose
+// names hash to the bucket: the child's file descriptor block, the upper half of the hash of the name, and the name
+// without its terminating zero. Looking up a name reads the root and the leaves of one bucket, and listing a folder
+// reads its leaves, without loading the file descriptors of the children.
+//
+#define SIMFS_DIRECTORY_BUCKETS (sizeof(SIMFS_FILE_DESCRIPTOR_TYPE) / sizeof(SIMFS_INDEX_TYPE))
+#define SIMFS_DIRECTORY_LEAF_SIZE (sizeof(SIMFS_FILE_DESCRIPTOR_TYPE) - 2 * sizeof(uint16_t))
+
+typedef struct __attribute__((packed)) simfs_directory_record_type {
+    SIMFS_INDEX_TYPE node; // the file descriptor block of the child
+    uint16_t hash;
+    uint8_t nameLength;
+    char name[]; // not terminated
+} SIMFS_DIRECTORY_RECORD_TYPE;
+
+typedef struct simfs_directory_leaf_type {
+    SIMFS_INDEX_TYPE next; // the next leaf of the bucket, or 0
+    uint16_t used; // bytes taken by records
+    unsigned char records[SIMFS_DIRECTORY_LEAF_SIZE];
+} SIMFS_DIRECTORY_LEAF_TYPE;
+
 //
 // a block for holding data
 //
+// The content of a file with the flag SIMFS_FILE_COMPRESSED is stored in chunks of SIMFS_COMPRESSION_CHUNK_SIZE
+// bytes of content, the last one shorter. Each chunk starts with a new data block and a two-byte header: the length
+// of the LZ4 block that follows, or SIMFS_COMPRESSION_RAW and the length of the content itself for a chunk that did
+// not compress by at least a data block. The size in the file descriptor is that of the uncompressed content.
+//
 typedef char SIMFS_DATA_TYPE[SIMFS_DATA_SIZE];
 
+#define SIMFS_FILE_COMPRESSED 0x01
+#define SIMFS_COMPRESSION_CHUNK_SIZE 4096
+#define SIMFS_COMPRESSION_HEADER_SIZE 2
+#define SIMFS_COMPRESSION_RAW 0x8000
+
 //
 // various interpretations of a file system block
 //todo simfs_block_type
 typedef struct simfs_node_type {
-    SIMFS_CONTENT_TYPE type;
+    uint16_t type; // a SIMFS_CONTENT_TYPE
     union { // content depends on the type
         SIMFS_FILE_DESCRIPTOR_TYPE fileDescriptor; // for directories and files
         SIMFS_DATA_TYPE data; // for data
         SIMFS_INDEX_TYPE index[SIMFS_INDEX_SIZE];  // for indices; all indices but the last point to data blocks
         // the last points to another index block
+        SIMFS_INDEX_TYPE bucket[SIMFS_DIRECTORY_BUCKETS]; // for the root block of a directory
+        SIMFS_DIRECTORY_LEAF_TYPE leaf; // for the other blocks of a directory
     } content;
 } SIMFS_BLOCK_TYPE;
 
+_Static_assert(sizeof(SIMFS_SUPERBLOCK_TYPE) == 24, "the superblock layout must not depend on the host");
+_Static_assert(offsetof(SIMFS_BLOCK_TYPE, content.fileDescriptor.reserved) + 2 == SIMFS_DESCRIPTOR_HOT_SIZE,
+               "the hot fields of a descriptor must end with the first SIMFS_DESCRIPTOR_HOT_SIZE bytes of its block");
+_Static_assert(sizeof(SIMFS_BLOCK_TYPE) % 8 == 0, "blocks must keep the fields of the following ones aligned");
+
 //
 // "physical" file system structure
 //
@@ -132,6 +218,22 @@ typedef struct simfs_node_type {
 //
 // blocks (folder, file, data, or index) - SIMFS_NUMBER_OF_BLOCKS
 //
+// A volume can be striped across several image files, each on its own device, by naming them all, separated by
+// colons, wherever the name of a volume is expected: "/nvme0/simfs.dta:/nvme1/simfs.dta". Every image file starts
+// with the superblock and the bitvector, followed by its share of the blocks in units of stripeBlocks consecutive
+// blocks: unit u of the volume is unit u / stripeCount of file u % stripeCount. A volume of one file thus holds all
+// blocks in order. The files are read and written in parallel, each through its own I/O engine.
+//
+// Every image file ends with a checksum table of 32-bit CRC-32C values: one of the superblock and the bitvector of
+// the file, followed by one per block of the file, in the order in which the blocks are stored in it. The table is
+// written when the volume is unmounted, and the blocks are checked against it when the volume is mounted, which
+// fails with SIMFS_READ_ERROR if a block was changed by a torn write or a flipped bit. An image file without the
+// table, written before checksums were kept, is mounted unchecked.
+//
+#define SIMFS_MAX_STRIPES 16
+#define SIMFS_STRIPE_BLOCKS 512 // blocks per stripe unit of a new volume
+#define SIMFS_STRIPE_SEPARATOR ':'
+
 //todo simfs_volume
 typedef struct simfs_volume {
     SIMFS_SUPERBLOCK_TYPE superblock;
@@ -149,16 +251,32 @@ typedef struct simfs_volume {
 // global open file table
 //
 #define SIMFS_INVALID_OPEN_FILE_TABLE_INDEX -1
+#define SIMFS_READAHEAD_MIN_WINDOW (SIMFS_INDEX_SIZE - 1) // data blocks prefetched once a read continues the last one
+#define SIMFS_READAHEAD_MAX_WINDOW (64 * (SIMFS_INDEX_SIZE - 1)) // the window doubles up to this many data blocks
+// content of a compressed file decompressed for simfsReadFileVector; kept until the file is written or closed
+typedef struct simfs_plain_content_type {
+    struct simfs_plain_content_type *next; // older content, still pinned
+    char data[];
+} SIMFS_PLAIN_CONTENT_TYPE;
+
 typedef struct simfs_open_file_global_type {
     SIMFS_CONTENT_TYPE type; // folder or file
     SIMFS_INDEX_TYPE fileDescriptor; // reference to the file descriptor node
     unsigned short referenceCount; // reference count
+    unsigned short processReferences; // of those, the ones held through a slot of a process's open file table
     time_t creationTime; // creation time
     time_t lastAccessTime; // last access
     time_t lastModificationTime; // last modification
     mode_t accessRights; // access rights for the file
     uid_t owner; // owner ID
     size_t size;
+    unsigned short pinCount; // vectors handed out by simfsReadFileVector that have not been released yet
+    SIMFS_INDEX_TYPE retiredBlockRef; // content replaced while pinned; freed when the last pin is released
+    SIMFS_PLAIN_CONTENT_TYPE *plainContent; // of a compressed file, or NULL until the first vector is read
+    SIMFS_PLAIN_CONTENT_TYPE *retiredPlainContent; // replaced while pinned; freed when the last pin is released
+    size_t nextReadOffset; // where the last read ended; a read starting here is sequential
+    SIMFS_INDEX_TYPE nextReadIndexBlock; // index block holding the data block at nextReadOffset
+    unsigned short readaheadWindow; // data blocks prefetched ahead of a sequential reader
 } SIMFS_OPEN_FILE_GLOBAL_TABLE_TYPE;
 
 //
@@ -206,6 +324,86 @@ typedef struct simfs_process_control_block_type {
     struct simfs_process_control_block_type *next;
 } SIMFS_PROCESS_CONTROL_BLOCK_TYPE;
 
+//
+// dentry cache
+//
+// Lookups of a name in a folder are remembered in a direct-mapped table keyed by the file descriptor block of the
+// folder and the name, lookups that found nothing included, so resolving a path probes one slot per component and
+// reads no blocks while its names are cached. Each folder has a generation that is incremented whenever a child is
+// added to or removed from it; an entry only holds while it carries the current generation of its folder.
+//
+#define SIMFS_DENTRY_CACHE_SIZE 1024 // a power of two
+
+typedef struct simfs_dentry_type {
+    SIMFS_INDEX_TYPE folder;
+    SIMFS_INDEX_TYPE node; // the file descriptor block of the child, or SIMFS_INVALID_INDEX for a missing name
+    uint16_t type; // folder or file
+    uint32_t generation; // of the folder when the entry was made; 0 for unused entries
+    SIMFS_NAME_TYPE name;
+} SIMFS_DENTRY_TYPE;
+
+//
+// name filter of a folder
+//
+// A counting Bloom filter of the hashes of the names in a folder, kept in memory for the folders in which a name was
+// looked up that the dentry cache did not hold. A name whose counters are not all set is certainly not in the folder,
+// so looking up a new name, as creating a file does, skips the search of the folder's directory. The filter is built
+// from the directory when it is first needed, and updated as children are added and removed; a counter that reached
+// its maximum stays there.
+//
+#define SIMFS_NAME_FILTER_BITS 13
+#define SIMFS_NAME_FILTER_SIZE (1 << SIMFS_NAME_FILTER_BITS) // counters
+#define SIMFS_NAME_FILTER_PROBES 3
+
+typedef struct simfs_name_filter_type {
+    uint8_t counter[SIMFS_NAME_FILTER_SIZE];
+} SIMFS_NAME_FILTER_TYPE;
+
+//
+// slab of fixed-size in-memory objects
+//
+// Directory entries and process control blocks are carved out of arenas of SIMFS_SLAB_ARENA_OBJECTS objects, and
+// freed ones are kept in a free list for the next allocation. The arenas are only returned to the system, all at
+// once, when the context is destroyed on unmounting.
+//
+#define SIMFS_SLAB_ARENA_OBJECTS 256
+
+typedef struct simfs_slab_arena_type {
+    struct simfs_slab_arena_type *next;
+    max_align_t objects[]; // SIMFS_SLAB_ARENA_OBJECTS objects of the size of the slab
+} SIMFS_SLAB_ARENA_TYPE;
+
+typedef struct simfs_slab_type {
+    size_t objectSize; // rounded up to keep every object aligned
+    void *freeList; // freed objects, linked through their first bytes
+    SIMFS_SLAB_ARENA_TYPE *arenas; // the newest first
+    int used; // objects carved out of the newest arena
+} SIMFS_SLAB_TYPE;
+
+//
+// deduplication of data blocks
+//
+// While deduplication is on, the content of every new data block is looked up by its 128-bit fingerprint in an index
+// of the data blocks of the volume, and a block with the same content is referred to instead of taking a new one, so
+// a data block may be referred to by several index blocks, of one file or of several. The references to each data
+// block are counted in the context, from the index blocks when the volume is mounted, and a data block is freed with
+// its last reference whether deduplication is on or not. The image format is the same with and without it.
+//
+// The index uses open addressing with linear probing and holds each data block at most once; it is only allocated
+// while deduplication is on.
+//
+#define SIMFS_FINGERPRINT_INDEX_SIZE (2 * SIMFS_NUMBER_OF_BLOCKS) // a power of two; the index is at most half full
+
+typedef struct simfs_fingerprint_type {
+    uint64_t low;
+    uint64_t high;
+} SIMFS_FINGERPRINT_TYPE;
+
+typedef struct simfs_fingerprint_index_type {
+    SIMFS_FINGERPRINT_TYPE fingerprint[SIMFS_FINGERPRINT_INDEX_SIZE];
+    SIMFS_INDEX_TYPE block[SIMFS_FINGERPRINT_INDEX_SIZE]; // SIMFS_INVALID_INDEX for an empty slot
+} SIMFS_FINGERPRINT_INDEX_TYPE;
+
 /*
  * file system context
  */
@@ -214,8 +412,28 @@ typedef struct simfs_context_type {
     unsigned char bitvector[SIMFS_NUMBER_OF_BLOCKS / 8]; // an in-memory copy of the bitvector of the simulated volume
     SIMFS_OPEN_FILE_GLOBAL_TABLE_TYPE globalOpenFileTable[SIMFS_MAX_NUMBER_OF_OPEN_FILES]; // in-memory
     SIMFS_PROCESS_CONTROL_BLOCK_TYPE *processControlBlocks;
+    SIMFS_DENTRY_TYPE dentryCache[SIMFS_DENTRY_CACHE_SIZE];
+    uint32_t folderGeneration[SIMFS_NUMBER_OF_BLOCKS]; // indexed by the file descriptor block of the folder
+    SIMFS_NAME_FILTER_TYPE *nameFilter[SIMFS_NUMBER_OF_BLOCKS]; // likewise; NULL until the filter is needed
+    SIMFS_SLAB_TYPE directoryEntries; // of SIMFS_DIR_ENT
+    SIMFS_SLAB_TYPE processes; // of SIMFS_PROCESS_CONTROL_BLOCK_TYPE
+    uint16_t dataReferences[SIMFS_NUMBER_OF_BLOCKS]; // slots of index blocks referring to each data block
+    SIMFS_FINGERPRINT_INDEX_TYPE *fingerprints; // of the data blocks; NULL while deduplication is off
 } SIMFS_CONTEXT_TYPE;
 
+//
+// instance of the file system
+//
+// An instance holds a volume, its in-memory context and its statistics counters. The functions taking an instance
+// work on that one; the others work on a default instance shared by the process. Instances share no mutable state,
+// so threads may work on different instances at the same time, but the calls on one instance must not overlap.
+//
+typedef struct simfs_instance_type {
+    SIMFS_CONTEXT_TYPE *context;
+    SIMFS_VOLUME *volume;
+    struct simfs_stats_counters_type *stats; // NULL for the default instance, whose counters are kept per thread
+} SIMFS_INSTANCE_TYPE;
+
 //////////////////////////////////////////////////////////////////////////
 //
 // file system function declarations
@@ -234,6 +452,134 @@ typedef enum simfs_error {
     SIMFS_SYSTEM_ERROR
 } SIMFS_ERROR;
 
+//
+// batch of operations submitted with one call to simfsSubmitBatch
+//
+// fileName is used by create, delete, get info and open; type by create; infoBuffer by get info; writeBuffer by
+// write; fileHandle is set by open and used by write and close. The outcome of each operation is left in result.
+//
+typedef enum {
+    SIMFS_CREATE_FILE_OPERATION,
+    SIMFS_DELETE_FILE_OPERATION,
+    SIMFS_GET_FILE_INFO_OPERATION,
+    SIMFS_OPEN_FILE_OPERATION,
+    SIMFS_WRITE_FILE_OPERATION,
+    SIMFS_CLOSE_FILE_OPERATION
+} SIMFS_OPERATION_TYPE;
+
+typedef struct simfs_batch_operation_type {
+    SIMFS_OPERATION_TYPE operation;
+    char *fileName;
+    SIMFS_CONTENT_TYPE type;
+    SIMFS_FILE_DESCRIPTOR_TYPE *infoBuffer;
+    char *writeBuffer;
+    SIMFS_FILE_HANDLE_TYPE fileHandle;
+    SIMFS_ERROR result;
+} SIMFS_BATCH_OPERATION_TYPE;
+
+//
+// entry of a folder listing returned by simfsReadDir
+//
+// A cursor names a position in the listing by the hash of the next name and its file descriptor block, not by
+// a count of entries, so a listing resumed after folders or files were created or deleted neither skips nor repeats
+// the entries that are still there. SIMFS_FOLDER_CURSOR_START starts a listing.
+//
+typedef unsigned long long SIMFS_FOLDER_CURSOR_TYPE;
+#define SIMFS_FOLDER_CURSOR_START 0
+
+typedef struct simfs_folder_entry_type {
+    SIMFS_NAME_TYPE name;
+    SIMFS_CONTENT_TYPE type; // folder or file
+    size_t size;
+    SIMFS_INDEX_TYPE node; // the file descriptor block
+    SIMFS_FOLDER_CURSOR_TYPE next; // resumes the listing after this entry
+} SIMFS_FOLDER_ENTRY_TYPE;
+
+//
+// progress of a compaction pass of simfsCompact
+//
+// A pass starts with a zeroed structure and is complete when next reaches SIMFS_NUMBER_OF_BLOCKS.
+//
+typedef struct simfs_compaction_type {
+    unsigned int next; // the next block to check for a folder or file descriptor
+    unsigned long relocatedFiles;
+    unsigned long relocatedBlocks;
+    unsigned long skippedFiles; // no run of free blocks was long enough
+} SIMFS_COMPACTION_TYPE;
+
+//
+// consistency check of simfsCheckFileSystem
+//
+// numberOfThreads and repair are set by the caller; the other fields are the findings. A block is live if it is
+// the root folder or is reached from it: a folder or file listed in the directory of a live folder, or a directory,
+// index or data block of a live folder or file. Blocks referenced more than once are kept as live.
+//
+#define SIMFS_CHECK_MAX_THREADS 64
+
+typedef struct simfs_check_type {
+    int numberOfThreads; // 0 for one per online processor
+    int repair; // non-zero to rebuild the bitvector and the in-memory directory and clear the blocks not live
+    unsigned long blocksByType[SIMFS_INVALID_CONTENT_TYPE + 1];
+    unsigned long liveBlocks;
+    unsigned long folders; // live ones
+    unsigned long files; // live ones
+    unsigned long orphanedDescriptors; // folders and files that are not reached from the root folder
+    unsigned long orphanedBlocks; // used according to the bitvector, but not live
+    unsigned long unmarkedBlocks; // live, but free according to the bitvector
+    unsigned long doublyReferencedBlocks; // other than data blocks, which deduplication shares
+    unsigned long sharedBlocks; // data blocks referred to more than once
+    unsigned long brokenReferences; // to a block outside the volume or of the wrong content type
+} SIMFS_CHECK_TYPE;
+
+//
+// statistics returned by simfsGetStats
+//
+// The counters are kept per thread and merged when they are read. Bucket i of a latency histogram counts the calls
+// that took less than 2^(i+1) nanoseconds but not less than 2^i (bucket 0 also counts those faster than 1 ns);
+// the last bucket counts everything slower.
+//
+#define SIMFS_STATS_NUMBER_OF_BUCKETS 32
+#define SIMFS_STATS_NUMBER_OF_ERRORS (SIMFS_SYSTEM_ERROR + 1)
+
+typedef enum {
+    SIMFS_STATS_MOUNT,
+    SIMFS_STATS_UMOUNT,
+    SIMFS_STATS_CREATE_FILE,
+    SIMFS_STATS_DELETE_FILE,
+    SIMFS_STATS_GET_FILE_INFO,
+    SIMFS_STATS_OPEN_FILE,
+    SIMFS_STATS_WRITE_FILE,
+    SIMFS_STATS_READ_FILE,
+    SIMFS_STATS_READ_FILE_VECTOR,
+    SIMFS_STATS_CLOSE_FILE,
+    SIMFS_STATS_READ_DIR,
+    SIMFS_STATS_RESOLVE_PATH,
+    SIMFS_STATS_NUMBER_OF_OPERATIONS
+} SIMFS_STATS_OPERATION_TYPE;
+
+typedef struct simfs_operation_stats_type {
+    unsigned long long calls;
+    unsigned long long results[SIMFS_STATS_NUMBER_OF_ERRORS]; // calls by returned code; results[SIMFS_NO_ERROR] succeeded
+    unsigned long long nanoseconds; // total
+    unsigned long long latency[SIMFS_STATS_NUMBER_OF_BUCKETS];
+} SIMFS_OPERATION_STATS_TYPE;
+
+typedef struct simfs_stats_type {
+    SIMFS_OPERATION_STATS_TYPE operation[SIMFS_STATS_NUMBER_OF_OPERATIONS];
+    unsigned long long blocksAllocated;
+    unsigned long long blocksFreed;
+    unsigned long long dentryHits; // lookups of a name answered by the dentry cache
+    unsigned long long dentryMisses;
+    unsigned long long blocksDeduplicated; // data blocks written as a reference to an existing one
+    // sampled from the mounted volume when the statistics are read
+    int freeBlocks;
+    int sharedBlocks; // data blocks referred to more than once
+    int directoryEntries;
+    int usedDirectorySlots; // hash chains that are not empty
+    int longestHashChain;
+    int openFiles; // occupied entries of the global open file table
+} SIMFS_STATS_TYPE;
+
 SIMFS_ERROR simfsCreateFileSystem(char *simfsFileSystemName);
 
 SIMFS_ERROR simfsUmountFileSystem(char *simfsFileSystemName);
@@ -254,6 +600,114 @@ SIMFS_ERROR simfsReadFile(SIMFS_FILE_HANDLE_TYPE fileHandle, char **readBuffer);
 
 SIMFS_ERROR simfsCloseFile(SIMFS_FILE_HANDLE_TYPE fileHandle);
 
+SIMFS_ERROR simfsReadFileVector(SIMFS_FILE_HANDLE_TYPE fileHandle, size_t offset, size_t size,
+                                struct iovec *vector, int *vectorCount);
+
+SIMFS_ERROR simfsReleaseFileVector(SIMFS_FILE_HANDLE_TYPE fileHandle);
+
+SIMFS_ERROR simfsSetFileCompression(SIMFS_FILE_HANDLE_TYPE fileHandle, int compressed);
+
+SIMFS_ERROR simfsSubmitBatch(SIMFS_BATCH_OPERATION_TYPE *operations, int count);
+
+SIMFS_ERROR simfsCompact(SIMFS_COMPACTION_TYPE *compaction, int blockBudget);
+
+SIMFS_ERROR simfsCheckFileSystem(SIMFS_CHECK_TYPE *check);
+
+SIMFS_ERROR simfsSetDeduplication(int enabled);
+
+SIMFS_ERROR simfsGetStats(SIMFS_STATS_TYPE *stats);
+
+int simfsFormatStats(SIMFS_STATS_TYPE *stats, char *buffer, size_t size);
+
+SIMFS_ERROR simfsResolvePath(char *path, SIMFS_INDEX_TYPE *node);
+
+SIMFS_ERROR simfsChangeDirectory(char *path);
+
+/*
+ * The following functions address folders and files through the block holding their file descriptor instead of
+ * a name in the current working directory. The FUSE low-level driver uses them to map inode numbers to blocks.
+ */
+
+SIMFS_ERROR simfsLookupFile(SIMFS_INDEX_TYPE folder, SIMFS_NAME_TYPE fileName, SIMFS_INDEX_TYPE *node);
+
+SIMFS_ERROR simfsGetFileInfoByReference(SIMFS_INDEX_TYPE node, SIMFS_FILE_DESCRIPTOR_TYPE *infoBuffer);
+
+SIMFS_ERROR simfsGetFolderEntry(SIMFS_INDEX_TYPE folder, int position, SIMFS_INDEX_TYPE *node);
+
+SIMFS_ERROR simfsReadDir(SIMFS_INDEX_TYPE folder, SIMFS_FOLDER_CURSOR_TYPE *cursor, SIMFS_FOLDER_ENTRY_TYPE *buffer,
+                         int max, int *count);
+
+SIMFS_ERROR simfsOpenFileByReference(SIMFS_INDEX_TYPE node, SIMFS_FILE_HANDLE_TYPE *fileHandle);
+
+/*
+ * The following functions work like those above, but on the given instance instead of the default one. An instance
+ * is created empty; a volume is then created or mounted on it.
+ */
+
+SIMFS_INSTANCE_TYPE *simfsCreateInstance();
+
+void simfsDestroyInstance(SIMFS_INSTANCE_TYPE *instance);
+
+SIMFS_ERROR simfsInstanceCreateFileSystem(SIMFS_INSTANCE_TYPE *instance, char *simfsFileSystemName);
+
+SIMFS_ERROR simfsInstanceUmountFileSystem(SIMFS_INSTANCE_TYPE *instance, char *simfsFileSystemName);
+
+SIMFS_ERROR simfsInstanceMountFileSystem(SIMFS_INSTANCE_TYPE *instance, char *simfsFileSystemName);
+
+SIMFS_ERROR simfsInstanceCreateFile(SIMFS_INSTANCE_TYPE *instance, SIMFS_NAME_TYPE fileName, SIMFS_CONTENT_TYPE type);
+
+SIMFS_ERROR simfsInstanceDeleteFile(SIMFS_INSTANCE_TYPE *instance, SIMFS_NAME_TYPE fileName);
+
+SIMFS_ERROR simfsInstanceGetFileInfo(SIMFS_INSTANCE_TYPE *instance, SIMFS_NAME_TYPE fileName,
+                                     SIMFS_FILE_DESCRIPTOR_TYPE *infoBuffer);
+
+SIMFS_ERROR simfsInstanceOpenFile(SIMFS_INSTANCE_TYPE *instance, SIMFS_NAME_TYPE fileName,
+                                  SIMFS_FILE_HANDLE_TYPE *fileHandle);
+
+SIMFS_ERROR simfsInstanceWriteFile(SIMFS_INSTANCE_TYPE *instance, SIMFS_FILE_HANDLE_TYPE fileHandle, char *writeBuffer);
+
+SIMFS_ERROR simfsInstanceReadFile(SIMFS_INSTANCE_TYPE *instance, SIMFS_FILE_HANDLE_TYPE fileHandle, char **readBuffer);
+
+SIMFS_ERROR simfsInstanceCloseFile(SIMFS_INSTANCE_TYPE *instance, SIMFS_FILE_HANDLE_TYPE fileHandle);
+
+SIMFS_ERROR simfsInstanceReadFileVector(SIMFS_INSTANCE_TYPE *instance, SIMFS_FILE_HANDLE_TYPE fileHandle, size_t offset,
+                                        size_t size, struct iovec *vector, int *vectorCount);
+
+SIMFS_ERROR simfsInstanceReleaseFileVector(SIMFS_INSTANCE_TYPE *instance, SIMFS_FILE_HANDLE_TYPE fileHandle);
+
+SIMFS_ERROR simfsInstanceSetFileCompression(SIMFS_INSTANCE_TYPE *instance, SIMFS_FILE_HANDLE_TYPE fileHandle,
+                                            int compressed);
+
+SIMFS_ERROR simfsInstanceSubmitBatch(SIMFS_INSTANCE_TYPE *instance, SIMFS_BATCH_OPERATION_TYPE *operations, int count);
+
+SIMFS_ERROR simfsInstanceCompact(SIMFS_INSTANCE_TYPE *instance, SIMFS_COMPACTION_TYPE *compaction, int blockBudget);
+
+SIMFS_ERROR simfsInstanceCheckFileSystem(SIMFS_INSTANCE_TYPE *instance, SIMFS_CHECK_TYPE *check);
+
+SIMFS_ERROR simfsInstanceSetDeduplication(SIMFS_INSTANCE_TYPE *instance, int enabled);
+
+SIMFS_ERROR simfsInstanceGetStats(SIMFS_INSTANCE_TYPE *instance, SIMFS_STATS_TYPE *stats);
+
+SIMFS_ERROR simfsInstanceResolvePath(SIMFS_INSTANCE_TYPE *instance, char *path, SIMFS_INDEX_TYPE *node);
+
+SIMFS_ERROR simfsInstanceChangeDirectory(SIMFS_INSTANCE_TYPE *instance, char *path);
+
+SIMFS_ERROR simfsInstanceLookupFile(SIMFS_INSTANCE_TYPE *instance, SIMFS_INDEX_TYPE folder, SIMFS_NAME_TYPE fileName,
+                                    SIMFS_INDEX_TYPE *node);
+
+SIMFS_ERROR simfsInstanceGetFileInfoByReference(SIMFS_INSTANCE_TYPE *instance, SIMFS_INDEX_TYPE node,
+                                                SIMFS_FILE_DESCRIPTOR_TYPE *infoBuffer);
+
+SIMFS_ERROR simfsInstanceGetFolderEntry(SIMFS_INSTANCE_TYPE *instance, SIMFS_INDEX_TYPE folder, int position,
+                                        SIMFS_INDEX_TYPE *node);
+
+SIMFS_ERROR simfsInstanceReadDir(SIMFS_INSTANCE_TYPE *instance, SIMFS_INDEX_TYPE folder,
+                                 SIMFS_FOLDER_CURSOR_TYPE *cursor, SIMFS_FOLDER_ENTRY_TYPE *buffer, int max,
+                                 int *count);
+
+SIMFS_ERROR simfsInstanceOpenFileByReference(SIMFS_INSTANCE_TYPE *instance, SIMFS_INDEX_TYPE node,
+                                             SIMFS_FILE_HANDLE_TYPE *fileHandle);
+
 /*
  * The following functions can be used to simulate FUSE context's user and process identifiers for testing.
  *
@@ -0,0 +1,652 @@
+#include "simfs.h"
+#include "simfs_crc.h"
+
+//////////////////////////////////////////////////////////////////////////
+//
+// micro and macro benchmarks of the file system
+//
+// usage: simfs_bench [results.json]
+//
+// Every benchmark repeats its operation until SIMFS_BENCH_MIN_TIME seconds have passed and records the time per
+// operation. The results are written as JSON (by default to simfs_bench.json, since the file system itself prints
+// to the standard output) so that runs of different releases can be compared.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#define SIMFS_BENCH_FILE_NAME "simfsBench.dta"
+#define SIMFS_BENCH_RESULTS_FILE_NAME "simfs_bench.json"
+#define SIMFS_BENCH_MIN_TIME 0.2 // seconds per benchmark
+#define SIMFS_BENCH_MAX_RESULTS 128
+
+typedef struct simfs_bench_result_type {
+    char name[64];
+    long parameter; // the size the benchmark varies: folder size, file size, ...
+    long iterations;
+    double nanosecondsPerOperation;
+    double bytesPerSecond; // 0 if not meaningful
+} SIMFS_BENCH_RESULT_TYPE;
+
+static SIMFS_BENCH_RESULT_TYPE results[SIMFS_BENCH_MAX_RESULTS];
+static int numberOfResults = 0;
+
+static volatile unsigned long sink; // keeps the compiler from dropping the measured calls
+
+static double now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void record(char *name, long parameter, long iterations, double seconds, double bytes)
+{
+    if (numberOfResults == SIMFS_BENCH_MAX_RESULTS)
+        return;
+
+    SIMFS_BENCH_RESULT_TYPE *result = &results[numberOfResults++];
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    result->parameter = parameter;
+    result->iterations = iterations;
+    result->nanosecondsPerOperation = seconds * 1e9 / iterations;
+    result->bytesPerSecond = bytes / seconds;
+
+    fprintf(stderr, "%-24s %8ld %12.1f ns/op\n", name, parameter, result->nanosecondsPerOperation);
+}
+
+static void fail(char *what)
+{
+    fprintf(stderr, "simfs_bench: %s failed\n", what);
+    exit(EXIT_FAILURE);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+/***
+ * simfsFindFreeBlock on a bitvector whose first used blocks are marked.
+ */
+static void benchFindFreeBlock(char *name, int usedBlocks)
+{
+    unsigned char bitvector[SIMFS_NUMBER_OF_BLOCKS / 8] = {0};
+    for (int i = 0; i < usedBlocks; i++)
+        simfsSetBit(bitvector, i);
+
+    long iterations = 0;
+    double start = now(), elapsed;
+    do {
+        for (int i = 0; i < 1024; i++)
+            sink += simfsFindFreeBlock(bitvector);
+        iterations += 1024;
+    } while ((elapsed = now() - start) < SIMFS_BENCH_MIN_TIME);
+
+    record(name, usedBlocks, iterations, elapsed, 0);
+}
+
+static void benchHash(int length)
+{
+    char *name = simfsGenerateContent(length);
+
+    long iterations = 0;
+    double start = now(), elapsed;
+    do {
+        for (int i = 0; i < 1024; i++)
+            sink += hash((unsigned char *) name);
+        iterations += 1024;
+    } while ((elapsed = now() - start) < SIMFS_BENCH_MIN_TIME);
+
+    record("hash", length, iterations, elapsed, (double) iterations * length);
+    free(name);
+}
+
+// checksums of count blocks at once, as computed for an image file on mount and umount
+static void benchChecksum(int count)
+{
+    SIMFS_BLOCK_TYPE *blocks = calloc(count, sizeof(SIMFS_BLOCK_TYPE));
+    uint32_t *checksums = malloc(count * sizeof(uint32_t));
+    if (blocks == NULL || checksums == NULL)
+        fail("allocate blocks");
+
+    long iterations = 0;
+    double start = now(), elapsed;
+    do {
+        simfsCrc32cBlocks(blocks, sizeof(SIMFS_BLOCK_TYPE), count, checksums);
+        sink += checksums[count - 1];
+        iterations++;
+    } while ((elapsed = now() - start) < SIMFS_BENCH_MIN_TIME);
+
+    record("crc32c", count, iterations, elapsed, (double) iterations * count * sizeof(SIMFS_BLOCK_TYPE));
+    free(checksums);
+    free(blocks);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+static void mountEmptyVolume()
+{
+    if (simfsCreateFileSystem(SIMFS_BENCH_FILE_NAME) != SIMFS_NO_ERROR)
+        fail("simfsCreateFileSystem");
+    if (simfsMountFileSystem(SIMFS_BENCH_FILE_NAME) != SIMFS_NO_ERROR)
+        fail("simfsMountFileSystem");
+}
+
+static void fillFolder(int numberOfFiles)
+{
+    SIMFS_NAME_TYPE fileName;
+    for (int i = 0; i < numberOfFiles; i++) {
+        snprintf(fileName, sizeof(fileName), "file%d", i);
+        if (simfsCreateFile(fileName, SIMFS_FILE_CONTENT_TYPE) != SIMFS_NO_ERROR)
+            fail("simfsCreateFile");
+    }
+}
+
+/***
+ * Creating, opening, closing and deleting a file in a folder that already holds folderSize files.
+ */
+static void benchFileOperations(int folderSize)
+{
+    mountEmptyVolume();
+    fillFolder(folderSize);
+
+    SIMFS_NAME_TYPE fileName = "benchmark";
+    SIMFS_FILE_HANDLE_TYPE fileHandle;
+    double create = 0, open = 0, close = 0, delete = 0;
+    long iterations = 0;
+    do {
+        double start = now();
+        if (simfsCreateFile(fileName, SIMFS_FILE_CONTENT_TYPE) != SIMFS_NO_ERROR)
+            fail("simfsCreateFile");
+        double created = now();
+        if (simfsOpenFile(fileName, &fileHandle) != SIMFS_NO_ERROR)
+            fail("simfsOpenFile");
+        double opened = now();
+        if (simfsCloseFile(fileHandle) != SIMFS_NO_ERROR)
+            fail("simfsCloseFile");
+        double closed = now();
+        if (simfsDeleteFile(fileName) != SIMFS_NO_ERROR)
+            fail("simfsDeleteFile");
+        double deleted = now();
+
+        create += created - start;
+        open += opened - created;
+        close += closed - opened;
+        delete += deleted - closed;
+        iterations++;
+    } while (create + open + close + delete < SIMFS_BENCH_MIN_TIME);
+
+    record("create", folderSize, iterations, create, 0);
+    record("open", folderSize, iterations, open, 0);
+    record("close", folderSize, iterations, close, 0);
+    record("delete", folderSize, iterations, delete, 0);
+
+    simfsUmountFileSystem(SIMFS_BENCH_FILE_NAME);
+}
+
+/***
+ * Creating numberOfFiles files with new names in an empty folder; the time is that of one creation.
+ */
+static void benchBulkCreate(int numberOfFiles)
+{
+    long iterations = 0;
+    double elapsed = 0;
+    do {
+        mountEmptyVolume();
+        double start = now();
+        fillFolder(numberOfFiles);
+        elapsed += now() - start;
+        iterations += numberOfFiles;
+        simfsUmountFileSystem(SIMFS_BENCH_FILE_NAME);
+    } while (elapsed < SIMFS_BENCH_MIN_TIME);
+
+    record("bulkCreate", numberOfFiles, iterations, elapsed, 0);
+}
+
+/***
+ * Resolving the path of a file at the bottom of depth nested folders, and of a name missing from the deepest folder.
+ */
+static void benchResolvePath(int depth)
+{
+    mountEmptyVolume();
+
+    char path[16 * SIMFS_MAX_NAME_LENGTH] = ""; // "/folder0/folder1/.../" and a file name
+    for (int i = 0; i < depth; i++) {
+        SIMFS_NAME_TYPE folderName;
+        snprintf(folderName, sizeof(folderName), "folder%d", i);
+        if (simfsCreateFile(folderName, SIMFS_FOLDER_CONTENT_TYPE) != SIMFS_NO_ERROR)
+            fail("simfsCreateFile");
+        if (simfsChangeDirectory(folderName) != SIMFS_NO_ERROR)
+            fail("simfsChangeDirectory");
+        snprintf(path + strlen(path), sizeof(path) - strlen(path), "/%s", folderName);
+    }
+    fillFolder(16);
+    simfsChangeDirectory("/");
+
+    size_t length = strlen(path);
+    SIMFS_INDEX_TYPE node;
+    long iterations = 0;
+    double start = now(), elapsed;
+    strcpy(path + length, "/file0");
+    do {
+        for (int i = 0; i < 1024; i++) {
+            if (simfsResolvePath(path, &node) != SIMFS_NO_ERROR)
+                fail("simfsResolvePath");
+            sink += node;
+        }
+        iterations += 1024;
+    } while ((elapsed = now() - start) < SIMFS_BENCH_MIN_TIME);
+    record("resolvePath", depth, iterations, elapsed, 0);
+
+    iterations = 0;
+    start = now();
+    strcpy(path + length, "/missing");
+    do {
+        for (int i = 0; i < 1024; i++)
+            sink += simfsResolvePath(path, &node);
+        iterations += 1024;
+    } while ((elapsed = now() - start) < SIMFS_BENCH_MIN_TIME);
+    record("resolvePath.missing", depth, iterations, elapsed, 0);
+
+    simfsUmountFileSystem(SIMFS_BENCH_FILE_NAME);
+}
+
+/***
+ * Replacing and reading the whole content of a file of fileSize bytes.
+ */
+static void benchWriteRead(int fileSize)
+{
+    mountEmptyVolume();
+
+    SIMFS_NAME_TYPE fileName = "benchmark";
+    SIMFS_FILE_HANDLE_TYPE fileHandle;
+    if (simfsCreateFile(fileName, SIMFS_FILE_CONTENT_TYPE) != SIMFS_NO_ERROR
+        || simfsOpenFile(fileName, &fileHandle) != SIMFS_NO_ERROR)
+        fail("simfsOpenFile");
+
+    char *content = simfsGenerateContent(fileSize);
+    long iterations = 0;
+    double start = now(), elapsed;
+    do {
+        if (simfsWriteFile(fileHandle, content) != SIMFS_NO_ERROR)
+            fail("simfsWriteFile");
+        iterations++;
+    } while ((elapsed = now() - start) < SIMFS_BENCH_MIN_TIME);
+    record("write", fileSize, iterations, elapsed, (double) iterations * fileSize);
+
+    char *readBuffer;
+    iterations = 0;
+    start = now();
+    do {
+        if (simfsReadFile(fileHandle, &readBuffer) != SIMFS_NO_ERROR)
+            fail("simfsReadFile");
+        free(readBuffer);
+        iterations++;
+    } while ((elapsed = now() - start) < SIMFS_BENCH_MIN_TIME);
+    record("read", fileSize, iterations, elapsed, (double) iterations * fileSize);
+
+    free(content);
+    simfsCloseFile(fileHandle);
+    simfsUmountFileSystem(SIMFS_BENCH_FILE_NAME);
+}
+
+/***
+ * Text of size - 1 random words from a small vocabulary and a terminating zero, which compresses about as well as
+ * the content of files written by people.
+ */
+static char *generateText(int size)
+{
+    static char *words[] = {"the ", "file ", "system ", "block ", "index ", "of ", "a ", "volume ", "is ", "stored "};
+    char *text = malloc(size);
+    if (text == NULL)
+        fail("allocate text");
+
+    for (int i = 0; i < size - 1;) {
+        char *word = words[rand() % (sizeof(words) / sizeof(words[0]))];
+        for (int j = 0; word[j] != '\0' && i < size - 1; j++)
+            text[i++] = word[j];
+    }
+    text[size - 1] = '\0';
+    return text;
+}
+
+/***
+ * Replacing and reading the content of a compressed file of fileSize bytes, once with text and once with content
+ * that does not compress, whose chunks are stored raw.
+ */
+static void benchCompression(int fileSize)
+{
+    mountEmptyVolume();
+
+    SIMFS_NAME_TYPE fileName = "benchmark";
+    SIMFS_FILE_HANDLE_TYPE fileHandle;
+    if (simfsCreateFile(fileName, SIMFS_FILE_CONTENT_TYPE) != SIMFS_NO_ERROR
+        || simfsOpenFile(fileName, &fileHandle) != SIMFS_NO_ERROR
+        || simfsSetFileCompression(fileHandle, 1) != SIMFS_NO_ERROR)
+        fail("simfsSetFileCompression");
+
+    char *contents[] = {generateText(fileSize), simfsGenerateContent(fileSize)};
+    char *names[][2] = {{"write.compressed", "read.compressed"}, {"write.incompressible", "read.incompressible"}};
+    for (int c = 0; c < 2; c++) {
+        long iterations = 0;
+        double start = now(), elapsed;
+        do {
+            if (simfsWriteFile(fileHandle, contents[c]) != SIMFS_NO_ERROR)
+                fail("simfsWriteFile");
+            iterations++;
+        } while ((elapsed = now() - start) < SIMFS_BENCH_MIN_TIME);
+        record(names[c][0], fileSize, iterations, elapsed, (double) iterations * fileSize);
+
+        char *readBuffer;
+        iterations = 0;
+        start = now();
+        do {
+            if (simfsReadFile(fileHandle, &readBuffer) != SIMFS_NO_ERROR)
+                fail("simfsReadFile");
+            free(readBuffer);
+            iterations++;
+        } while ((elapsed = now() - start) < SIMFS_BENCH_MIN_TIME);
+        record(names[c][1], fileSize, iterations, elapsed, (double) iterations * fileSize);
+
+        free(contents[c]);
+    }
+
+    simfsCloseFile(fileHandle);
+    simfsUmountFileSystem(SIMFS_BENCH_FILE_NAME);
+}
+
+/***
+ * Replacing the content of a file of fileSize bytes with content that another file holds already, without and with
+ * deduplication; the blocks that the copy takes are reported as well.
+ */
+static void benchDeduplication(int fileSize)
+{
+    char *name[][2] = {{"write.duplicate", "blocks.duplicate"}, {"write.deduplicated", "blocks.deduplicated"}};
+    char *content = simfsGenerateContent(fileSize);
+    for (int enabled = 0; enabled < 2; enabled++) {
+        mountEmptyVolume();
+
+        SIMFS_NAME_TYPE originalName = "original", fileName = "benchmark";
+        SIMFS_FILE_HANDLE_TYPE original, fileHandle;
+        if (simfsCreateFile(originalName, SIMFS_FILE_CONTENT_TYPE) != SIMFS_NO_ERROR
+            || simfsCreateFile(fileName, SIMFS_FILE_CONTENT_TYPE) != SIMFS_NO_ERROR
+            || simfsOpenFile(originalName, &original) != SIMFS_NO_ERROR
+            || simfsOpenFile(fileName, &fileHandle) != SIMFS_NO_ERROR
+            || simfsSetDeduplication(enabled) != SIMFS_NO_ERROR
+            || simfsWriteFile(original, content) != SIMFS_NO_ERROR)
+            fail("simfsSetDeduplication");
+
+        SIMFS_STATS_TYPE before, after;
+        simfsGetStats(&before);
+        long iterations = 0;
+        double start = now(), elapsed;
+        do {
+            if (simfsWriteFile(fileHandle, content) != SIMFS_NO_ERROR)
+                fail("simfsWriteFile");
+            iterations++;
+        } while ((elapsed = now() - start) < SIMFS_BENCH_MIN_TIME);
+        record(name[enabled][0], fileSize, iterations, elapsed, (double) iterations * fileSize);
+
+        simfsGetStats(&after);
+        fprintf(stderr, "%-24s %8d %12d blocks\n", name[enabled][1], fileSize, before.freeBlocks - after.freeBlocks);
+
+        simfsCloseFile(original);
+        simfsCloseFile(fileHandle);
+        simfsUmountFileSystem(SIMFS_BENCH_FILE_NAME);
+    }
+    free(content);
+}
+
+/***
+ * Mounting and unmounting a volume holding numberOfFiles files.
+ *
+ * The size of the volume file is fixed by SIMFS_NUMBER_OF_BLOCKS, so what varies is the number of used blocks
+ * that have to be hashed into the directory while mounting.
+ */
+static void benchMountUmount(int numberOfFiles)
+{
+    mountEmptyVolume();
+    fillFolder(numberOfFiles);
+    if (simfsUmountFileSystem(SIMFS_BENCH_FILE_NAME) != SIMFS_NO_ERROR)
+        fail("simfsUmountFileSystem");
+
+    double mount = 0, umount = 0;
+    long iterations = 0;
+    do {
+        double start = now();
+        if (simfsMountFileSystem(SIMFS_BENCH_FILE_NAME) != SIMFS_NO_ERROR)
+            fail("simfsMountFileSystem");
+        double mounted = now();
+        if (simfsUmountFileSystem(SIMFS_BENCH_FILE_NAME) != SIMFS_NO_ERROR)
+            fail("simfsUmountFileSystem");
+        double unmounted = now();
+
+        mount += mounted - start;
+        umount += unmounted - mounted;
+        iterations++;
+    } while (mount + umount < SIMFS_BENCH_MIN_TIME);
+
+    record("mount", numberOfFiles, iterations, mount, (double) iterations * sizeof(SIMFS_VOLUME));
+    record("umount", numberOfFiles, iterations, umount, (double) iterations * sizeof(SIMFS_VOLUME));
+}
+
+/***
+ * Starting a service on an existing volume of numberOfFiles files: a fresh instance that has never seen the volume
+ * mounts it, which builds the in-memory context from the image alone.
+ */
+static void benchStartup(int numberOfFiles)
+{
+    mountEmptyVolume();
+    fillFolder(numberOfFiles);
+    if (simfsUmountFileSystem(SIMFS_BENCH_FILE_NAME) != SIMFS_NO_ERROR)
+        fail("simfsUmountFileSystem");
+
+    double elapsed = 0;
+    long iterations = 0;
+    do {
+        double start = now();
+        SIMFS_INSTANCE_TYPE *instance = simfsCreateInstance();
+        if (instance == NULL || simfsInstanceMountFileSystem(instance, SIMFS_BENCH_FILE_NAME) != SIMFS_NO_ERROR)
+            fail("simfsInstanceMountFileSystem");
+        elapsed += now() - start;
+        simfsDestroyInstance(instance);
+        iterations++;
+    } while (elapsed < SIMFS_BENCH_MIN_TIME);
+
+    record("startup", numberOfFiles, iterations, elapsed, (double) iterations * sizeof(SIMFS_VOLUME));
+}
+
+/***
+ * A consistency check of a volume of 2048 files with numberOfThreads threads.
+ */
+static void benchCheck(int numberOfThreads)
+{
+    mountEmptyVolume();
+    fillFolder(2048);
+
+    double elapsed = 0;
+    long iterations = 0;
+    do {
+        SIMFS_CHECK_TYPE check = {.numberOfThreads = numberOfThreads};
+        double start = now();
+        if (simfsCheckFileSystem(&check) != SIMFS_NO_ERROR)
+            fail("simfsCheckFileSystem");
+        elapsed += now() - start;
+        sink += check.liveBlocks;
+        iterations++;
+    } while (elapsed < SIMFS_BENCH_MIN_TIME);
+
+    record("check", numberOfThreads, iterations, elapsed, (double) iterations * sizeof(SIMFS_VOLUME));
+    simfsUmountFileSystem(SIMFS_BENCH_FILE_NAME);
+}
+
+/***
+ * Mounting and unmounting a volume striped across stripeCount image files. The files are in the same folder, so
+ * this measures the overhead of striping; the gain needs image files on separate devices.
+ */
+static void benchStriping(int stripeCount)
+{
+    char names[SIMFS_MAX_STRIPES * 32] = SIMFS_BENCH_FILE_NAME;
+    for (int i = 1; i < stripeCount; i++)
+        snprintf(names + strlen(names), sizeof(names) - strlen(names), "%csimfsBench%d.dta", SIMFS_STRIPE_SEPARATOR, i);
+
+    mountEmptyVolume();
+    fillFolder(512);
+    if (simfsUmountFileSystem(names) != SIMFS_NO_ERROR)
+        fail("simfsUmountFileSystem");
+
+    double mount = 0, umount = 0;
+    long iterations = 0;
+    do {
+        double start = now();
+        if (simfsMountFileSystem(names) != SIMFS_NO_ERROR)
+            fail("simfsMountFileSystem");
+        double mounted = now();
+        if (simfsUmountFileSystem(names) != SIMFS_NO_ERROR)
+            fail("simfsUmountFileSystem");
+        double unmounted = now();
+
+        mount += mounted - start;
+        umount += unmounted - mounted;
+        iterations++;
+    } while (mount + umount < SIMFS_BENCH_MIN_TIME);
+
+    record("mount.striped", stripeCount, iterations, mount, (double) iterations * sizeof(SIMFS_VOLUME));
+    record("umount.striped", stripeCount, iterations, umount, (double) iterations * sizeof(SIMFS_VOLUME));
+
+    char name[32];
+    for (int i = 1; i < stripeCount; i++) {
+        snprintf(name, sizeof(name), "simfsBench%d.dta", i);
+        remove(name);
+    }
+}
+
+/***
+ * Reading a file of fileSize bytes whose blocks are scattered over the holes left by deleted files, before and
+ * after the volume is compacted.
+ */
+static void benchCompaction(int fileSize)
+{
+    mountEmptyVolume();
+    fillFolder(512);
+
+    SIMFS_NAME_TYPE fileName;
+    SIMFS_FILE_HANDLE_TYPE fileHandle;
+    char *content = simfsGenerateContent(SIMFS_DATA_SIZE);
+    for (int i = 0; i < 512; i++) {
+        snprintf(fileName, sizeof(fileName), "file%d", i);
+        if (simfsOpenFile(fileName, &fileHandle) != SIMFS_NO_ERROR
+            || simfsWriteFile(fileHandle, content) != SIMFS_NO_ERROR)
+            fail("simfsWriteFile");
+        simfsCloseFile(fileHandle);
+    }
+    free(content);
+
+    // every other file is deleted, leaving holes of one block in both allocation groups
+    for (int i = 0; i < 512; i += 2) {
+        snprintf(fileName, sizeof(fileName), "file%d", i);
+        if (simfsDeleteFile(fileName) != SIMFS_NO_ERROR)
+            fail("simfsDeleteFile");
+    }
+
+    content = simfsGenerateContent(fileSize);
+    snprintf(fileName, sizeof(fileName), "benchmark");
+    if (simfsCreateFile(fileName, SIMFS_FILE_CONTENT_TYPE) != SIMFS_NO_ERROR
+        || simfsOpenFile(fileName, &fileHandle) != SIMFS_NO_ERROR
+        || simfsWriteFile(fileHandle, content) != SIMFS_NO_ERROR)
+        fail("simfsWriteFile");
+    free(content);
+
+    char *name[] = {"read.fragmented", "read.compacted"};
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            SIMFS_COMPACTION_TYPE compaction = {0};
+            double start = now();
+            while (compaction.next < SIMFS_NUMBER_OF_BLOCKS)
+                if (simfsCompact(&compaction, SIMFS_NUMBER_OF_BLOCKS) != SIMFS_NO_ERROR)
+                    fail("simfsCompact");
+            record("compact", fileSize, 1, now() - start, 0);
+        }
+
+        char *readBuffer;
+        long iterations = 0;
+        double start = now(), elapsed;
+        do {
+            if (simfsReadFile(fileHandle, &readBuffer) != SIMFS_NO_ERROR)
+                fail("simfsReadFile");
+            free(readBuffer);
+            iterations++;
+        } while ((elapsed = now() - start) < SIMFS_BENCH_MIN_TIME);
+        record(name[pass], fileSize, iterations, elapsed, (double) iterations * fileSize);
+    }
+
+    simfsCloseFile(fileHandle);
+    simfsUmountFileSystem(SIMFS_BENCH_FILE_NAME);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+static void writeResults(char *fileName)
+{
+    FILE *file = fopen(fileName, "w");
+    if (file == NULL)
+        fail("fopen");
+
+    fprintf(file, "{\n  \"volumeBytes\": %zu,\n  \"blockSize\": %d,\n  \"numberOfBlocks\": %d,\n  \"benchmarks\": [\n",
+            sizeof(SIMFS_VOLUME), SIMFS_BLOCK_SIZE, SIMFS_NUMBER_OF_BLOCKS);
+    for (int i = 0; i < numberOfResults; i++) {
+        fprintf(file, "    {\"name\": \"%s\", \"parameter\": %ld, \"iterations\": %ld, "
+                      "\"nanosecondsPerOperation\": %.1f, \"bytesPerSecond\": %.0f}%s\n",
+                results[i].name, results[i].parameter, results[i].iterations,
+                results[i].nanosecondsPerOperation, results[i].bytesPerSecond,
+                i < numberOfResults - 1 ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+
+    fclose(file);
+}
+
+int main(int argc, char *argv[])
+{
+    benchFindFreeBlock("findFreeBlock.empty", 0);
+    benchFindFreeBlock("findFreeBlock.halfFull", SIMFS_NUMBER_OF_BLOCKS / 2);
+    benchFindFreeBlock("findFreeBlock.nearlyFull", SIMFS_NUMBER_OF_BLOCKS - 1);
+
+    for (int length = 8; length <= SIMFS_MAX_NAME_LENGTH; length *= 2)
+        benchHash(length - 1);
+
+    for (int count = 1; count <= SIMFS_NUMBER_OF_BLOCKS; count *= 64)
+        benchChecksum(count);
+
+    for (int folderSize = 0; folderSize <= 1024; folderSize = (folderSize == 0 ? 16 : folderSize * 4))
+        benchFileOperations(folderSize);
+
+    for (int numberOfFiles = 256; numberOfFiles <= 2048; numberOfFiles *= 2)
+        benchBulkCreate(numberOfFiles);
+
+    for (int depth = 1; depth <= 16; depth *= 4)
+        benchResolvePath(depth);
+
+    // copy-on-write needs room for the old and the new content at the same time
+    for (int fileSize = 64; fileSize <= 16 * 1024; fileSize *= 4)
+        benchWriteRead(fileSize);
+
+    for (int fileSize = 64; fileSize <= 16 * 1024; fileSize *= 4)
+        benchCompression(fileSize);
+
+    for (int fileSize = 1024; fileSize <= 4 * 1024; fileSize *= 4)
+        benchDeduplication(fileSize); // two copies of a larger file do not fit while a third is written
+
+    for (int numberOfFiles = 0; numberOfFiles <= 2048; numberOfFiles = (numberOfFiles == 0 ? 128 : numberOfFiles * 4))
+        benchMountUmount(numberOfFiles);
+
+    for (int numberOfFiles = 0; numberOfFiles <= 2048; numberOfFiles = (numberOfFiles == 0 ? 128 : numberOfFiles * 4))
+        benchStartup(numberOfFiles);
+
+    for (int numberOfThreads = 1; numberOfThreads <= 8; numberOfThreads *= 2)
+        benchCheck(numberOfThreads);
+
+    for (int stripeCount = 1; stripeCount <= 4; stripeCount *= 2)
+        benchStriping(stripeCount);
+
+    benchCompaction(8 * 1024);
+
+    writeResults(argc > 1 ? argv[1] : SIMFS_BENCH_RESULTS_FILE_NAME);
+    return EXIT_SUCCESS;
+}
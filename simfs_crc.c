@@ -0,0 +1,131 @@
+#include "simfs_crc.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define SIMFS_CRC_SSE42 1
+#endif
+
+#define SIMFS_CRC_POLYNOMIAL 0x82F63B78 // reversed Castagnoli polynomial
+
+static uint32_t table[256];
+static pthread_once_t tableOnce = PTHREAD_ONCE_INIT;
+
+static void initTable()
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; j++)
+            crc = (crc >> 1) ^ (crc & 1 ? SIMFS_CRC_POLYNOMIAL : 0);
+        table[i] = crc;
+    }
+}
+
+static uint32_t crcTable(uint32_t crc, const unsigned char *data, size_t length)
+{
+    pthread_once(&tableOnce, initTable);
+    while (length-- > 0)
+        crc = (crc >> 8) ^ table[(crc ^ *data++) & 0xFF];
+    return crc;
+}
+
+#ifdef SIMFS_CRC_SSE42
+static bool hasSse42()
+{
+    return __builtin_cpu_supports("sse4.2");
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t crcSse42(uint32_t crc, const unsigned char *data, size_t length)
+{
+    for (; length > 0 && ((uintptr_t) data & 7) != 0; length--)
+        crc = _mm_crc32_u8(crc, *data++);
+#ifdef __x86_64__
+    uint64_t crc64 = crc;
+    for (; length >= 8; length -= 8, data += 8) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = (uint32_t) crc64;
+#endif
+    for (; length >= 4; length -= 4, data += 4) {
+        uint32_t word;
+        memcpy(&word, data, 4);
+        crc = _mm_crc32_u32(crc, word);
+    }
+    for (; length > 0; length--)
+        crc = _mm_crc32_u8(crc, *data++);
+    return crc;
+}
+
+/***
+ * Checksums three blocks in one pass, with three independent chains of crc32 instructions.
+ */
+__attribute__((target("sse4.2")))
+static void crcSse42Three(const unsigned char *block, size_t blockSize, uint32_t *checksums)
+{
+    const unsigned char *first = block, *second = block + blockSize, *third = block + 2 * blockSize;
+    uint32_t crc0 = 0xFFFFFFFF, crc1 = 0xFFFFFFFF, crc2 = 0xFFFFFFFF;
+    size_t offset = 0;
+#ifdef __x86_64__
+    uint64_t crc064 = crc0, crc164 = crc1, crc264 = crc2;
+    for (; offset + 8 <= blockSize; offset += 8) {
+        uint64_t word0, word1, word2;
+        memcpy(&word0, first + offset, 8);
+        memcpy(&word1, second + offset, 8);
+        memcpy(&word2, third + offset, 8);
+        crc064 = _mm_crc32_u64(crc064, word0);
+        crc164 = _mm_crc32_u64(crc164, word1);
+        crc264 = _mm_crc32_u64(crc264, word2);
+    }
+    crc0 = (uint32_t) crc064;
+    crc1 = (uint32_t) crc164;
+    crc2 = (uint32_t) crc264;
+#endif
+    checksums[0] = ~crcSse42(crc0, first + offset, blockSize - offset);
+    checksums[1] = ~crcSse42(crc1, second + offset, blockSize - offset);
+    checksums[2] = ~crcSse42(crc2, third + offset, blockSize - offset);
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+
+/***
+ * Continues the checksum crc, 0 for a new one, over length bytes of data.
+ */
+uint32_t simfsCrc32c(uint32_t crc, const void *data, size_t length)
+{
+#ifdef SIMFS_CRC_SSE42
+    if (hasSse42())
+        return ~crcSse42(~crc, data, length);
+#endif
+    return ~crcTable(~crc, data, length);
+}
+
+/***
+ * Computes the checksums of count consecutive blocks of blockSize bytes each into the array checksums.
+ */
+void simfsCrc32cBlocks(const void *blocks, size_t blockSize, int count, uint32_t *checksums)
+{
+    const unsigned char *block = blocks;
+    int i = 0;
+#ifdef SIMFS_CRC_SSE42
+    if (hasSse42())
+        for (; i + 3 <= count; i += 3)
+            crcSse42Three(block + i * blockSize, blockSize, &checksums[i]);
+#endif
+    for (; i < count; i++)
+        checksums[i] = simfsCrc32c(0, block + i * blockSize, blockSize);
+}
+
+const char *simfsCrc32cImplementation()
+{
+#ifdef SIMFS_CRC_SSE42
+    if (hasSse42())
+        return "sse4.2";
+#endif
+    return "table";
+}
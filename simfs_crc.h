@@ -0,0 +1,23 @@
+#ifndef __SIMFS_CRC_H_
+#define __SIMFS_CRC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+//////////////////////////////////////////////////////////////////////////
+//
+// CRC-32C (Castagnoli) checksums of blocks
+//
+// The checksums are computed with the crc32 instruction of SSE4.2 where the processor has it, and with a table of
+// 256 remainders otherwise; both give the same values. simfsCrc32cBlocks checksums consecutive blocks three at a
+// time, so that the latency of one crc32 instruction is hidden behind those of the other two blocks.
+//
+//////////////////////////////////////////////////////////////////////////
+
+uint32_t simfsCrc32c(uint32_t crc, const void *data, size_t length);
+
+void simfsCrc32cBlocks(const void *blocks, size_t blockSize, int count, uint32_t *checksums);
+
+const char *simfsCrc32cImplementation();
+
+#endif
@@ -0,0 +1,603 @@
+
+#define FUSE_USE_VERSION 26
+
+#include <fuse_lowlevel.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "simfs.h"
+
+//////////////////////////////////////////////////////////////////////////
+//
+// FUSE low-level driver for simfs
+//
+// The high-level FUSE API passes a full path to every operation, so each call would have to resolve the path
+// again. The low-level API works on inode numbers instead, and the inode number of a folder or file is derived
+// directly from the block holding its file descriptor, so apart from lookup no operation searches by name.
+//
+// The volume is served read-only: there is no create, mkdir, unlink, rmdir, write or setattr, and opening a file
+// for writing fails with EROFS. Since nothing is deleted while the volume is served, and compaction moves the
+// directory, index and data blocks of a folder or file but never its descriptor, an inode number stays valid for
+// the whole session, and lookups need no counting for forget.
+//
+// The session loop is single-threaded, since the simfs functions are not reentrant. While no request is waiting,
+// it compacts the volume with simfsCompact in small steps, so a request waits for one step at most.
+//
+// The root folder also holds a virtual file, .simfs_stats, that is not part of the volume; reading it returns the
+// statistics of simfsGetStats as of the moment the file was opened. It is not listed by readdir.
+//
+// With the option check, the volume is checked with simfsCheckFileSystem on all processors before it is served, and
+// repaired if the check finds blocks that are not where the bitvector says. With the option dedup, data blocks
+// written with the content of a block the volume holds already share that block (see simfsSetDeduplication).
+//
+// usage: simfs_fuse [-o image=<volume file>[:<volume file>...]] [-o check] [-o dedup] <mountpoint>
+//
+//////////////////////////////////////////////////////////////////////////
+
+#define SIMFS_FUSE_DEFAULT_IMAGE "simfsFile.dta"
+#define SIMFS_FUSE_TIMEOUT 1.0 // seconds the kernel may cache attributes and names
+#define SIMFS_FUSE_MAX_VECTOR 1023 // iovecs in a reply; the kernel accepts up to UIO_MAXIOV including the header
+#define SIMFS_FUSE_READDIR_BATCH 64 // folder entries fetched from simfsReadDir at a time
+#define SIMFS_FUSE_COMPACTION_BUDGET 64 // blocks moved by a compaction step
+#define SIMFS_FUSE_COMPACTION_IDLE 10 // milliseconds without requests before a compaction step
+#define SIMFS_FUSE_COMPACTION_PAUSE 60000 // milliseconds between the end of a compaction pass and the next one
+
+// the root folder is always the inode FUSE_ROOT_ID
+#define SIMFS_INODE_TO_NODE(ino) ((SIMFS_INDEX_TYPE) ((ino) - FUSE_ROOT_ID + SIMFS_ROOT_NODE_INDEX))
+#define SIMFS_NODE_TO_INODE(node) ((fuse_ino_t) (node) - SIMFS_ROOT_NODE_INDEX + FUSE_ROOT_ID)
+
+// the statistics file takes the first inode number past those of the blocks
+#define SIMFS_FUSE_STATS_NAME ".simfs_stats"
+#define SIMFS_FUSE_STATS_INODE SIMFS_NODE_TO_INODE(SIMFS_NUMBER_OF_BLOCKS)
+
+typedef struct simfs_fuse_options_type {
+    char *image;
+    int check;
+    int dedup;
+} SIMFS_FUSE_OPTIONS_TYPE;
+
+static const struct fuse_opt simfsFuseOptions[] = {
+    {"image=%s", offsetof(SIMFS_FUSE_OPTIONS_TYPE, image), 0},
+    {"check", offsetof(SIMFS_FUSE_OPTIONS_TYPE, check), 1},
+    {"dedup", offsetof(SIMFS_FUSE_OPTIONS_TYPE, dedup), 1},
+    FUSE_OPT_END
+};
+
+static SIMFS_FUSE_OPTIONS_TYPE options;
+
+//
+// text of the statistics file taken when it is opened; fi->fh points to it while the file is open
+//
+typedef struct simfs_fuse_stats_snapshot_type {
+    size_t length;
+    char text[];
+} SIMFS_FUSE_STATS_SNAPSHOT_TYPE;
+
+//////////////////////////////////////////////////////////////////////////
+//
+// helpers
+//
+//////////////////////////////////////////////////////////////////////////
+
+/***
+ * Translates an error of the simfs functions to an errno value.
+ */
+static int simfsErrno(SIMFS_ERROR error)
+{
+    switch (error)
+    {
+        case SIMFS_NO_ERROR:
+            return 0;
+        case SIMFS_ALLOC_ERROR:
+            return ENOMEM;
+        case SIMFS_DUPLICATE_ERROR:
+            return EEXIST;
+        case SIMFS_NOT_FOUND_ERROR:
+            return ENOENT;
+        case SIMFS_NOT_EMPTY_ERROR:
+            return ENOTEMPTY;
+        case SIMFS_ACCESS_ERROR:
+            return EACCES;
+        default:
+            return EIO;
+    }
+}
+
+/***
+ * Obtains the file descriptor for an inode; returns 0 or an errno value.
+ */
+static int getInode(fuse_ino_t ino, SIMFS_FILE_DESCRIPTOR_TYPE *info)
+{
+    if (ino < FUSE_ROOT_ID || ino >= SIMFS_NODE_TO_INODE(SIMFS_NUMBER_OF_BLOCKS))
+        return ENOENT;
+
+    return simfsErrno(simfsGetFileInfoByReference(SIMFS_INODE_TO_NODE(ino), info));
+}
+
+/***
+ * Copies the part of a file that did not fit into the iovecs of a reply into one buffer described by the
+ * parameter remainder. Returns the buffer, or NULL if there is nothing left to read.
+ */
+static char *gatherRemainder(SIMFS_FILE_HANDLE_TYPE fileHandle, size_t offset, size_t size, struct iovec *remainder)
+{
+    struct iovec vector[SIMFS_FUSE_MAX_VECTOR];
+    char *buffer = malloc(size);
+    size_t length = 0;
+
+    while (buffer != NULL && length < size)
+    {
+        int count = SIMFS_FUSE_MAX_VECTOR;
+        if (simfsReadFileVector(fileHandle, offset + length, size - length, vector, &count) != SIMFS_NO_ERROR)
+            break;
+
+        for (int i = 0; i < count; i++)
+        {
+            memcpy(buffer + length, vector[i].iov_base, vector[i].iov_len);
+            length += vector[i].iov_len;
+        }
+        simfsReleaseFileVector(fileHandle);
+
+        if (count < SIMFS_FUSE_MAX_VECTOR)
+            break;
+    }
+
+    if (length == 0)
+    {
+        free(buffer);
+        return NULL;
+    }
+
+    remainder->iov_base = buffer;
+    remainder->iov_len = length;
+    return buffer;
+}
+
+static void fillStat(fuse_ino_t ino, SIMFS_FILE_DESCRIPTOR_TYPE *info, struct stat *st)
+{
+    memset(st, 0, sizeof(struct stat));
+
+    st->st_ino = ino;
+    if (info->type == SIMFS_FOLDER_CONTENT_TYPE)
+    {
+        st->st_mode = S_IFDIR | (info->accessRights & 07777);
+        st->st_nlink = 2;
+    }
+    else
+    {
+        st->st_mode = S_IFREG | (info->accessRights & 07777);
+        st->st_nlink = 1;
+    }
+    st->st_uid = info->owner;
+    st->st_size = info->size;
+    st->st_atime = info->lastAccessTime;
+    st->st_mtime = info->lastModificationTime;
+    st->st_ctime = info->creationTime;
+}
+
+/***
+ * Formats the current statistics; returns NULL if memory runs out.
+ */
+static SIMFS_FUSE_STATS_SNAPSHOT_TYPE *takeStatsSnapshot()
+{
+    SIMFS_STATS_TYPE stats;
+    simfsGetStats(&stats);
+
+    int length = simfsFormatStats(&stats, NULL, 0);
+    SIMFS_FUSE_STATS_SNAPSHOT_TYPE *snapshot = malloc(sizeof(SIMFS_FUSE_STATS_SNAPSHOT_TYPE) + length + 1);
+    if (snapshot == NULL)
+        return NULL;
+
+    snapshot->length = simfsFormatStats(&stats, snapshot->text, length + 1);
+    return snapshot;
+}
+
+static void fillStatsStat(struct stat *st)
+{
+    SIMFS_FUSE_STATS_SNAPSHOT_TYPE *snapshot = takeStatsSnapshot();
+
+    memset(st, 0, sizeof(struct stat));
+    st->st_ino = SIMFS_FUSE_STATS_INODE;
+    st->st_mode = S_IFREG | 0444;
+    st->st_nlink = 1;
+    st->st_size = (snapshot != NULL ? snapshot->length : 0);
+    st->st_atime = st->st_mtime = st->st_ctime = time(NULL);
+
+    free(snapshot);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//
+// low-level operations
+//
+//////////////////////////////////////////////////////////////////////////
+
+static void simfsFuseDestroy(void *userdata)
+{
+    simfsUmountFileSystem(options.image);
+}
+
+/***
+ * Looks up a name in a folder.
+ *
+ * The unique identifier of the file is passed as the generation of the inode, so the kernel can tell a new
+ * file from a deleted one whose file descriptor block has been reused.
+ */
+static void simfsFuseLookup(fuse_req_t req, fuse_ino_t parent, const char *name)
+{
+    SIMFS_FILE_DESCRIPTOR_TYPE info;
+    SIMFS_NAME_TYPE fileName;
+    SIMFS_INDEX_TYPE node;
+    struct fuse_entry_param entry;
+
+    if (parent == FUSE_ROOT_ID && strcmp(name, SIMFS_FUSE_STATS_NAME) == 0)
+    {
+        memset(&entry, 0, sizeof(entry));
+        entry.ino = SIMFS_FUSE_STATS_INODE;
+        entry.entry_timeout = SIMFS_FUSE_TIMEOUT;
+        fillStatsStat(&entry.attr);
+        fuse_reply_entry(req, &entry);
+        return;
+    }
+
+    int error = getInode(parent, &info);
+    if (error != 0)
+    {
+        fuse_reply_err(req, error);
+        return;
+    }
+
+    if (strlen(name) >= SIMFS_MAX_NAME_LENGTH)
+    {
+        fuse_reply_err(req, ENAMETOOLONG);
+        return;
+    }
+    strcpy(fileName, name);
+
+    error = simfsErrno(simfsLookupFile(SIMFS_INODE_TO_NODE(parent), fileName, &node));
+    if (error == 0)
+        error = simfsErrno(simfsGetFileInfoByReference(node, &info));
+    if (error != 0)
+    {
+        fuse_reply_err(req, error);
+        return;
+    }
+
+    memset(&entry, 0, sizeof(entry));
+    entry.ino = SIMFS_NODE_TO_INODE(node);
+    entry.generation = info.identifier;
+    entry.attr_timeout = SIMFS_FUSE_TIMEOUT;
+    entry.entry_timeout = SIMFS_FUSE_TIMEOUT;
+    fillStat(entry.ino, &info, &entry.attr);
+
+    fuse_reply_entry(req, &entry);
+}
+
+static void simfsFuseGetattr(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+{
+    SIMFS_FILE_DESCRIPTOR_TYPE info;
+    struct stat st;
+
+    if (ino == SIMFS_FUSE_STATS_INODE)
+    {
+        fillStatsStat(&st);
+        fuse_reply_attr(req, &st, 0);
+        return;
+    }
+
+    int error = getInode(ino, &info);
+    if (error != 0)
+    {
+        fuse_reply_err(req, error);
+        return;
+    }
+
+    fillStat(ino, &info, &st);
+    fuse_reply_attr(req, &st, SIMFS_FUSE_TIMEOUT);
+}
+
+/***
+ * Lists a folder in batches of simfsReadDir. "." and ".." take the offsets 0 and 1, and the offset of any other entry
+ * is its simfsReadDir cursor plus two, so a listing continued by the kernel resumes where the last reply ended.
+ */
+static void simfsFuseReaddir(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, struct fuse_file_info *fi)
+{
+    SIMFS_FILE_DESCRIPTOR_TYPE info;
+    SIMFS_FOLDER_ENTRY_TYPE entries[SIMFS_FUSE_READDIR_BATCH];
+    struct stat st;
+
+    int error = getInode(ino, &info);
+    if (error == 0 && info.type != SIMFS_FOLDER_CONTENT_TYPE)
+        error = ENOTDIR;
+    if (error != 0)
+    {
+        fuse_reply_err(req, error);
+        return;
+    }
+
+    char *buffer = malloc(size);
+    if (buffer == NULL)
+    {
+        fuse_reply_err(req, ENOMEM);
+        return;
+    }
+
+    size_t used = 0;
+    bool full = false;
+    memset(&st, 0, sizeof(st));
+    st.st_ino = ino;
+    st.st_mode = S_IFDIR;
+    for (; off < 2 && !full; off++)
+    {
+        size_t length = fuse_add_direntry(req, buffer + used, size - used, off == 0 ? "." : "..", &st, off + 1);
+        full = (length > size - used);
+        if (!full)
+            used += length;
+    }
+
+    SIMFS_FOLDER_CURSOR_TYPE cursor = off - 2;
+    int count = SIMFS_FUSE_READDIR_BATCH;
+    while (!full && count == SIMFS_FUSE_READDIR_BATCH
+           && simfsReadDir(SIMFS_INODE_TO_NODE(ino), &cursor, entries, count, &count) == SIMFS_NO_ERROR)
+    {
+        for (int i = 0; i < count && !full; i++)
+        {
+            // the kernel only takes the inode number and the type from a directory entry
+            st.st_ino = SIMFS_NODE_TO_INODE(entries[i].node);
+            st.st_mode = (entries[i].type == SIMFS_FOLDER_CONTENT_TYPE ? S_IFDIR : S_IFREG);
+
+            size_t length = fuse_add_direntry(req, buffer + used, size - used, entries[i].name, &st,
+                                              entries[i].next + 2);
+            full = (length > size - used);
+            if (!full)
+                used += length;
+        }
+    }
+
+    fuse_reply_buf(req, buffer, used);
+    free(buffer);
+}
+
+/***
+ * Opens a file through the global open file table; the file handle is kept in fi->fh.
+ *
+ * The content of the volume is served read-only (only compaction and the repair of the option check change its
+ * blocks), so opening for writing is refused with EROFS.
+ *
+ * Opening the statistics file takes a snapshot of the statistics, which is read with direct I/O, since its size
+ * changes all the time.
+ */
+static void simfsFuseOpen(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+{
+    SIMFS_FILE_DESCRIPTOR_TYPE info;
+    SIMFS_FILE_HANDLE_TYPE fileHandle;
+
+    if (ino == SIMFS_FUSE_STATS_INODE)
+    {
+        SIMFS_FUSE_STATS_SNAPSHOT_TYPE *snapshot = NULL;
+        if ((fi->flags & O_ACCMODE) != O_RDONLY)
+            fuse_reply_err(req, EACCES);
+        else if ((snapshot = takeStatsSnapshot()) == NULL)
+            fuse_reply_err(req, ENOMEM);
+        else
+        {
+            fi->fh = (uintptr_t) snapshot;
+            fi->direct_io = 1;
+            fuse_reply_open(req, fi);
+        }
+        return;
+    }
+
+    int error = getInode(ino, &info);
+    if (error == 0 && info.type == SIMFS_FOLDER_CONTENT_TYPE)
+        error = EISDIR;
+    if (error == 0 && (fi->flags & O_ACCMODE) != O_RDONLY)
+        error = EROFS;
+    if (error == 0)
+        error = simfsErrno(simfsOpenFileByReference(SIMFS_INODE_TO_NODE(ino), &fileHandle));
+    if (error != 0)
+    {
+        fuse_reply_err(req, error);
+        return;
+    }
+
+    fi->fh = fileHandle;
+    fi->keep_cache = 1;
+    fuse_reply_open(req, fi);
+}
+
+/***
+ * Replies with iovecs pointing straight into the data blocks of the volume, so the content is copied only once,
+ * into the kernel. The blocks stay pinned until the reply has been sent.
+ *
+ * With small blocks a large read may need more iovecs than a reply can carry; the remainder is then gathered
+ * into a buffer instead of shortening the reply, since the kernel takes a short read for the end of the file.
+ */
+static void simfsFuseRead(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, struct fuse_file_info *fi)
+{
+    SIMFS_FILE_HANDLE_TYPE fileHandle = (SIMFS_FILE_HANDLE_TYPE) fi->fh;
+    struct iovec vector[SIMFS_FUSE_MAX_VECTOR];
+    int count = SIMFS_FUSE_MAX_VECTOR - 1; // one element is kept for the remainder
+
+    if (ino == SIMFS_FUSE_STATS_INODE)
+    {
+        SIMFS_FUSE_STATS_SNAPSHOT_TYPE *snapshot = (SIMFS_FUSE_STATS_SNAPSHOT_TYPE *) (uintptr_t) fi->fh;
+        size_t start = ((size_t) off < snapshot->length ? (size_t) off : snapshot->length);
+        fuse_reply_buf(req, snapshot->text + start, (size < snapshot->length - start ? size : snapshot->length - start));
+        return;
+    }
+
+    SIMFS_ERROR error = simfsReadFileVector(fileHandle, off, size, vector, &count);
+    if (error != SIMFS_NO_ERROR)
+    {
+        fuse_reply_err(req, simfsErrno(error));
+        return;
+    }
+
+    size_t length = 0;
+    for (int i = 0; i < count; i++)
+        length += vector[i].iov_len;
+
+    char *remainder = NULL;
+    if (count == SIMFS_FUSE_MAX_VECTOR - 1 && length < size)
+        remainder = gatherRemainder(fileHandle, off + length, size - length, &vector[count]);
+    if (remainder != NULL)
+        count++;
+
+    fuse_reply_iov(req, vector, count);
+
+    free(remainder);
+    simfsReleaseFileVector(fileHandle);
+}
+
+static void simfsFuseRelease(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+{
+    if (ino == SIMFS_FUSE_STATS_INODE)
+    {
+        free((SIMFS_FUSE_STATS_SNAPSHOT_TYPE *) (uintptr_t) fi->fh);
+        fuse_reply_err(req, 0);
+        return;
+    }
+
+    fuse_reply_err(req, simfsErrno(simfsCloseFile((SIMFS_FILE_HANDLE_TYPE) fi->fh)));
+}
+
+static const struct fuse_lowlevel_ops simfsFuseOperations = {
+    .destroy = simfsFuseDestroy,
+    .lookup = simfsFuseLookup,
+    .getattr = simfsFuseGetattr,
+    .readdir = simfsFuseReaddir,
+    .open = simfsFuseOpen,
+    .read = simfsFuseRead,
+    .release = simfsFuseRelease,
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+/***
+ * Works like fuse_session_loop, but waits for requests with a timeout and runs a step of compaction whenever it
+ * expires. After a complete pass the loop waits longer before it starts the next one.
+ */
+static int sessionLoop(struct fuse_session *session, struct fuse_chan *channel)
+{
+    size_t size = fuse_chan_bufsize(channel);
+    char *buffer = malloc(size);
+    if (buffer == NULL)
+        return -1;
+
+    SIMFS_COMPACTION_TYPE compaction = {0};
+    struct pollfd request = {.fd = fuse_chan_fd(channel), .events = POLLIN};
+    int err = 0;
+
+    while (!fuse_session_exited(session))
+    {
+        bool passComplete = (compaction.next >= SIMFS_NUMBER_OF_BLOCKS);
+        int ready = poll(&request, 1, passComplete ? SIMFS_FUSE_COMPACTION_PAUSE : SIMFS_FUSE_COMPACTION_IDLE);
+        if (ready == -1 && errno != EINTR)
+        {
+            err = -1;
+            break;
+        }
+
+        if (ready == 0)
+        {
+            if (passComplete)
+                memset(&compaction, 0, sizeof(compaction));
+            simfsCompact(&compaction, SIMFS_FUSE_COMPACTION_BUDGET);
+            continue;
+        }
+        if (ready == -1)
+            continue;
+
+        struct fuse_chan *from = channel;
+        int length = fuse_chan_recv(&from, buffer, size);
+        if (length == -EINTR || length == -EAGAIN)
+            continue;
+        if (length <= 0)
+        {
+            err = (length < 0 ? -1 : 0);
+            break;
+        }
+
+        fuse_session_process(session, buffer, length, from);
+    }
+
+    free(buffer);
+    return err;
+}
+
+int main(int argc, char *argv[])
+{
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct fuse_chan *channel;
+    char *mountpoint;
+    int foreground;
+    int err = -1;
+
+    options.image = strdup(SIMFS_FUSE_DEFAULT_IMAGE);
+    if (fuse_opt_parse(&args, &options, simfsFuseOptions, NULL) == -1)
+        return EXIT_FAILURE;
+
+    // a volume that does not exist yet is created; a striped volume exists if its first image file does
+    char *first = strdup(options.image), *separator;
+    if (first != NULL && (separator = strchr(first, SIMFS_STRIPE_SEPARATOR)) != NULL)
+        *separator = '\0';
+    FILE *file = (first == NULL ? NULL : fopen(first, "rb"));
+    free(first);
+    if (file != NULL)
+        fclose(file);
+    else if (simfsCreateFileSystem(options.image) != SIMFS_NO_ERROR)
+    {
+        fprintf(stderr, "simfs: cannot create %s\n", options.image);
+        return EXIT_FAILURE;
+    }
+
+    if (simfsMountFileSystem(options.image) != SIMFS_NO_ERROR)
+    {
+        fprintf(stderr, "simfs: cannot mount %s\n", options.image);
+        return EXIT_FAILURE;
+    }
+
+    SIMFS_CHECK_TYPE check = {.numberOfThreads = 0, .repair = 1};
+    if (options.check && simfsCheckFileSystem(&check) != SIMFS_NO_ERROR)
+    {
+        fprintf(stderr, "simfs: cannot check %s\n", options.image);
+        return EXIT_FAILURE;
+    }
+    if (options.check)
+        fprintf(stderr, "simfs: %lu folders, %lu files, %lu live blocks; repaired %lu orphaned blocks "
+                "(%lu folders or files), %lu unmarked blocks; %lu blocks referenced twice, %lu broken references; "
+                "%lu shared data blocks\n",
+                check.folders, check.files, check.liveBlocks, check.orphanedBlocks, check.orphanedDescriptors,
+                check.unmarkedBlocks, check.doublyReferencedBlocks, check.brokenReferences, check.sharedBlocks);
+
+    if (options.dedup && simfsSetDeduplication(1) != SIMFS_NO_ERROR)
+    {
+        fprintf(stderr, "simfs: cannot turn on deduplication\n");
+        return EXIT_FAILURE;
+    }
+
+    if (fuse_parse_cmdline(&args, &mountpoint, NULL, &foreground) != -1
+        && (channel = fuse_mount(mountpoint, &args)) != NULL)
+    {
+        struct fuse_session *session = fuse_lowlevel_new(&args, &simfsFuseOperations,
+                                                         sizeof(simfsFuseOperations), NULL);
+        if (session != NULL)
+        {
+            if (fuse_set_signal_handlers(session) != -1)
+            {
+                fuse_session_add_chan(session, channel);
+                fuse_daemonize(foreground);
+                err = sessionLoop(session, channel);
+                fuse_remove_signal_handlers(session);
+                fuse_session_remove_chan(channel);
+            }
+            fuse_session_destroy(session);
+        }
+        fuse_unmount(mountpoint, channel);
+    }
+    fuse_opt_free_args(&args);
+
+    return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,311 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "simfs.h"
+
+//////////////////////////////////////////////////////////////////////////
+//
+// reports the fragmentation of a volume image
+//
+// usage: simfs_inspect [-j <threads>] <volume file>
+//
+// The image is mapped read-only and the blocks are split into one contiguous range per thread. Each thread counts
+// the content types and the free extents of its range and follows the index chains of the files whose file
+// descriptors lie in it; the partial results are then merged in the order of the ranges, joining free extents
+// that cross from one range into the next.
+//
+// A file made of n extents has its data blocks in n runs of consecutive block numbers, in the order of its
+// index chain; the depth of an index chain is the number of index blocks it is made of.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#define SIMFS_INSPECT_MAX_THREADS 256
+#define SIMFS_INSPECT_BUCKETS 17 // bucket i holds sizes in [2^i, 2^(i+1)); enough for 2^16 blocks
+#define SIMFS_INSPECT_WORST_FILES 10
+
+typedef struct simfs_inspect_file_type {
+    SIMFS_INDEX_TYPE node;
+    unsigned long extents;
+} SIMFS_INSPECT_FILE_TYPE;
+
+typedef struct simfs_inspect_range_type {
+    pthread_t thread;
+    bool started;
+    int start;
+    int end;
+
+    unsigned long blocksByType[SIMFS_INVALID_CONTENT_TYPE + 1];
+    unsigned long usedBlocks; // according to the bitvector
+
+    // free extents entirely inside the range; the ones touching its ends are merged later
+    unsigned long freeExtents[SIMFS_INSPECT_BUCKETS];
+    int leadingFree;
+    int trailingFree;
+
+    unsigned long files;
+    unsigned long filesWithContent;
+    unsigned long extents;
+    unsigned long extentsPerFile[SIMFS_INSPECT_BUCKETS];
+    unsigned long chainDepth;
+    unsigned long deepestChain;
+    unsigned long brokenChains;
+    SIMFS_INSPECT_FILE_TYPE worst[SIMFS_INSPECT_WORST_FILES];
+} SIMFS_INSPECT_RANGE_TYPE;
+
+static SIMFS_VOLUME *volume;
+
+//////////////////////////////////////////////////////////////////////////
+
+static int bucket(unsigned long size)
+{
+    int i = 63 - __builtin_clzl(size | 1);
+    return (i < SIMFS_INSPECT_BUCKETS ? i : SIMFS_INSPECT_BUCKETS - 1);
+}
+
+static bool isUsed(int block)
+{
+    return volume->bitvector[block / 8] & (0x80 >> (block % 8));
+}
+
+static bool isIndexBlock(SIMFS_INDEX_TYPE block)
+{
+    return block != 0 && block < SIMFS_NUMBER_OF_BLOCKS && volume->block[block].type == SIMFS_INDEX_CONTENT_TYPE;
+}
+
+static void keepWorst(SIMFS_INSPECT_FILE_TYPE *worst, SIMFS_INDEX_TYPE node, unsigned long extents)
+{
+    int i = SIMFS_INSPECT_WORST_FILES - 1;
+    if (extents <= worst[i].extents)
+        return;
+
+    for (; i > 0 && worst[i - 1].extents < extents; i--)
+        worst[i] = worst[i - 1];
+    worst[i].node = node;
+    worst[i].extents = extents;
+}
+
+/***
+ * Follows the index chain of a file; the walk stops at a reference that does not lead to an index block and
+ * after as many index blocks as there are blocks, so a damaged volume cannot make it loop.
+ */
+static void inspectFile(SIMFS_INSPECT_RANGE_TYPE *range, SIMFS_INDEX_TYPE node)
+{
+    SIMFS_FILE_DESCRIPTOR_TYPE *descriptor = &volume->block[node].content.fileDescriptor;
+    range->files++;
+    if (descriptor->block_ref == SIMFS_INVALID_INDEX)
+        return;
+
+    unsigned long extents = 0, depth = 0;
+    long previous = -2;
+    SIMFS_INDEX_TYPE indexBlock = descriptor->block_ref;
+    while (isIndexBlock(indexBlock) && depth < SIMFS_NUMBER_OF_BLOCKS) {
+        depth++;
+        SIMFS_INDEX_TYPE *index = volume->block[indexBlock].content.index;
+        for (int j = 0; j < SIMFS_INDEX_SIZE - 1 && index[j] != 0; j++) {
+            if (index[j] != previous + 1)
+                extents++;
+            previous = index[j];
+        }
+        indexBlock = index[SIMFS_INDEX_SIZE - 1];
+    }
+    if (indexBlock != 0)
+        range->brokenChains++;
+
+    range->filesWithContent++;
+    range->extents += extents;
+    range->extentsPerFile[bucket(extents)]++;
+    range->chainDepth += depth;
+    if (depth > range->deepestChain)
+        range->deepestChain = depth;
+    keepWorst(range->worst, node, extents);
+}
+
+static void *inspectRange(void *argument)
+{
+    SIMFS_INSPECT_RANGE_TYPE *range = argument;
+
+    int run = 0;
+    bool leading = true;
+    for (int i = range->start; i < range->end; i++) {
+        SIMFS_CONTENT_TYPE type = volume->block[i].type;
+        range->blocksByType[type <= SIMFS_INVALID_CONTENT_TYPE ? type : SIMFS_INVALID_CONTENT_TYPE]++;
+        if (type == SIMFS_FILE_CONTENT_TYPE)
+            inspectFile(range, i);
+
+        if (!isUsed(i)) {
+            run++;
+            continue;
+        }
+
+        range->usedBlocks++;
+        if (leading)
+            range->leadingFree = run;
+        else if (run > 0)
+            range->freeExtents[bucket(run)]++;
+        leading = false;
+        run = 0;
+    }
+
+    if (leading)
+        range->leadingFree = run; // the whole range is free
+    else
+        range->trailingFree = run;
+
+    return NULL;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+static void printHistogram(char *title, unsigned long *histogram)
+{
+    printf("%s\n", title);
+    for (int i = 0; i < SIMFS_INSPECT_BUCKETS; i++)
+        if (histogram[i] != 0)
+            printf("  %6lu - %-6lu %10lu\n", 1UL << i, (2UL << i) - 1, histogram[i]);
+}
+
+static void report(SIMFS_INSPECT_RANGE_TYPE *ranges, int count)
+{
+    SIMFS_INSPECT_RANGE_TYPE total;
+    memset(&total, 0, sizeof(total));
+
+    // free extents crossing a range boundary are carried over until a used block ends them
+    unsigned long open = 0;
+    for (int r = 0; r < count; r++) {
+        SIMFS_INSPECT_RANGE_TYPE *range = &ranges[r];
+        open += range->leadingFree;
+        if (range->usedBlocks > 0) {
+            if (open > 0)
+                total.freeExtents[bucket(open)]++;
+            open = range->trailingFree;
+        }
+
+        for (int i = 0; i <= SIMFS_INVALID_CONTENT_TYPE; i++)
+            total.blocksByType[i] += range->blocksByType[i];
+        for (int i = 0; i < SIMFS_INSPECT_BUCKETS; i++) {
+            total.freeExtents[i] += range->freeExtents[i];
+            total.extentsPerFile[i] += range->extentsPerFile[i];
+        }
+        total.usedBlocks += range->usedBlocks;
+        total.files += range->files;
+        total.filesWithContent += range->filesWithContent;
+        total.extents += range->extents;
+        total.chainDepth += range->chainDepth;
+        total.brokenChains += range->brokenChains;
+        if (range->deepestChain > total.deepestChain)
+            total.deepestChain = range->deepestChain;
+        for (int i = 0; i < SIMFS_INSPECT_WORST_FILES; i++)
+            keepWorst(total.worst, range->worst[i].node, range->worst[i].extents);
+    }
+    if (open > 0)
+        total.freeExtents[bucket(open)]++;
+
+    static char *typeNames[] = {"folder", "file", "index", "data", "directory", "invalid"};
+    printf("blocks %d, used %lu, free %lu\n", SIMFS_NUMBER_OF_BLOCKS, total.usedBlocks,
+           SIMFS_NUMBER_OF_BLOCKS - total.usedBlocks);
+    printf("blocks by content type\n");
+    for (int i = 0; i <= SIMFS_INVALID_CONTENT_TYPE; i++)
+        printf("  %-8s %10lu\n", typeNames[i], total.blocksByType[i]);
+
+    unsigned long freeExtents = 0;
+    for (int i = 0; i < SIMFS_INSPECT_BUCKETS; i++)
+        freeExtents += total.freeExtents[i];
+    printf("free extents %lu\n", freeExtents);
+    printHistogram("free extents by size in blocks", total.freeExtents);
+
+    printf("files %lu, with content %lu\n", total.files, total.filesWithContent);
+    if (total.filesWithContent > 0) {
+        printf("extents per file: average %.2f\n", (double) total.extents / total.filesWithContent);
+        printHistogram("files by number of extents", total.extentsPerFile);
+        printf("index chain depth: average %.2f, deepest %lu\n",
+               (double) total.chainDepth / total.filesWithContent, total.deepestChain);
+        printf("most fragmented files\n");
+        for (int i = 0; i < SIMFS_INSPECT_WORST_FILES && total.worst[i].extents > 0; i++)
+            printf("  %-40.40s block %5u %8lu extents\n", volume->block[total.worst[i].node].content.fileDescriptor.name,
+                   total.worst[i].node, total.worst[i].extents);
+    }
+    if (total.brokenChains > 0)
+        printf("index chains ending in a block that is not an index block: %lu\n", total.brokenChains);
+}
+
+int main(int argc, char *argv[])
+{
+    int numberOfThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    int option;
+    while ((option = getopt(argc, argv, "j:")) != -1) {
+        if (option == 'j')
+            numberOfThreads = atoi(optarg);
+        else
+            optind = argc + 1;
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "usage: simfs_inspect [-j <threads>] <volume file>\n");
+        return EXIT_FAILURE;
+    }
+    if (numberOfThreads < 1)
+        numberOfThreads = 1;
+    if (numberOfThreads > SIMFS_INSPECT_MAX_THREADS)
+        numberOfThreads = SIMFS_INSPECT_MAX_THREADS;
+
+    int file = open(argv[optind], O_RDONLY);
+    struct stat st;
+    if (file < 0 || fstat(file, &st) != 0) {
+        fprintf(stderr, "simfs_inspect: cannot open %s\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+    SIMFS_SUPERBLOCK_TYPE superblock;
+    if (pread(file, &superblock, sizeof(superblock), 0) == sizeof(superblock) && superblock.attr.stripeCount > 1) {
+        fprintf(stderr, "simfs_inspect: %s is one of %d image files of a striped volume, which cannot be mapped\n",
+                argv[optind], superblock.attr.stripeCount);
+        return EXIT_FAILURE;
+    }
+    if ((size_t) st.st_size < sizeof(SIMFS_VOLUME)) {
+        fprintf(stderr, "simfs_inspect: %s is smaller than a volume of %zu bytes\n", argv[optind],
+                sizeof(SIMFS_VOLUME));
+        return EXIT_FAILURE;
+    }
+
+    volume = mmap(NULL, sizeof(SIMFS_VOLUME), PROT_READ, MAP_SHARED, file, 0);
+    close(file);
+    if (volume == MAP_FAILED) {
+        fprintf(stderr, "simfs_inspect: cannot map %s\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+    madvise(volume, sizeof(SIMFS_VOLUME), MADV_SEQUENTIAL | MADV_WILLNEED);
+
+    if (volume->superblock.attr.numberOfBlocks != SIMFS_NUMBER_OF_BLOCKS
+        || volume->superblock.attr.blockSize != SIMFS_BLOCK_SIZE)
+        fprintf(stderr, "simfs_inspect: the superblock describes %d blocks of %d bytes; assuming %d of %d\n",
+                volume->superblock.attr.numberOfBlocks, volume->superblock.attr.blockSize,
+                SIMFS_NUMBER_OF_BLOCKS, SIMFS_BLOCK_SIZE);
+
+    // ranges are multiples of 8 blocks, so that no byte of the bitvector is shared
+    if (numberOfThreads > SIMFS_NUMBER_OF_BLOCKS / 8)
+        numberOfThreads = SIMFS_NUMBER_OF_BLOCKS / 8;
+    int rangeSize = (SIMFS_NUMBER_OF_BLOCKS / 8 + numberOfThreads - 1) / numberOfThreads * 8;
+
+    SIMFS_INSPECT_RANGE_TYPE *ranges = calloc(numberOfThreads, sizeof(SIMFS_INSPECT_RANGE_TYPE));
+    if (ranges == NULL)
+        return EXIT_FAILURE;
+
+    int count = 0;
+    for (int start = 0; start < SIMFS_NUMBER_OF_BLOCKS; start += rangeSize, count++) {
+        ranges[count].start = start;
+        ranges[count].end = (start + rangeSize < SIMFS_NUMBER_OF_BLOCKS ? start + rangeSize : SIMFS_NUMBER_OF_BLOCKS);
+        ranges[count].started = (pthread_create(&ranges[count].thread, NULL, inspectRange, &ranges[count]) == 0);
+        if (!ranges[count].started)
+            inspectRange(&ranges[count]);
+    }
+    for (int r = 0; r < count; r++)
+        if (ranges[r].started)
+            pthread_join(ranges[r].thread, NULL);
+
+    report(ranges, count);
+
+    munmap(volume, sizeof(SIMFS_VOLUME));
+    free(ranges);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,497 @@
+
+#include "simfs_io.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#ifdef SIMFS_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(SIMFS_HAVE_IO_URING) && defined(__NR_io_uring_setup)
+#define SIMFS_IO_URING 1
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//
+// engine state
+//
+//////////////////////////////////////////////////////////////////////////
+
+#ifdef SIMFS_IO_URING
+typedef struct simfs_io_ring_type {
+    int fd;
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sqRing, *cqRing;
+    size_t sqRingSize, cqRingSize, sqesSize;
+    unsigned toSubmit; // queued in the submission ring, but not passed to the kernel yet
+    bool registered; // the buffer given to simfsIoOpen is registered as fixed buffer 0
+} SIMFS_IO_RING_TYPE;
+#endif
+
+struct simfs_io_engine_type {
+    int fd;
+    int queueDepth;
+    int inFlight;
+    char *registeredBuffer;
+    size_t registeredSize;
+
+#ifdef SIMFS_IO_URING
+    bool uring;
+    SIMFS_IO_RING_TYPE ring;
+#endif
+
+    // thread pool
+    pthread_t *threads;
+    int numberOfThreads;
+    pthread_mutex_t lock;
+    pthread_cond_t submitted;
+    pthread_cond_t completed;
+    SIMFS_IO_REQUEST_TYPE *submissionHead, *submissionTail;
+    SIMFS_IO_REQUEST_TYPE *completionHead, *completionTail;
+    bool stopping;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//
+// io_uring engine
+//
+// The rings are set up with the raw system calls, so no library beyond the kernel headers is needed.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#ifdef SIMFS_IO_URING
+
+static bool ringOpen(SIMFS_IO_ENGINE_TYPE *engine)
+{
+    SIMFS_IO_RING_TYPE *ring = &engine->ring;
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    ring->fd = (int) syscall(__NR_io_uring_setup, engine->queueDepth, &params);
+    if (ring->fd < 0)
+        return false;
+
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (ring->cqRingSize > ring->sqRingSize)
+            ring->sqRingSize = ring->cqRingSize;
+        ring->cqRingSize = 0;
+    }
+
+    ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->fd, IORING_OFF_SQ_RING);
+    ring->cqRing = ring->sqRing;
+    if (ring->sqRing != MAP_FAILED && ring->cqRingSize != 0)
+        ring->cqRing = mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->fd, IORING_OFF_CQ_RING);
+    ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+
+    if (ring->sqRing == MAP_FAILED || ring->cqRing == MAP_FAILED || ring->sqes == MAP_FAILED)
+    {
+        if (ring->sqes != MAP_FAILED)
+            munmap(ring->sqes, ring->sqesSize);
+        if (ring->cqRingSize != 0 && ring->cqRing != MAP_FAILED)
+            munmap(ring->cqRing, ring->cqRingSize);
+        if (ring->sqRing != MAP_FAILED)
+            munmap(ring->sqRing, ring->sqRingSize);
+        close(ring->fd);
+        return false;
+    }
+
+    ring->sqHead = (unsigned *) ((char *) ring->sqRing + params.sq_off.head);
+    ring->sqTail = (unsigned *) ((char *) ring->sqRing + params.sq_off.tail);
+    ring->sqMask = (unsigned *) ((char *) ring->sqRing + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned *) ((char *) ring->sqRing + params.sq_off.array);
+    ring->cqHead = (unsigned *) ((char *) ring->cqRing + params.cq_off.head);
+    ring->cqTail = (unsigned *) ((char *) ring->cqRing + params.cq_off.tail);
+    ring->cqMask = (unsigned *) ((char *) ring->cqRing + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) ((char *) ring->cqRing + params.cq_off.cqes);
+    ring->toSubmit = 0;
+
+    // fixed buffers save the kernel from mapping the pages of every request; without them plain vectors are used
+    ring->registered = false;
+    if (engine->registeredBuffer != NULL)
+    {
+        struct iovec buffer = {engine->registeredBuffer, engine->registeredSize};
+        ring->registered = syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, &buffer, 1) == 0;
+    }
+
+    engine->queueDepth = (int) params.sq_entries;
+    return true;
+}
+
+static void ringClose(SIMFS_IO_RING_TYPE *ring)
+{
+    munmap(ring->sqes, ring->sqesSize);
+    if (ring->cqRingSize != 0)
+        munmap(ring->cqRing, ring->cqRingSize);
+    munmap(ring->sqRing, ring->sqRingSize);
+    close(ring->fd);
+}
+
+static void ringSubmit(SIMFS_IO_ENGINE_TYPE *engine, SIMFS_IO_REQUEST_TYPE *request)
+{
+    SIMFS_IO_RING_TYPE *ring = &engine->ring;
+    unsigned tail = *ring->sqTail;
+    unsigned index = tail & *ring->sqMask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->fd = engine->fd;
+    sqe->off = request->offset;
+    sqe->user_data = (unsigned long long) (uintptr_t) request;
+
+    bool fixed = ring->registered
+                 && (char *) request->buffer >= engine->registeredBuffer
+                 && (char *) request->buffer + request->length <= engine->registeredBuffer + engine->registeredSize;
+
+    switch (request->operation)
+    {
+        case SIMFS_IO_FSYNC:
+            sqe->opcode = IORING_OP_FSYNC;
+            break;
+        case SIMFS_IO_READ:
+        case SIMFS_IO_WRITE:
+            if (fixed)
+            {
+                sqe->opcode = (request->operation == SIMFS_IO_READ ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED);
+                sqe->addr = (unsigned long long) (uintptr_t) request->buffer;
+                sqe->len = request->length;
+                sqe->buf_index = 0;
+            }
+            else
+            {
+                request->vector.iov_base = request->buffer;
+                request->vector.iov_len = request->length;
+                sqe->opcode = (request->operation == SIMFS_IO_READ ? IORING_OP_READV : IORING_OP_WRITEV);
+                sqe->addr = (unsigned long long) (uintptr_t) &request->vector;
+                sqe->len = 1;
+            }
+            break;
+    }
+
+    ring->sqArray[index] = index;
+    __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+    ring->toSubmit++;
+}
+
+static int ringWait(SIMFS_IO_ENGINE_TYPE *engine, SIMFS_IO_REQUEST_TYPE **completed, int minimum, int maximum)
+{
+    SIMFS_IO_RING_TYPE *ring = &engine->ring;
+    int count = 0;
+
+    while (true)
+    {
+        unsigned head = *ring->cqHead;
+        unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+        while (head != tail && count < maximum)
+        {
+            struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cqMask];
+            SIMFS_IO_REQUEST_TYPE *request = (SIMFS_IO_REQUEST_TYPE *) (uintptr_t) cqe->user_data;
+            request->result = cqe->res;
+            completed[count++] = request;
+            head++;
+        }
+        __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+
+        if (count >= minimum && ring->toSubmit == 0)
+            return count;
+
+        unsigned flags = (count < minimum ? IORING_ENTER_GETEVENTS : 0);
+        int submitted = (int) syscall(__NR_io_uring_enter, ring->fd, ring->toSubmit,
+                                      (count < minimum ? minimum - count : 0), flags, NULL, 0);
+        if (submitted < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        ring->toSubmit -= submitted;
+    }
+}
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//
+// thread pool engine
+//
+//////////////////////////////////////////////////////////////////////////
+
+static void execute(int fd, SIMFS_IO_REQUEST_TYPE *request)
+{
+    size_t done = 0;
+
+    if (request->operation == SIMFS_IO_FSYNC)
+    {
+        request->result = (fsync(fd) == 0 ? 0 : -errno);
+        return;
+    }
+
+    while (done < request->length)
+    {
+        ssize_t transferred;
+        if (request->operation == SIMFS_IO_READ)
+            transferred = pread(fd, (char *) request->buffer + done, request->length - done, request->offset + done);
+        else
+            transferred = pwrite(fd, (char *) request->buffer + done, request->length - done, request->offset + done);
+
+        if (transferred < 0 && errno == EINTR)
+            continue;
+        if (transferred < 0)
+        {
+            request->result = -errno;
+            return;
+        }
+        if (transferred == 0)
+            break; // end of file
+        done += transferred;
+    }
+    request->result = done;
+}
+
+static void *worker(void *argument)
+{
+    SIMFS_IO_ENGINE_TYPE *engine = argument;
+
+    pthread_mutex_lock(&engine->lock);
+    while (true)
+    {
+        while (engine->submissionHead == NULL && !engine->stopping)
+            pthread_cond_wait(&engine->submitted, &engine->lock);
+        if (engine->submissionHead == NULL)
+            break;
+
+        SIMFS_IO_REQUEST_TYPE *request = engine->submissionHead;
+        engine->submissionHead = request->next;
+        if (engine->submissionHead == NULL)
+            engine->submissionTail = NULL;
+        pthread_mutex_unlock(&engine->lock);
+
+        execute(engine->fd, request);
+
+        pthread_mutex_lock(&engine->lock);
+        request->next = NULL;
+        if (engine->completionTail == NULL)
+            engine->completionHead = request;
+        else
+            engine->completionTail->next = request;
+        engine->completionTail = request;
+        pthread_cond_signal(&engine->completed);
+    }
+    pthread_mutex_unlock(&engine->lock);
+
+    return NULL;
+}
+
+static bool poolOpen(SIMFS_IO_ENGINE_TYPE *engine)
+{
+    engine->submissionHead = engine->submissionTail = NULL;
+    engine->completionHead = engine->completionTail = NULL;
+    engine->stopping = false;
+    pthread_mutex_init(&engine->lock, NULL);
+    pthread_cond_init(&engine->submitted, NULL);
+    pthread_cond_init(&engine->completed, NULL);
+
+    engine->numberOfThreads = (engine->queueDepth < SIMFS_IO_DEFAULT_THREADS ? engine->queueDepth
+                                                                             : SIMFS_IO_DEFAULT_THREADS);
+    engine->threads = malloc(engine->numberOfThreads * sizeof(pthread_t));
+    if (engine->threads == NULL)
+        return false;
+
+    for (int i = 0; i < engine->numberOfThreads; i++)
+    {
+        if (pthread_create(&engine->threads[i], NULL, worker, engine) != 0)
+        {
+            engine->numberOfThreads = i;
+            return i > 0;
+        }
+    }
+    return true;
+}
+
+static void poolClose(SIMFS_IO_ENGINE_TYPE *engine)
+{
+    pthread_mutex_lock(&engine->lock);
+    engine->stopping = true;
+    pthread_cond_broadcast(&engine->submitted);
+    pthread_mutex_unlock(&engine->lock);
+
+    for (int i = 0; i < engine->numberOfThreads; i++)
+        pthread_join(engine->threads[i], NULL);
+    free(engine->threads);
+
+    pthread_cond_destroy(&engine->completed);
+    pthread_cond_destroy(&engine->submitted);
+    pthread_mutex_destroy(&engine->lock);
+}
+
+static void poolSubmit(SIMFS_IO_ENGINE_TYPE *engine, SIMFS_IO_REQUEST_TYPE *request)
+{
+    request->next = NULL;
+
+    pthread_mutex_lock(&engine->lock);
+    if (engine->submissionTail == NULL)
+        engine->submissionHead = request;
+    else
+        engine->submissionTail->next = request;
+    engine->submissionTail = request;
+    pthread_cond_signal(&engine->submitted);
+    pthread_mutex_unlock(&engine->lock);
+}
+
+static int poolWait(SIMFS_IO_ENGINE_TYPE *engine, SIMFS_IO_REQUEST_TYPE **completed, int minimum, int maximum)
+{
+    int count = 0;
+
+    pthread_mutex_lock(&engine->lock);
+    while (count < maximum)
+    {
+        if (engine->completionHead == NULL)
+        {
+            if (count >= minimum)
+                break;
+            pthread_cond_wait(&engine->completed, &engine->lock);
+            continue;
+        }
+
+        SIMFS_IO_REQUEST_TYPE *request = engine->completionHead;
+        engine->completionHead = request->next;
+        if (engine->completionHead == NULL)
+            engine->completionTail = NULL;
+        completed[count++] = request;
+    }
+    pthread_mutex_unlock(&engine->lock);
+
+    return count;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//
+// engine interface
+//
+//////////////////////////////////////////////////////////////////////////
+
+/***
+ * Creates an engine for the open file fd that accepts up to queueDepth requests in flight.
+ *
+ * The memory given by registeredBuffer and registeredSize (e.g., the whole in-memory volume) is registered with
+ * the kernel when io_uring is used, and requests with buffers inside of it avoid the per-request page mapping.
+ * The buffer is optional.
+ *
+ * Returns NULL if neither io_uring nor the thread pool could be set up.
+ */
+SIMFS_IO_ENGINE_TYPE *simfsIoOpen(int fd, int queueDepth, void *registeredBuffer, size_t registeredSize)
+{
+    SIMFS_IO_ENGINE_TYPE *engine = calloc(1, sizeof(SIMFS_IO_ENGINE_TYPE));
+    if (engine == NULL)
+        return NULL;
+
+    engine->fd = fd;
+    engine->queueDepth = (queueDepth > 0 ? queueDepth : SIMFS_IO_DEFAULT_QUEUE_DEPTH);
+    engine->registeredBuffer = registeredBuffer;
+    engine->registeredSize = (registeredBuffer != NULL ? registeredSize : 0);
+
+#ifdef SIMFS_IO_URING
+    engine->uring = ringOpen(engine);
+    if (engine->uring)
+        return engine;
+#endif
+
+    if (!poolOpen(engine))
+    {
+        simfsIoClose(engine);
+        return NULL;
+    }
+    return engine;
+}
+
+/***
+ * Queues a request. Requests may be passed to the kernel only when simfsIoWait is called next, so callers queue
+ * everything they want in flight and then wait.
+ *
+ * Returns SIMFS_ALLOC_ERROR if the engine already has queueDepth requests in flight.
+ */
+SIMFS_ERROR simfsIoSubmit(SIMFS_IO_ENGINE_TYPE *engine, SIMFS_IO_REQUEST_TYPE *request)
+{
+    if (engine->inFlight >= engine->queueDepth)
+        return SIMFS_ALLOC_ERROR;
+
+    engine->inFlight++;
+#ifdef SIMFS_IO_URING
+    if (engine->uring)
+    {
+        ringSubmit(engine, request);
+        return SIMFS_NO_ERROR;
+    }
+#endif
+    poolSubmit(engine, request);
+    return SIMFS_NO_ERROR;
+}
+
+/***
+ * Waits until at least minimum requests have completed and returns up to maximum of them through the array
+ * completed. Returns the number of requests returned, or -1 on a failure of the engine.
+ */
+int simfsIoWait(SIMFS_IO_ENGINE_TYPE *engine, SIMFS_IO_REQUEST_TYPE **completed, int minimum, int maximum)
+{
+    if (minimum > engine->inFlight)
+        minimum = engine->inFlight;
+
+    int count;
+#ifdef SIMFS_IO_URING
+    if (engine->uring)
+        count = ringWait(engine, completed, minimum, maximum);
+    else
+#endif
+        count = poolWait(engine, completed, minimum, maximum);
+
+    if (count > 0)
+        engine->inFlight -= count;
+    return count;
+}
+
+int simfsIoInFlight(SIMFS_IO_ENGINE_TYPE *engine)
+{
+    return engine->inFlight;
+}
+
+const char *simfsIoEngineName(SIMFS_IO_ENGINE_TYPE *engine)
+{
+#ifdef SIMFS_IO_URING
+    if (engine->uring)
+        return engine->ring.registered ? "io_uring (registered buffer)" : "io_uring";
+#endif
+    return "thread pool";
+}
+
+/***
+ * Destroys the engine; all requests have to be completed and collected before.
+ */
+void simfsIoClose(SIMFS_IO_ENGINE_TYPE *engine)
+{
+    if (engine == NULL)
+        return;
+
+#ifdef SIMFS_IO_URING
+    if (engine->uring)
+        ringClose(&engine->ring);
+    else
+#endif
+    if (engine->threads != NULL)
+        poolClose(engine);
+
+    free(engine);
+}
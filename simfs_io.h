@@ -0,0 +1,67 @@
+#ifndef __SIMFS_IO_H_
+#define __SIMFS_IO_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include "simfs.h"
+
+//////////////////////////////////////////////////////////////////////////
+//
+// asynchronous I/O engine for the volume file
+//
+// Requests are queued with simfsIoSubmit and their completions are collected with simfsIoWait, so a caller can
+// keep many reads or writes in flight from one thread. The engine uses io_uring where the kernel supports it,
+// with the memory passed to simfsIoOpen registered as a fixed buffer; otherwise a pool of threads executes the
+// requests with pread, pwrite and fsync.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#define SIMFS_IO_DEFAULT_QUEUE_DEPTH 32
+#define SIMFS_IO_DEFAULT_THREADS 4
+#define SIMFS_IO_CHUNK_SIZE (64 * 1024) // bytes per request when the whole volume is transferred
+
+// image file of a block, and its position in that file, for a volume striped across stripeCount files
+#define SIMFS_IO_BLOCK_STRIPE(blockIndex, stripeCount, stripeBlocks) ((blockIndex) / (stripeBlocks) % (stripeCount))
+#define SIMFS_IO_BLOCK_OFFSET(blockIndex, stripeCount, stripeBlocks) \
+    ((off_t) offsetof(SIMFS_VOLUME, block) \
+     + ((off_t) (blockIndex) / (stripeBlocks) / (stripeCount) * (stripeBlocks) + (blockIndex) % (stripeBlocks)) \
+       * (off_t) sizeof(SIMFS_BLOCK_TYPE))
+
+typedef enum {
+    SIMFS_IO_READ,
+    SIMFS_IO_WRITE,
+    SIMFS_IO_FSYNC
+} SIMFS_IO_OPERATION_TYPE;
+
+//
+// a single request; the caller owns the memory until the request is returned by simfsIoWait
+//
+// result is the number of bytes transferred (0 for fsync) or a negative errno value
+//
+typedef struct simfs_io_request_type {
+    SIMFS_IO_OPERATION_TYPE operation;
+    void *buffer;
+    size_t length;
+    off_t offset;
+    ssize_t result;
+    void *userData; // for the caller
+    struct iovec vector; // used by the engine
+    struct simfs_io_request_type *next; // used by the engine
+} SIMFS_IO_REQUEST_TYPE;
+
+typedef struct simfs_io_engine_type SIMFS_IO_ENGINE_TYPE;
+
+SIMFS_IO_ENGINE_TYPE *simfsIoOpen(int fd, int queueDepth, void *registeredBuffer, size_t registeredSize);
+
+SIMFS_ERROR simfsIoSubmit(SIMFS_IO_ENGINE_TYPE *engine, SIMFS_IO_REQUEST_TYPE *request);
+
+int simfsIoWait(SIMFS_IO_ENGINE_TYPE *engine, SIMFS_IO_REQUEST_TYPE **completed, int minimum, int maximum);
+
+int simfsIoInFlight(SIMFS_IO_ENGINE_TYPE *engine);
+
+const char *simfsIoEngineName(SIMFS_IO_ENGINE_TYPE *engine);
+
+void simfsIoClose(SIMFS_IO_ENGINE_TYPE *engine);
+
+#endif
@@ -0,0 +1,188 @@
+#include "simfs_lz4.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SIMFS_LZ4_MIN_MATCH 4
+#define SIMFS_LZ4_LAST_LITERALS 5 // the last bytes of a block are always literals
+#define SIMFS_LZ4_MATCH_FIND_LIMIT 12 // no match starts this close to the end of a block
+#define SIMFS_LZ4_MAX_OFFSET 65535
+#define SIMFS_LZ4_HASH_LOG 12
+#define SIMFS_LZ4_SKIP_STRENGTH 6 // the step grows by one for every 2^6 bytes without a match
+
+static uint32_t read32(const unsigned char *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t hashSequence(uint32_t sequence)
+{
+    return (sequence * 2654435761U) >> (32 - SIMFS_LZ4_HASH_LOG);
+}
+
+/***
+ * Writes the part of a length that did not fit into its four bits of the token.
+ */
+static unsigned char *writeLength(unsigned char *out, size_t length)
+{
+    for (; length >= 255; length -= 255)
+        *out++ = 255;
+    *out++ = (unsigned char) length;
+    return out;
+}
+
+/***
+ * Appends a sequence of literals followed by a match, or only the literals if matchLength is 0; returns the new
+ * end of the output, or NULL if the sequence does not fit.
+ */
+static unsigned char *writeSequence(unsigned char *out, unsigned char *outEnd, const unsigned char *literals,
+                                    size_t literalLength, size_t offset, size_t matchLength)
+{
+    size_t needed = 1 + literalLength + literalLength / 255 + 1
+                    + (matchLength > 0 ? 2 + (matchLength - SIMFS_LZ4_MIN_MATCH) / 255 + 1 : 0);
+    if (needed > (size_t) (outEnd - out))
+        return NULL;
+
+    unsigned char *token = out++;
+    *token = (unsigned char) ((literalLength < 15 ? literalLength : 15) << 4);
+    if (literalLength >= 15)
+        out = writeLength(out, literalLength - 15);
+    memcpy(out, literals, literalLength);
+    out += literalLength;
+
+    if (matchLength > 0) {
+        *out++ = (unsigned char) offset;
+        *out++ = (unsigned char) (offset >> 8);
+        matchLength -= SIMFS_LZ4_MIN_MATCH;
+        *token |= (unsigned char) (matchLength < 15 ? matchLength : 15);
+        if (matchLength >= 15)
+            out = writeLength(out, matchLength - 15);
+    }
+    return out;
+}
+
+/***
+ * Compresses sourceSize bytes into at most capacity bytes. Returns the size of the compressed block, or 0 if it
+ * would not fit; in that case the compression stops as soon as the output is full.
+ */
+int simfsLz4Compress(const char *source, int sourceSize, char *destination, int capacity)
+{
+    const unsigned char *in = (const unsigned char *) source;
+    const unsigned char *end = in + sourceSize;
+    const unsigned char *anchor = in; // start of the literals not written yet
+    unsigned char *out = (unsigned char *) destination;
+    unsigned char *outEnd = out + capacity;
+    uint32_t positions[1 << SIMFS_LZ4_HASH_LOG] = {0};
+
+    if (sourceSize > SIMFS_LZ4_MATCH_FIND_LIMIT) {
+        const unsigned char *matchFindLimit = end - SIMFS_LZ4_MATCH_FIND_LIMIT;
+        const unsigned char *matchLimit = end - SIMFS_LZ4_LAST_LITERALS;
+        const unsigned char *ip = in + 1;
+
+        while (ip < matchFindLimit) {
+            uint32_t sequence = read32(ip);
+            uint32_t hash = hashSequence(sequence);
+            const unsigned char *match = in + positions[hash];
+            positions[hash] = (uint32_t) (ip - in);
+
+            if (match >= ip || ip - match > SIMFS_LZ4_MAX_OFFSET || read32(match) != sequence) {
+                ip += 1 + ((ip - anchor) >> SIMFS_LZ4_SKIP_STRENGTH);
+                continue;
+            }
+
+            while (ip > anchor && match > in && ip[-1] == match[-1]) {
+                ip--;
+                match--;
+            }
+
+            const unsigned char *matchEnd = ip + SIMFS_LZ4_MIN_MATCH;
+            const unsigned char *reference = match + SIMFS_LZ4_MIN_MATCH;
+            while (matchEnd < matchLimit && *matchEnd == *reference) {
+                matchEnd++;
+                reference++;
+            }
+
+            out = writeSequence(out, outEnd, anchor, ip - anchor, ip - match, matchEnd - ip);
+            if (out == NULL)
+                return 0;
+
+            ip = anchor = matchEnd;
+            if (ip < matchFindLimit)
+                positions[hashSequence(read32(ip - 2))] = (uint32_t) (ip - 2 - in);
+        }
+    }
+
+    out = writeSequence(out, outEnd, anchor, end - anchor, 0, 0);
+    return (out == NULL ? 0 : (int) (out - (unsigned char *) destination));
+}
+
+/***
+ * Reads the part of a length that did not fit into its four bits of the token; returns false if the input ends
+ * before the length does.
+ */
+static bool readLength(const unsigned char **in, const unsigned char *inEnd, size_t *length)
+{
+    unsigned char byte;
+    do {
+        if (*in >= inEnd)
+            return false;
+        byte = *(*in)++;
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+/***
+ * Decompresses a block of sourceSize bytes into at most capacity bytes. Returns the size of the content, or -1 if
+ * the block is malformed or the content does not fit.
+ */
+int simfsLz4Decompress(const char *source, int sourceSize, char *destination, int capacity)
+{
+    const unsigned char *in = (const unsigned char *) source;
+    const unsigned char *inEnd = in + sourceSize;
+    unsigned char *out = (unsigned char *) destination;
+    unsigned char *outEnd = out + capacity;
+
+    while (in < inEnd) {
+        unsigned char token = *in++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(&in, inEnd, &literalLength))
+            return -1;
+        if (literalLength > (size_t) (inEnd - in) || literalLength > (size_t) (outEnd - out))
+            return -1;
+        memcpy(out, in, literalLength);
+        in += literalLength;
+        out += literalLength;
+
+        if (in == inEnd)
+            break; // the last sequence has no match
+
+        if (inEnd - in < 2)
+            return -1;
+        size_t offset = in[0] | (size_t) in[1] << 8;
+        in += 2;
+        if (offset == 0 || offset > (size_t) (out - (unsigned char *) destination))
+            return -1;
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(&in, inEnd, &matchLength))
+            return -1;
+        matchLength += SIMFS_LZ4_MIN_MATCH;
+        if (matchLength > (size_t) (outEnd - out))
+            return -1;
+
+        const unsigned char *match = out - offset;
+        if (offset >= matchLength) {
+            memcpy(out, match, matchLength);
+            out += matchLength;
+        } else {
+            while (matchLength-- > 0)
+                *out++ = *match++; // the match overlaps the bytes it produces
+        }
+    }
+
+    return (int) (out - (unsigned char *) destination);
+}
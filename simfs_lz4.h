@@ -0,0 +1,20 @@
+#ifndef __SIMFS_LZ4_H_
+#define __SIMFS_LZ4_H_
+
+//////////////////////////////////////////////////////////////////////////
+//
+// LZ4 block compression of file content
+//
+// The blocks are in the format of the reference implementation: sequences of a token, literals, a two-byte offset
+// and a match length, the last sequence holding only literals. The compressor finds matches through a hash table of
+// the positions of four-byte sequences and moves through the input in growing steps while it finds none, so input
+// that does not compress is given up on quickly. The decompressor checks every length and offset against its input
+// and output, since the compressed content comes from an image file.
+//
+//////////////////////////////////////////////////////////////////////////
+
+int simfsLz4Compress(const char *source, int sourceSize, char *destination, int capacity);
+
+int simfsLz4Decompress(const char *source, int sourceSize, char *destination, int capacity);
+
+#endif
@@ -0,0 +1,373 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "simfs.h"
+
+//////////////////////////////////////////////////////////////////////////
+//
+// replays a captured operation trace against a volume and reports latency percentiles per operation
+//
+// usage: simfs_replay [-i <volume file>] [-t <threads>] <trace file or ->
+//
+// The trace holds one operation per line; empty lines and lines starting with '#' are skipped:
+//
+//   create <name> [file|folder]
+//   open <name>
+//   write <name> <size>
+//   read <name>
+//   close <name>
+//   delete <name>
+//
+// The operations are partitioned among the threads by the hash of the name, so the operations on one file keep
+// their order while operations on different files run concurrently. The simfs functions are not reentrant, so
+// the calls themselves are serialized; the latency includes the time spent waiting for the file system, which is
+// what a client would see.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#define SIMFS_REPLAY_DEFAULT_IMAGE "simfsFile.dta"
+#define SIMFS_REPLAY_MAX_THREADS 64
+#define SIMFS_REPLAY_MAX_WRITE_SIZE (64 * 1024)
+
+typedef enum {
+    SIMFS_REPLAY_CREATE,
+    SIMFS_REPLAY_OPEN,
+    SIMFS_REPLAY_WRITE,
+    SIMFS_REPLAY_READ,
+    SIMFS_REPLAY_CLOSE,
+    SIMFS_REPLAY_DELETE,
+    SIMFS_REPLAY_NUMBER_OF_OPERATIONS
+} SIMFS_REPLAY_OPERATION_TYPE;
+
+static char *operationNames[SIMFS_REPLAY_NUMBER_OF_OPERATIONS] = {
+    "create", "open", "write", "read", "close", "delete"
+};
+
+typedef struct simfs_replay_entry_type {
+    SIMFS_REPLAY_OPERATION_TYPE operation;
+    SIMFS_NAME_TYPE name;
+    size_t size; // bytes for write
+    SIMFS_CONTENT_TYPE type; // for create
+} SIMFS_REPLAY_ENTRY_TYPE;
+
+//
+// latencies of one operation type in nanoseconds; each thread collects its own and they are merged at the end
+//
+typedef struct simfs_replay_samples_type {
+    unsigned long long *latency;
+    size_t count;
+    size_t capacity;
+    size_t errors;
+} SIMFS_REPLAY_SAMPLES_TYPE;
+
+typedef struct simfs_replay_thread_type {
+    pthread_t thread;
+    int number;
+    char *payload; // generated once; a write of n bytes is terminated at n for the duration of the call
+    struct {
+        SIMFS_NAME_TYPE name;
+        SIMFS_FILE_HANDLE_TYPE fileHandle;
+    } openFiles[SIMFS_MAX_NUMBER_OF_OPEN_FILES];
+    SIMFS_REPLAY_SAMPLES_TYPE samples[SIMFS_REPLAY_NUMBER_OF_OPERATIONS];
+} SIMFS_REPLAY_THREAD_TYPE;
+
+static SIMFS_REPLAY_ENTRY_TYPE *trace;
+static size_t traceLength;
+static int numberOfThreads = 1;
+static pthread_mutex_t simfsLock = PTHREAD_MUTEX_INITIALIZER;
+
+//////////////////////////////////////////////////////////////////////////
+
+static unsigned long long now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000000000ULL + time.tv_nsec;
+}
+
+/***
+ * Reads the whole trace into memory, so that parsing is not part of the measurement.
+ */
+static int readTrace(FILE *file)
+{
+    size_t capacity = 1024;
+    trace = malloc(capacity * sizeof(SIMFS_REPLAY_ENTRY_TYPE));
+    if (trace == NULL)
+        return -1;
+
+    char line[256];
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        lineNumber++;
+
+        char operation[16], name[SIMFS_MAX_NAME_LENGTH], argument[32] = "";
+        int fields = sscanf(line, "%15s %63s %31s", operation, name, argument);
+        if (fields <= 0 || operation[0] == '#')
+            continue;
+
+        if (traceLength == capacity) {
+            capacity *= 2;
+            SIMFS_REPLAY_ENTRY_TYPE *larger = realloc(trace, capacity * sizeof(SIMFS_REPLAY_ENTRY_TYPE));
+            if (larger == NULL)
+                return -1;
+            trace = larger;
+        }
+
+        SIMFS_REPLAY_ENTRY_TYPE *entry = &trace[traceLength];
+        int i = 0;
+        while (i < SIMFS_REPLAY_NUMBER_OF_OPERATIONS && strcmp(operation, operationNames[i]) != 0)
+            i++;
+        if (i == SIMFS_REPLAY_NUMBER_OF_OPERATIONS || fields < 2) {
+            fprintf(stderr, "simfs_replay: line %d: cannot parse \"%s\"\n", lineNumber, operation);
+            return -1;
+        }
+
+        entry->operation = i;
+        strcpy(entry->name, name);
+        entry->type = (strcmp(argument, "folder") == 0 ? SIMFS_FOLDER_CONTENT_TYPE : SIMFS_FILE_CONTENT_TYPE);
+        entry->size = (entry->operation == SIMFS_REPLAY_WRITE ? strtoul(argument, NULL, 10) : 0);
+        if (entry->size > SIMFS_REPLAY_MAX_WRITE_SIZE)
+            entry->size = SIMFS_REPLAY_MAX_WRITE_SIZE;
+
+        traceLength++;
+    }
+
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+/***
+ * Finds the handle of a file opened by this thread; with insert set, a free entry is taken if there is none.
+ */
+static SIMFS_FILE_HANDLE_TYPE *findOpenFile(SIMFS_REPLAY_THREAD_TYPE *self, char *name, bool insert)
+{
+    int empty = -1;
+    for (int i = 0; i < SIMFS_MAX_NUMBER_OF_OPEN_FILES; i++) {
+        if (self->openFiles[i].name[0] == '\0') {
+            if (empty == -1)
+                empty = i;
+        } else if (strcmp(self->openFiles[i].name, name) == 0) {
+            return &self->openFiles[i].fileHandle;
+        }
+    }
+
+    if (!insert || empty == -1)
+        return NULL;
+
+    strcpy(self->openFiles[empty].name, name);
+    return &self->openFiles[empty].fileHandle;
+}
+
+static void forgetOpenFile(SIMFS_REPLAY_THREAD_TYPE *self, char *name)
+{
+    for (int i = 0; i < SIMFS_MAX_NUMBER_OF_OPEN_FILES; i++)
+        if (strcmp(self->openFiles[i].name, name) == 0)
+            self->openFiles[i].name[0] = '\0';
+}
+
+static SIMFS_ERROR execute(SIMFS_REPLAY_THREAD_TYPE *self, SIMFS_REPLAY_ENTRY_TYPE *entry)
+{
+    SIMFS_FILE_HANDLE_TYPE *fileHandle;
+    SIMFS_ERROR error;
+
+    switch (entry->operation) {
+        case SIMFS_REPLAY_CREATE:
+            return simfsCreateFile(entry->name, entry->type);
+
+        case SIMFS_REPLAY_DELETE:
+            return simfsDeleteFile(entry->name);
+
+        case SIMFS_REPLAY_OPEN:
+            fileHandle = findOpenFile(self, entry->name, true);
+            if (fileHandle == NULL)
+                return SIMFS_ALLOC_ERROR;
+            error = simfsOpenFile(entry->name, fileHandle);
+            if (error != SIMFS_NO_ERROR && error != SIMFS_DUPLICATE_ERROR)
+                forgetOpenFile(self, entry->name);
+            return error;
+
+        case SIMFS_REPLAY_CLOSE:
+            fileHandle = findOpenFile(self, entry->name, false);
+            if (fileHandle == NULL)
+                return SIMFS_NOT_FOUND_ERROR;
+            forgetOpenFile(self, entry->name);
+            return simfsCloseFile(*fileHandle);
+
+        case SIMFS_REPLAY_WRITE: {
+            fileHandle = findOpenFile(self, entry->name, false);
+            if (fileHandle == NULL)
+                return SIMFS_NOT_FOUND_ERROR;
+            char saved = self->payload[entry->size];
+            self->payload[entry->size] = '\0';
+            error = simfsWriteFile(*fileHandle, self->payload);
+            self->payload[entry->size] = saved;
+            return error;
+        }
+
+        case SIMFS_REPLAY_READ: {
+            fileHandle = findOpenFile(self, entry->name, false);
+            if (fileHandle == NULL)
+                return SIMFS_NOT_FOUND_ERROR;
+            // the content is only looked at, so the zero-copy read keeps the allocator out of the measurement
+            struct iovec vector[64];
+            size_t offset = 0;
+            int count;
+            do {
+                count = sizeof(vector) / sizeof(vector[0]);
+                error = simfsReadFileVector(*fileHandle, offset, SIZE_MAX - offset, vector, &count);
+                if (error != SIMFS_NO_ERROR)
+                    return error;
+                for (int i = 0; i < count; i++)
+                    offset += vector[i].iov_len;
+                simfsReleaseFileVector(*fileHandle);
+            } while (count == sizeof(vector) / sizeof(vector[0]));
+            return SIMFS_NO_ERROR;
+        }
+
+        default:
+            return SIMFS_SYSTEM_ERROR;
+    }
+}
+
+static void addSample(SIMFS_REPLAY_SAMPLES_TYPE *samples, unsigned long long latency)
+{
+    if (samples->count == samples->capacity) {
+        size_t capacity = (samples->capacity == 0 ? 1024 : samples->capacity * 2);
+        unsigned long long *larger = realloc(samples->latency, capacity * sizeof(unsigned long long));
+        if (larger == NULL)
+            return;
+        samples->latency = larger;
+        samples->capacity = capacity;
+    }
+    samples->latency[samples->count++] = latency;
+}
+
+static void *replay(void *argument)
+{
+    SIMFS_REPLAY_THREAD_TYPE *self = argument;
+
+    for (size_t i = 0; i < traceLength; i++) {
+        SIMFS_REPLAY_ENTRY_TYPE *entry = &trace[i];
+        if ((int) (hash((unsigned char *) entry->name) % numberOfThreads) != self->number)
+            continue;
+
+        unsigned long long start = now();
+        pthread_mutex_lock(&simfsLock);
+        SIMFS_ERROR error = execute(self, entry);
+        pthread_mutex_unlock(&simfsLock);
+        unsigned long long latency = now() - start;
+
+        addSample(&self->samples[entry->operation], latency);
+        if (error != SIMFS_NO_ERROR)
+            self->samples[entry->operation].errors++;
+    }
+
+    return NULL;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+static int compareLatency(const void *a, const void *b)
+{
+    unsigned long long x = *(const unsigned long long *) a, y = *(const unsigned long long *) b;
+    return (x > y) - (x < y);
+}
+
+static unsigned long long percentile(SIMFS_REPLAY_SAMPLES_TYPE *samples, double fraction)
+{
+    size_t rank = (size_t) (fraction * samples->count);
+    return samples->latency[rank < samples->count ? rank : samples->count - 1];
+}
+
+static void report(SIMFS_REPLAY_THREAD_TYPE *threads, unsigned long long elapsed)
+{
+    printf("\n%-8s %10s %8s %12s %12s %12s %12s\n", "op", "count", "errors", "p50 ns", "p99 ns", "p999 ns", "max ns");
+
+    for (int op = 0; op < SIMFS_REPLAY_NUMBER_OF_OPERATIONS; op++) {
+        SIMFS_REPLAY_SAMPLES_TYPE merged = {NULL, 0, 0, 0};
+        for (int t = 0; t < numberOfThreads; t++) {
+            SIMFS_REPLAY_SAMPLES_TYPE *samples = &threads[t].samples[op];
+            for (size_t i = 0; i < samples->count; i++)
+                addSample(&merged, samples->latency[i]);
+            merged.errors += samples->errors;
+        }
+        if (merged.count == 0)
+            continue;
+
+        qsort(merged.latency, merged.count, sizeof(unsigned long long), compareLatency);
+        printf("%-8s %10zu %8zu %12llu %12llu %12llu %12llu\n", operationNames[op], merged.count, merged.errors,
+               percentile(&merged, 0.5), percentile(&merged, 0.99), percentile(&merged, 0.999),
+               merged.latency[merged.count - 1]);
+        free(merged.latency);
+    }
+
+    printf("\n%zu operations with %d threads in %.3f s\n", traceLength, numberOfThreads, elapsed / 1e9);
+}
+
+int main(int argc, char *argv[])
+{
+    char *image = SIMFS_REPLAY_DEFAULT_IMAGE;
+    int option;
+    while ((option = getopt(argc, argv, "i:t:")) != -1) {
+        switch (option) {
+            case 'i':
+                image = optarg;
+                break;
+            case 't':
+                numberOfThreads = atoi(optarg);
+                break;
+            default:
+                optind = argc + 1;
+        }
+    }
+    if (optind != argc - 1 || numberOfThreads < 1 || numberOfThreads > SIMFS_REPLAY_MAX_THREADS) {
+        fprintf(stderr, "usage: simfs_replay [-i <volume file>] [-t <threads>] <trace file or ->\n");
+        return EXIT_FAILURE;
+    }
+
+    FILE *file = (strcmp(argv[optind], "-") == 0 ? stdin : fopen(argv[optind], "r"));
+    if (file == NULL || readTrace(file) != 0) {
+        fprintf(stderr, "simfs_replay: cannot read the trace %s\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+    if (file != stdin)
+        fclose(file);
+
+    // a volume that does not exist yet is created
+    if (access(image, F_OK) != 0 && simfsCreateFileSystem(image) != SIMFS_NO_ERROR) {
+        fprintf(stderr, "simfs_replay: cannot create %s\n", image);
+        return EXIT_FAILURE;
+    }
+    if (simfsMountFileSystem(image) != SIMFS_NO_ERROR) {
+        fprintf(stderr, "simfs_replay: cannot mount %s\n", image);
+        return EXIT_FAILURE;
+    }
+
+    SIMFS_REPLAY_THREAD_TYPE *threads = calloc(numberOfThreads, sizeof(SIMFS_REPLAY_THREAD_TYPE));
+    if (threads == NULL)
+        return EXIT_FAILURE;
+
+    unsigned long long start = now();
+    for (int t = 0; t < numberOfThreads; t++) {
+        threads[t].number = t;
+        threads[t].payload = simfsGenerateContent(SIMFS_REPLAY_MAX_WRITE_SIZE + 1);
+        pthread_create(&threads[t].thread, NULL, replay, &threads[t]);
+    }
+    for (int t = 0; t < numberOfThreads; t++)
+        pthread_join(threads[t].thread, NULL);
+    unsigned long long elapsed = now() - start;
+
+    // files the trace left open
+    for (int t = 0; t < numberOfThreads; t++)
+        for (int i = 0; i < SIMFS_MAX_NUMBER_OF_OPEN_FILES; i++)
+            if (threads[t].openFiles[i].name[0] != '\0')
+                simfsCloseFile(threads[t].openFiles[i].fileHandle);
+
+    report(threads, elapsed);
+
+    if (simfsUmountFileSystem(image) != SIMFS_NO_ERROR)
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
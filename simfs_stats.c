@@ -0,0 +1,240 @@
+#include <pthread.h>
+#include "simfs_stats.h"
+
+//
+// counters of one thread working on the default instance, or of another instance
+//
+struct simfs_stats_counters_type {
+    SIMFS_OPERATION_STATS_TYPE operation[SIMFS_STATS_NUMBER_OF_OPERATIONS];
+    unsigned long long blocksAllocated;
+    unsigned long long blocksFreed;
+    unsigned long long dentryHits;
+    unsigned long long dentryMisses;
+    unsigned long long blocksDeduplicated;
+    struct simfs_stats_counters_type *next;
+};
+
+static _Thread_local SIMFS_STATS_COUNTERS_TYPE *threadCounters;
+
+// the counters of the instance the calling thread works on, if it is not the default instance
+static _Thread_local SIMFS_STATS_COUNTERS_TYPE *instanceCounters;
+
+// the counters of threads that have ended stay in the list, so that their counts are not lost
+static SIMFS_STATS_COUNTERS_TYPE *allCounters;
+static pthread_mutex_t allCountersLock = PTHREAD_MUTEX_INITIALIZER;
+
+static char *operationNames[SIMFS_STATS_NUMBER_OF_OPERATIONS] = {
+    "mount", "umount", "createFile", "deleteFile", "getFileInfo",
+    "openFile", "writeFile", "readFile", "readFileVector", "closeFile", "readDir", "resolvePath"
+};
+
+static char *errorNames[SIMFS_STATS_NUMBER_OF_ERRORS] = {
+    "NO_ERROR", "ALLOC_ERROR", "DUPLICATE_ERROR", "NOT_FOUND_ERROR", "NOT_EMPTY_ERROR",
+    "ACCESS_ERROR", "WRITE_ERROR", "READ_ERROR", "SYSTEM_ERROR"
+};
+
+/***
+ * Only the owning thread writes its counters, but other threads read them while merging; relaxed atomic loads
+ * and stores keep the values whole without the cost of a locked increment. The counters of an instance are written
+ * by one thread at a time as well, since the calls on one instance must not overlap.
+ */
+static inline void add(unsigned long long *counter, unsigned long long value)
+{
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+static SIMFS_STATS_COUNTERS_TYPE *counters()
+{
+    if (instanceCounters != NULL)
+        return instanceCounters;
+    if (threadCounters != NULL)
+        return threadCounters;
+
+    SIMFS_STATS_COUNTERS_TYPE *new = calloc(1, sizeof(SIMFS_STATS_COUNTERS_TYPE));
+    if (new == NULL)
+        return NULL;
+
+    pthread_mutex_lock(&allCountersLock);
+    new->next = allCounters;
+    allCounters = new;
+    pthread_mutex_unlock(&allCountersLock);
+
+    threadCounters = new;
+    return new;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+unsigned long long simfsStatsClock()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000000000ULL + time.tv_nsec;
+}
+
+/***
+ * Counts a call of a simfs function that started at the given time of simfsStatsClock. Returns the result, so
+ * that a function can record and return it in one statement.
+ */
+SIMFS_ERROR simfsStatsRecord(SIMFS_STATS_OPERATION_TYPE operation, unsigned long long start, SIMFS_ERROR result)
+{
+    SIMFS_STATS_COUNTERS_TYPE *self = counters();
+    if (self == NULL)
+        return result;
+
+    unsigned long long elapsed = simfsStatsClock() - start;
+    int bucket = 63 - __builtin_clzll(elapsed | 1);
+    if (bucket >= SIMFS_STATS_NUMBER_OF_BUCKETS)
+        bucket = SIMFS_STATS_NUMBER_OF_BUCKETS - 1;
+
+    SIMFS_OPERATION_STATS_TYPE *stats = &self->operation[operation];
+    add(&stats->calls, 1);
+    add(&stats->results[(unsigned) result < SIMFS_STATS_NUMBER_OF_ERRORS ? result : SIMFS_SYSTEM_ERROR], 1);
+    add(&stats->nanoseconds, elapsed);
+    add(&stats->latency[bucket], 1);
+
+    return result;
+}
+
+void simfsStatsBlocks(int allocated, int freed)
+{
+    SIMFS_STATS_COUNTERS_TYPE *self = counters();
+    if (self == NULL)
+        return;
+
+    add(&self->blocksAllocated, allocated);
+    add(&self->blocksFreed, freed);
+}
+
+void simfsStatsDentry(int hit)
+{
+    SIMFS_STATS_COUNTERS_TYPE *self = counters();
+    if (self == NULL)
+        return;
+
+    add(hit ? &self->dentryHits : &self->dentryMisses, 1);
+}
+
+void simfsStatsDeduplicated()
+{
+    SIMFS_STATS_COUNTERS_TYPE *self = counters();
+    if (self == NULL)
+        return;
+
+    add(&self->blocksDeduplicated, 1);
+}
+
+static void mergeCounters(SIMFS_STATS_COUNTERS_TYPE *from, SIMFS_STATS_TYPE *stats)
+{
+    for (int i = 0; i < SIMFS_STATS_NUMBER_OF_OPERATIONS; i++) {
+        SIMFS_OPERATION_STATS_TYPE *operation = &from->operation[i], *to = &stats->operation[i];
+        to->calls += __atomic_load_n(&operation->calls, __ATOMIC_RELAXED);
+        to->nanoseconds += __atomic_load_n(&operation->nanoseconds, __ATOMIC_RELAXED);
+        for (int j = 0; j < SIMFS_STATS_NUMBER_OF_ERRORS; j++)
+            to->results[j] += __atomic_load_n(&operation->results[j], __ATOMIC_RELAXED);
+        for (int j = 0; j < SIMFS_STATS_NUMBER_OF_BUCKETS; j++)
+            to->latency[j] += __atomic_load_n(&operation->latency[j], __ATOMIC_RELAXED);
+    }
+    stats->blocksAllocated += __atomic_load_n(&from->blocksAllocated, __ATOMIC_RELAXED);
+    stats->blocksFreed += __atomic_load_n(&from->blocksFreed, __ATOMIC_RELAXED);
+    stats->dentryHits += __atomic_load_n(&from->dentryHits, __ATOMIC_RELAXED);
+    stats->dentryMisses += __atomic_load_n(&from->dentryMisses, __ATOMIC_RELAXED);
+    stats->blocksDeduplicated += __atomic_load_n(&from->blocksDeduplicated, __ATOMIC_RELAXED);
+}
+
+/***
+ * Adds up the counters into the parameter stats; the sampled fields are left alone. The counters are those of the
+ * given instance, or with NULL those of all threads working on the default instance.
+ */
+void simfsStatsMerge(SIMFS_STATS_TYPE *stats, SIMFS_STATS_COUNTERS_TYPE *instance)
+{
+    memset(stats->operation, 0, sizeof(stats->operation));
+    stats->blocksAllocated = 0;
+    stats->blocksFreed = 0;
+    stats->dentryHits = 0;
+    stats->dentryMisses = 0;
+    stats->blocksDeduplicated = 0;
+
+    if (instance != NULL) {
+        mergeCounters(instance, stats);
+        return;
+    }
+
+    pthread_mutex_lock(&allCountersLock);
+    for (SIMFS_STATS_COUNTERS_TYPE *thread = allCounters; thread != NULL; thread = thread->next)
+        mergeCounters(thread, stats);
+    pthread_mutex_unlock(&allCountersLock);
+}
+
+/***
+ * Counters of an instance other than the default one. They are not linked into the list of the threads, so they
+ * are only merged by the statistics of their instance.
+ */
+SIMFS_STATS_COUNTERS_TYPE *simfsStatsCreateCounters()
+{
+    return calloc(1, sizeof(SIMFS_STATS_COUNTERS_TYPE));
+}
+
+void simfsStatsDestroyCounters(SIMFS_STATS_COUNTERS_TYPE *instance)
+{
+    free(instance);
+}
+
+/***
+ * Makes the calling thread count into the counters of an instance, or with NULL into its own ones again.
+ */
+void simfsStatsSelect(SIMFS_STATS_COUNTERS_TYPE *instance)
+{
+    instanceCounters = instance;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+/***
+ * Writes the statistics as text, one "name value" pair per line, into the buffer; like snprintf, it returns the
+ * length of the complete text even if the buffer is too small, so a NULL buffer of size 0 can be used to measure it.
+ *
+ * Only non-zero result counts and histogram buckets are listed; a bucket is named after its upper bound,
+ * the last one after its lower bound.
+ */
+int simfsFormatStats(SIMFS_STATS_TYPE *stats, char *buffer, size_t size)
+{
+    size_t length = 0;
+
+#define SIMFS_STATS_PRINT(...) \
+    length += snprintf(buffer + (length < size ? length : size), length < size ? size - length : 0, __VA_ARGS__)
+
+    for (int i = 0; i < SIMFS_STATS_NUMBER_OF_OPERATIONS; i++) {
+        SIMFS_OPERATION_STATS_TYPE *operation = &stats->operation[i];
+        if (operation->calls == 0)
+            continue;
+
+        SIMFS_STATS_PRINT("%s.calls %llu\n", operationNames[i], operation->calls);
+        SIMFS_STATS_PRINT("%s.meanNanoseconds %llu\n", operationNames[i], operation->nanoseconds / operation->calls);
+        for (int j = 0; j < SIMFS_STATS_NUMBER_OF_ERRORS; j++)
+            if (operation->results[j] != 0)
+                SIMFS_STATS_PRINT("%s.result.%s %llu\n", operationNames[i], errorNames[j], operation->results[j]);
+        for (int j = 0; j < SIMFS_STATS_NUMBER_OF_BUCKETS - 1; j++)
+            if (operation->latency[j] != 0)
+                SIMFS_STATS_PRINT("%s.latency.lt%lluns %llu\n", operationNames[i], 2ULL << j, operation->latency[j]);
+        if (operation->latency[SIMFS_STATS_NUMBER_OF_BUCKETS - 1] != 0)
+            SIMFS_STATS_PRINT("%s.latency.ge%lluns %llu\n", operationNames[i], 1ULL << (SIMFS_STATS_NUMBER_OF_BUCKETS - 1),
+                              operation->latency[SIMFS_STATS_NUMBER_OF_BUCKETS - 1]);
+    }
+
+    SIMFS_STATS_PRINT("blocksAllocated %llu\n", stats->blocksAllocated);
+    SIMFS_STATS_PRINT("blocksFreed %llu\n", stats->blocksFreed);
+    SIMFS_STATS_PRINT("dentryHits %llu\n", stats->dentryHits);
+    SIMFS_STATS_PRINT("dentryMisses %llu\n", stats->dentryMisses);
+    SIMFS_STATS_PRINT("blocksDeduplicated %llu\n", stats->blocksDeduplicated);
+    SIMFS_STATS_PRINT("freeBlocks %d\n", stats->freeBlocks);
+    SIMFS_STATS_PRINT("sharedBlocks %d\n", stats->sharedBlocks);
+    SIMFS_STATS_PRINT("directoryEntries %d\n", stats->directoryEntries);
+    SIMFS_STATS_PRINT("usedDirectorySlots %d\n", stats->usedDirectorySlots);
+    SIMFS_STATS_PRINT("longestHashChain %d\n", stats->longestHashChain);
+    SIMFS_STATS_PRINT("openFiles %d\n", stats->openFiles);
+
+#undef SIMFS_STATS_PRINT
+
+    return (int) length;
+}
@@ -0,0 +1,36 @@
+#ifndef __SIMFS_STATS_H_
+#define __SIMFS_STATS_H_
+
+#include "simfs.h"
+
+//////////////////////////////////////////////////////////////////////////
+//
+// collection of the statistics returned by simfsGetStats
+//
+// Each thread counts into its own set of counters, which is linked into a global list the first time the thread
+// records something; the sets are only added up when the statistics are read, so recording needs no locking.
+// An instance other than the default one has a set of its own, which the thread working on it counts into instead.
+//
+//////////////////////////////////////////////////////////////////////////
+
+typedef struct simfs_stats_counters_type SIMFS_STATS_COUNTERS_TYPE;
+
+unsigned long long simfsStatsClock();
+
+SIMFS_ERROR simfsStatsRecord(SIMFS_STATS_OPERATION_TYPE operation, unsigned long long start, SIMFS_ERROR result);
+
+void simfsStatsBlocks(int allocated, int freed);
+
+void simfsStatsDentry(int hit);
+
+void simfsStatsDeduplicated();
+
+void simfsStatsMerge(SIMFS_STATS_TYPE *stats, SIMFS_STATS_COUNTERS_TYPE *instance);
+
+SIMFS_STATS_COUNTERS_TYPE *simfsStatsCreateCounters();
+
+void simfsStatsDestroyCounters(SIMFS_STATS_COUNTERS_TYPE *instance);
+
+void simfsStatsSelect(SIMFS_STATS_COUNTERS_TYPE *instance);
+
+#endif
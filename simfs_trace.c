@@ -0,0 +1,89 @@
+#include <stdbool.h>
+#include "simfs_trace.h"
+
+//
+// ring of one thread
+//
+// Only the owning thread writes to a ring; head counts the records written so far and is published with a release
+// store after the record is complete, so a reader sees whole records without locking. A ring that wraps around
+// overwrites its oldest records.
+//
+typedef struct simfs_trace_ring_type {
+    uint64_t head;
+    uint32_t thread;
+    struct simfs_trace_ring_type *next;
+    SIMFS_TRACE_RECORD_TYPE record[SIMFS_TRACE_RING_SIZE];
+} SIMFS_TRACE_RING_TYPE;
+
+static _Thread_local SIMFS_TRACE_RING_TYPE *threadRing;
+
+// rings are pushed to the front of the list with a compare-and-swap, and never removed
+static SIMFS_TRACE_RING_TYPE *allRings;
+static uint32_t numberOfThreads;
+
+static SIMFS_TRACE_RING_TYPE *ring()
+{
+    if (threadRing != NULL)
+        return threadRing;
+
+    SIMFS_TRACE_RING_TYPE *new = calloc(1, sizeof(SIMFS_TRACE_RING_TYPE));
+    if (new == NULL)
+        return NULL;
+
+    new->thread = __atomic_add_fetch(&numberOfThreads, 1, __ATOMIC_RELAXED);
+    new->next = __atomic_load_n(&allRings, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&allRings, &new->next, new, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+
+    threadRing = new;
+    return new;
+}
+
+void simfsTrace(SIMFS_TRACE_EVENT_TYPE event, SIMFS_TRACE_PHASE_TYPE phase, uint32_t a, uint32_t b)
+{
+    SIMFS_TRACE_RING_TYPE *self = ring();
+    if (self == NULL)
+        return;
+
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    SIMFS_TRACE_RECORD_TYPE *record = &self->record[self->head & (SIMFS_TRACE_RING_SIZE - 1)];
+    record->timestamp = time.tv_sec * 1000000000ULL + time.tv_nsec;
+    record->thread = self->thread;
+    record->event = event;
+    record->phase = phase;
+    record->a = a;
+    record->b = b;
+
+    __atomic_store_n(&self->head, self->head + 1, __ATOMIC_RELEASE);
+}
+
+/***
+ * Writes the records held by the rings of all threads to a file, oldest first for each thread.
+ *
+ * Records that a thread writes while its ring is being saved may overwrite ones that are being copied, so the
+ * result is only exact for threads that are not tracing at the time.
+ */
+SIMFS_ERROR simfsTraceSave(char *fileName)
+{
+    FILE *file = fopen(fileName, "wb");
+    if (file == NULL)
+        return SIMFS_WRITE_ERROR;
+
+    SIMFS_TRACE_HEADER_TYPE header = {SIMFS_TRACE_MAGIC, SIMFS_TRACE_VERSION, sizeof(SIMFS_TRACE_RECORD_TYPE)};
+    bool written = (fwrite(&header, sizeof(header), 1, file) == 1);
+
+    for (SIMFS_TRACE_RING_TYPE *ring = __atomic_load_n(&allRings, __ATOMIC_ACQUIRE); ring != NULL && written;
+         ring = ring->next) {
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        for (uint64_t i = (head > SIMFS_TRACE_RING_SIZE ? head - SIMFS_TRACE_RING_SIZE : 0); i < head && written; i++)
+            written = (fwrite(&ring->record[i & (SIMFS_TRACE_RING_SIZE - 1)], sizeof(SIMFS_TRACE_RECORD_TYPE), 1,
+                              file) == 1);
+    }
+
+    if (fclose(file) != 0 || !written)
+        return SIMFS_WRITE_ERROR;
+
+    return SIMFS_NO_ERROR;
+}
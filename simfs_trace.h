@@ -0,0 +1,89 @@
+#ifndef __SIMFS_TRACE_H_
+#define __SIMFS_TRACE_H_
+
+#include <stdint.h>
+#include "simfs.h"
+
+//////////////////////////////////////////////////////////////////////////
+//
+// tracing of the hot paths
+//
+// With SIMFS_TRACING defined, the SIMFS_TRACE_* macros append fixed-size records to a ring buffer of the calling
+// thread, and with SIMFS_HAVE_SDT also fire the USDT probe simfs:event, whose arguments are those of the record
+// (event, phase, a, b), for bpftrace and the like. Without SIMFS_TRACING the macros expand to nothing, and their
+// arguments are not evaluated.
+//
+// The rings are saved by simfsTraceSave; unmounting saves them to the file named by the environment variable
+// SIMFS_TRACE_FILE, if it is set. simfs_trace_dump converts the file to the Chrome trace event format.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#define SIMFS_TRACE_RING_SIZE 8192 // records per thread; a power of two
+#define SIMFS_TRACE_MAGIC "SIMFSTRC"
+#define SIMFS_TRACE_VERSION 1
+
+typedef enum {
+    SIMFS_TRACE_FIND_FILE, // a: folder, b: file descriptor block found or SIMFS_INVALID_INDEX
+    SIMFS_TRACE_FIND_EMPTY_HASH, // a: directory bucket, b: entries in front of the new one
+    SIMFS_TRACE_FIND_FREE_BLOCK, // a: block found or SIMFS_NUMBER_OF_BLOCKS
+    SIMFS_TRACE_WRITE_FILE, // begin a: file handle, b: size; end a: first index block, b: result
+    SIMFS_TRACE_READ_FILE, // begin a: file handle; end a: first index block, b: result
+    SIMFS_TRACE_NUMBER_OF_EVENTS
+} SIMFS_TRACE_EVENT_TYPE;
+
+typedef enum {
+    SIMFS_TRACE_BEGIN,
+    SIMFS_TRACE_END,
+    SIMFS_TRACE_INSTANT
+} SIMFS_TRACE_PHASE_TYPE;
+
+typedef struct simfs_trace_record_type {
+    uint64_t timestamp; // nanoseconds of CLOCK_MONOTONIC
+    uint32_t thread;
+    uint16_t event;
+    uint16_t phase;
+    uint32_t a;
+    uint32_t b;
+} SIMFS_TRACE_RECORD_TYPE;
+
+typedef struct simfs_trace_header_type {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+} SIMFS_TRACE_HEADER_TYPE;
+
+void simfsTrace(SIMFS_TRACE_EVENT_TYPE event, SIMFS_TRACE_PHASE_TYPE phase, uint32_t a, uint32_t b);
+
+SIMFS_ERROR simfsTraceSave(char *fileName);
+
+#ifdef SIMFS_TRACING
+
+#ifdef SIMFS_HAVE_SDT
+#include <sys/sdt.h>
+#define SIMFS_TRACE(traceEvent, tracePhase, a, b) do { \
+        uint32_t traceA = (a), traceB = (b); \
+        DTRACE_PROBE4(simfs, event, traceEvent, tracePhase, traceA, traceB); \
+        simfsTrace(traceEvent, tracePhase, traceA, traceB); \
+    } while (0)
+#else
+#define SIMFS_TRACE(event, phase, a, b) simfsTrace(event, phase, (a), (b))
+#endif
+
+#define SIMFS_TRACE_SAVE() do { \
+        char *traceFile = getenv("SIMFS_TRACE_FILE"); \
+        if (traceFile != NULL) \
+            simfsTraceSave(traceFile); \
+    } while (0)
+
+#else
+
+#define SIMFS_TRACE(event, phase, a, b) ((void) 0)
+#define SIMFS_TRACE_SAVE() ((void) 0)
+
+#endif
+
+#define SIMFS_TRACE_BEGIN(event, a, b) SIMFS_TRACE(event, SIMFS_TRACE_BEGIN, a, b)
+#define SIMFS_TRACE_END(event, a, b) SIMFS_TRACE(event, SIMFS_TRACE_END, a, b)
+#define SIMFS_TRACE_INSTANT(event, a, b) SIMFS_TRACE(event, SIMFS_TRACE_INSTANT, a, b)
+
+#endif
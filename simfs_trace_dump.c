@@ -0,0 +1,80 @@
+#include "simfs_trace.h"
+
+//////////////////////////////////////////////////////////////////////////
+//
+// converts a trace saved by simfsTraceSave to the Chrome trace event format
+//
+// usage: simfs_trace_dump <trace file> [output.json]
+//
+// The output can be loaded into chrome://tracing or Perfetto. Begin and end records become duration events,
+// the others instant events; the values of a record are listed as the arguments of its event.
+//
+//////////////////////////////////////////////////////////////////////////
+
+static char *eventNames[SIMFS_TRACE_NUMBER_OF_EVENTS] = {
+    "findFile", "findEmptyHash", "simfsFindFreeBlock", "simfsWriteFile", "simfsReadFile"
+};
+
+// names of the values a and b of each event; for begin and end records of reads and writes they differ
+static char *argumentNames[SIMFS_TRACE_NUMBER_OF_EVENTS][2][2] = {
+    {{"folder", "node"}, {"folder", "node"}},
+    {{"bucket", "position"}, {"bucket", "position"}},
+    {{"block", "unused"}, {"block", "unused"}},
+    {{"fileHandle", "size"}, {"blockRef", "result"}},
+    {{"fileHandle", "unused"}, {"blockRef", "result"}}
+};
+
+static char phases[] = {'B', 'E', 'i'};
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: simfs_trace_dump <trace file> [output.json]\n");
+        return EXIT_FAILURE;
+    }
+
+    FILE *input = fopen(argv[1], "rb");
+    if (input == NULL) {
+        fprintf(stderr, "simfs_trace_dump: cannot open %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    SIMFS_TRACE_HEADER_TYPE header;
+    if (fread(&header, sizeof(header), 1, input) != 1
+        || memcmp(header.magic, SIMFS_TRACE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != SIMFS_TRACE_VERSION || header.recordSize != sizeof(SIMFS_TRACE_RECORD_TYPE)) {
+        fprintf(stderr, "simfs_trace_dump: %s is not a simfs trace of version %d\n", argv[1], SIMFS_TRACE_VERSION);
+        return EXIT_FAILURE;
+    }
+
+    FILE *output = (argc == 3 ? fopen(argv[2], "w") : stdout);
+    if (output == NULL) {
+        fprintf(stderr, "simfs_trace_dump: cannot create %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    fprintf(output, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+
+    SIMFS_TRACE_RECORD_TYPE record;
+    unsigned long count = 0;
+    while (fread(&record, sizeof(record), 1, input) == 1) {
+        if (record.event >= SIMFS_TRACE_NUMBER_OF_EVENTS || record.phase > SIMFS_TRACE_INSTANT)
+            continue;
+
+        char **names = argumentNames[record.event][record.phase == SIMFS_TRACE_END];
+        fprintf(output, "%s\n  {\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %.3f, \"pid\": 1, \"tid\": %u%s, "
+                        "\"args\": {\"%s\": %u, \"%s\": %u}}",
+                count++ == 0 ? "" : ",", eventNames[record.event], phases[record.phase], record.timestamp / 1000.0,
+                record.thread, record.phase == SIMFS_TRACE_INSTANT ? ", \"s\": \"t\"" : "",
+                names[0], record.a, names[1], record.b);
+    }
+
+    fprintf(output, "\n]}\n");
+
+    fclose(input);
+    if (output != stdout)
+        fclose(output);
+
+    fprintf(stderr, "%lu events\n", count);
+    return EXIT_SUCCESS;
+}
@@ -1,7 +1,819 @@
 #include "simfs.h"
+#include "simfs_crc.h"
+#include "simfs_lz4.h"
+#include <fcntl.h>
+#include <stddef.h>
+#include <unistd.h>
 
 #define SIMFS_FILE_NAME "simfsFile.dta"
 
+static void expect(int condition, char *what)
+{
+    if (!condition) {
+        fprintf(stderr, "test_simfs: %s\n", what);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/***
+ * Creates and mounts an empty volume.
+ */
+static void mountNewVolume()
+{
+    expect(simfsCreateFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "create the volume");
+    expect(simfsMountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "mount the volume");
+}
+
+/***
+ * Creates a file in the current folder and opens it.
+ */
+static SIMFS_FILE_HANDLE_TYPE createAndOpen(char *name)
+{
+    SIMFS_NAME_TYPE fileName = {0};
+    strncpy(fileName, name, sizeof(fileName) - 1);
+    SIMFS_FILE_HANDLE_TYPE fileHandle;
+    expect(simfsCreateFile(fileName, SIMFS_FILE_CONTENT_TYPE) == SIMFS_NO_ERROR, "create a file");
+    expect(simfsOpenFile(fileName, &fileHandle) == SIMFS_NO_ERROR, "open a file");
+    return fileHandle;
+}
+
+/***
+ * Checks that the content of an open file is the given string.
+ */
+static void expectContent(SIMFS_FILE_HANDLE_TYPE fileHandle, char *content, char *what)
+{
+    char *readBuffer;
+    expect(simfsReadFile(fileHandle, &readBuffer) == SIMFS_NO_ERROR, what);
+    expect(strcmp(readBuffer, content) == 0, what);
+    free(readBuffer);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+/***
+ * A file opened both by name and by reference keeps the slot of the process until the reference that holds it is
+ * closed.
+ */
+static void testOpenByReference()
+{
+    mountNewVolume();
+    SIMFS_FILE_HANDLE_TYPE byName = createAndOpen("shared"), byReference, again;
+    SIMFS_NAME_TYPE fileName = "shared";
+    SIMFS_INDEX_TYPE node;
+    expect(simfsLookupFile(SIMFS_ROOT_NODE_INDEX, fileName, &node) == SIMFS_NO_ERROR, "look up a file");
+    expect(simfsOpenFileByReference(node, &byReference) == SIMFS_NO_ERROR && byReference == byName,
+           "open a file by reference");
+
+    expect(simfsCloseFile(byReference) == SIMFS_NO_ERROR, "close a file opened by reference");
+    expect(simfsOpenFile(fileName, &again) == SIMFS_DUPLICATE_ERROR && again == byName,
+           "the process still holds the file");
+
+    expect(simfsCloseFile(byName) == SIMFS_NO_ERROR, "close a file opened by name");
+    expect(simfsCloseFile(byName) == SIMFS_SYSTEM_ERROR, "close a closed file");
+    expect(simfsOpenFile(fileName, &again) == SIMFS_NO_ERROR, "open a closed file again");
+    expect(simfsCloseFile(again) == SIMFS_NO_ERROR, "close the file again");
+
+    expect(simfsUmountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "unmount the volume");
+}
+
+/***
+ * A file is not closed while vectors into it are pinned, whether they point into its blocks or, for a compressed
+ * file, into its decompressed content.
+ */
+static void testCloseWhilePinned()
+{
+    mountNewVolume();
+    for (int compressed = 0; compressed < 2; compressed++) {
+        SIMFS_FILE_HANDLE_TYPE fileHandle = createAndOpen(compressed ? "compressed" : "raw");
+        char *content = simfsGenerateContent(100);
+        expect(simfsSetFileCompression(fileHandle, compressed) == SIMFS_NO_ERROR, "set the compression of a file");
+        expect(simfsWriteFile(fileHandle, content) == SIMFS_NO_ERROR, "write a file");
+
+        struct iovec vector[16];
+        int count = 16;
+        expect(simfsReadFileVector(fileHandle, 0, 100, vector, &count) == SIMFS_NO_ERROR, "read a vector");
+        expect(simfsCloseFile(fileHandle) == SIMFS_ACCESS_ERROR, "close a file with a pinned vector");
+        expect(simfsWriteFile(fileHandle, "replaced") == SIMFS_NO_ERROR, "replace pinned content");
+
+        size_t offset = 0;
+        for (int i = 0; i < count; i++) {
+            expect(memcmp(vector[i].iov_base, content + offset, vector[i].iov_len) == 0, "pinned content is kept");
+            offset += vector[i].iov_len;
+        }
+        expect(offset == strlen(content), "the vector covers the file");
+
+        expect(simfsReleaseFileVector(fileHandle) == SIMFS_NO_ERROR, "release a vector");
+        expect(simfsCloseFile(fileHandle) == SIMFS_NO_ERROR, "close a file after releasing its vector");
+        free(content);
+    }
+    expect(simfsUmountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "unmount the volume");
+}
+
+/***
+ * Each operation of a batch leaves the result of the corresponding simfs function, in the order of the batch.
+ */
+static void testBatch()
+{
+    mountNewVolume();
+    SIMFS_NAME_TYPE fileName = "batched", folderName = "folder", missingName = "missing";
+    SIMFS_FILE_DESCRIPTOR_TYPE info;
+
+    SIMFS_BATCH_OPERATION_TYPE first[] = {
+        {.operation = SIMFS_CREATE_FILE_OPERATION, .fileName = fileName, .type = SIMFS_FILE_CONTENT_TYPE},
+        {.operation = SIMFS_CREATE_FILE_OPERATION, .fileName = fileName, .type = SIMFS_FILE_CONTENT_TYPE},
+        {.operation = SIMFS_CREATE_FILE_OPERATION, .fileName = folderName, .type = SIMFS_FOLDER_CONTENT_TYPE},
+        {.operation = SIMFS_GET_FILE_INFO_OPERATION, .fileName = missingName, .infoBuffer = &info},
+        {.operation = SIMFS_OPEN_FILE_OPERATION, .fileName = fileName},
+    };
+    expect(simfsSubmitBatch(first, 5) == SIMFS_NO_ERROR, "submit a batch");
+    expect(first[0].result == SIMFS_NO_ERROR, "create a file in a batch");
+    expect(first[1].result == SIMFS_DUPLICATE_ERROR, "create a file twice in a batch");
+    expect(first[2].result == SIMFS_NO_ERROR, "create a folder in a batch");
+    expect(first[3].result == SIMFS_NOT_FOUND_ERROR, "get the information of a missing file in a batch");
+    expect(first[4].result == SIMFS_NO_ERROR, "open a file in a batch");
+
+    SIMFS_BATCH_OPERATION_TYPE second[] = {
+        {.operation = SIMFS_WRITE_FILE_OPERATION, .fileHandle = first[4].fileHandle, .writeBuffer = "content"},
+        {.operation = SIMFS_CLOSE_FILE_OPERATION, .fileHandle = first[4].fileHandle},
+        {.operation = SIMFS_GET_FILE_INFO_OPERATION, .fileName = fileName, .infoBuffer = &info},
+        {.operation = SIMFS_DELETE_FILE_OPERATION, .fileName = folderName},
+        {.operation = SIMFS_DELETE_FILE_OPERATION, .fileName = folderName},
+        {.operation = SIMFS_CLOSE_FILE_OPERATION, .fileHandle = first[4].fileHandle},
+    };
+    expect(simfsSubmitBatch(second, 6) == SIMFS_NO_ERROR, "submit a batch");
+    expect(second[0].result == SIMFS_NO_ERROR, "write a file in a batch");
+    expect(second[1].result == SIMFS_NO_ERROR, "close a file in a batch");
+    expect(second[2].result == SIMFS_NO_ERROR && info.size == strlen("content"), "get information in a batch");
+    expect(second[3].result == SIMFS_NO_ERROR, "delete a folder in a batch");
+    expect(second[4].result == SIMFS_NOT_FOUND_ERROR, "delete a folder twice in a batch");
+    expect(second[5].result == SIMFS_SYSTEM_ERROR, "close a closed file in a batch");
+
+    SIMFS_FILE_HANDLE_TYPE fileHandle;
+    expect(simfsOpenFile(fileName, &fileHandle) == SIMFS_NO_ERROR, "open a file created in a batch");
+    expectContent(fileHandle, "content", "read a file written in a batch");
+    expect(simfsCloseFile(fileHandle) == SIMFS_NO_ERROR, "close a file");
+    expect(simfsGetFileInfo(folderName, &info) == SIMFS_NOT_FOUND_ERROR, "a folder deleted in a batch is gone");
+
+    // names are told apart only up to the length that the directory keeps
+    char longName[2 * SIMFS_MAX_NAME_LENGTH], otherLongName[2 * SIMFS_MAX_NAME_LENGTH];
+    memset(longName, 'n', sizeof(longName) - 1);
+    longName[sizeof(longName) - 1] = '\0';
+    strcpy(otherLongName, longName);
+    otherLongName[sizeof(otherLongName) - 2] = 'o';
+    SIMFS_BATCH_OPERATION_TYPE third[] = {
+        {.operation = SIMFS_CREATE_FILE_OPERATION, .fileName = longName, .type = SIMFS_FILE_CONTENT_TYPE},
+        {.operation = SIMFS_CREATE_FILE_OPERATION, .fileName = otherLongName, .type = SIMFS_FILE_CONTENT_TYPE},
+    };
+    expect(simfsSubmitBatch(third, 2) == SIMFS_NO_ERROR, "submit a batch");
+    expect(third[0].result == SIMFS_NO_ERROR, "create a file with a long name in a batch");
+    expect(third[1].result == SIMFS_DUPLICATE_ERROR, "create a file with the same cut name in a batch");
+
+    expect(simfsSubmitBatch(third, 0) == SIMFS_NO_ERROR, "submit an empty batch");
+    expect(simfsSubmitBatch(third, -1) == SIMFS_SYSTEM_ERROR, "reject a negative count");
+    expect(simfsSubmitBatch(NULL, 1) == SIMFS_SYSTEM_ERROR, "reject a missing batch");
+
+    SIMFS_CHECK_TYPE check = {.numberOfThreads = 1};
+    expect(simfsCheckFileSystem(&check) == SIMFS_NO_ERROR && check.orphanedBlocks == 0 && check.unmarkedBlocks == 0,
+           "a batch leaves the bitvector consistent");
+    expect(simfsUmountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "unmount the volume");
+}
+
+/***
+ * Compacting the volume moves the chain of a file whose vector is pinned, but the vector keeps pointing at its content.
+ */
+static void testCompactWhilePinned()
+{
+    mountNewVolume();
+    SIMFS_NAME_TYPE fileName;
+    for (int i = 0; i < 64; i++) {
+        snprintf(fileName, sizeof(fileName), "filler%d", i);
+        SIMFS_FILE_HANDLE_TYPE filler = createAndOpen(fileName);
+        expect(simfsWriteFile(filler, "fills a block") == SIMFS_NO_ERROR, "write a file");
+        expect(simfsCloseFile(filler) == SIMFS_NO_ERROR, "close a file");
+    }
+
+    char *content = simfsGenerateContent(1000);
+    SIMFS_FILE_HANDLE_TYPE fileHandle = createAndOpen("pinned");
+    expect(simfsWriteFile(fileHandle, content) == SIMFS_NO_ERROR, "write a file");
+    for (int i = 0; i < 64; i += 2) {
+        snprintf(fileName, sizeof(fileName), "filler%d", i);
+        expect(simfsDeleteFile(fileName) == SIMFS_NO_ERROR, "delete a file");
+    }
+
+    struct iovec vector[128];
+    int count = 128;
+    expect(simfsReadFileVector(fileHandle, 0, SIZE_MAX, vector, &count) == SIMFS_NO_ERROR, "read a vector");
+
+    SIMFS_COMPACTION_TYPE compaction = {0};
+    while (compaction.next < SIMFS_NUMBER_OF_BLOCKS)
+        expect(simfsCompact(&compaction, 16) == SIMFS_NO_ERROR, "compact the volume");
+    expect(compaction.relocatedFiles > 0, "compaction moves files");
+
+    size_t offset = 0;
+    for (int i = 0; i < count; i++) {
+        expect(memcmp(vector[i].iov_base, content + offset, vector[i].iov_len) == 0, "a pinned vector survives");
+        offset += vector[i].iov_len;
+    }
+    expect(offset == strlen(content), "the vector covers the file");
+
+    expect(simfsReleaseFileVector(fileHandle) == SIMFS_NO_ERROR, "release a vector");
+    expectContent(fileHandle, content, "read a compacted file");
+    expect(simfsCloseFile(fileHandle) == SIMFS_NO_ERROR, "close a file");
+
+    SIMFS_CHECK_TYPE check = {.numberOfThreads = 1};
+    expect(simfsCheckFileSystem(&check) == SIMFS_NO_ERROR && check.orphanedBlocks == 0 && check.unmarkedBlocks == 0
+           && check.doublyReferencedBlocks == 0, "compaction leaves the volume consistent");
+    free(content);
+    expect(simfsUmountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "unmount the volume");
+}
+
+#define TEST_LISTING_FILES 100
+#define TEST_LISTING_BATCH 7
+
+/***
+ * A listing read in small batches returns every child once, also when it is resumed after children were created and
+ * deleted; it spans many buckets of the directory.
+ */
+static void testReadDir()
+{
+    mountNewVolume();
+    SIMFS_NAME_TYPE fileName;
+    for (int i = 0; i < TEST_LISTING_FILES; i++) {
+        snprintf(fileName, sizeof(fileName), "child%d", i);
+        expect(simfsCreateFile(fileName, SIMFS_FILE_CONTENT_TYPE) == SIMFS_NO_ERROR, "create a file");
+    }
+
+    int seen[TEST_LISTING_FILES + 1] = {0}; // the last one counts the child created during the listing
+    SIMFS_FOLDER_CURSOR_TYPE cursor = SIMFS_FOLDER_CURSOR_START;
+    SIMFS_FOLDER_ENTRY_TYPE buffer[TEST_LISTING_BATCH];
+    int count, batches = 0, listed = 0, deleted = -1;
+    do {
+        expect(simfsReadDir(SIMFS_ROOT_NODE_INDEX, &cursor, buffer, TEST_LISTING_BATCH, &count) == SIMFS_NO_ERROR,
+               "list a folder");
+        for (int i = 0; i < count; i++) {
+            int number;
+            expect(sscanf(buffer[i].name, "child%d", &number) == 1 && number >= 0 && number <= TEST_LISTING_FILES,
+                   "list the names of the children");
+            seen[number]++;
+            listed++;
+            if (i > 0)
+                expect(buffer[i - 1].next != buffer[i].next, "each entry moves the cursor");
+        }
+
+        if (++batches == 3) {
+            // a child listed already is deleted, one not listed yet too, and a new one is created
+            snprintf(fileName, sizeof(fileName), "%s", buffer[0].name);
+            expect(simfsDeleteFile(fileName) == SIMFS_NO_ERROR, "delete a listed file");
+            for (deleted = 0; seen[deleted] > 0; deleted++);
+            snprintf(fileName, sizeof(fileName), "child%d", deleted);
+            expect(simfsDeleteFile(fileName) == SIMFS_NO_ERROR, "delete a file not listed yet");
+            snprintf(fileName, sizeof(fileName), "child%d", TEST_LISTING_FILES);
+            expect(simfsCreateFile(fileName, SIMFS_FILE_CONTENT_TYPE) == SIMFS_NO_ERROR, "create a file");
+        }
+    } while (count == TEST_LISTING_BATCH);
+
+    expect(batches > 3, "the listing takes several batches");
+    for (int i = 0; i < TEST_LISTING_FILES; i++)
+        expect(seen[i] == (i == deleted ? 0 : 1), "a resumed listing neither skips nor repeats children");
+    expect(seen[TEST_LISTING_FILES] <= 1, "a child created during the listing is listed at most once");
+    expect(listed == TEST_LISTING_FILES - 1 + seen[TEST_LISTING_FILES], "the listing ends with the last child");
+
+    expect(simfsUmountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "unmount the volume");
+}
+
+/***
+ * Paths resolved through the dentry cache follow the creation and deletion of their components, including names that
+ * were cached as missing.
+ */
+static void testDentryCache()
+{
+    mountNewVolume();
+    SIMFS_NAME_TYPE outer = "outer", inner = "inner", leaf = "leaf";
+    SIMFS_INDEX_TYPE node, again;
+
+    expect(simfsResolvePath("/outer/inner/leaf", &node) == SIMFS_NOT_FOUND_ERROR, "resolve a missing path");
+    expect(simfsCreateFile(outer, SIMFS_FOLDER_CONTENT_TYPE) == SIMFS_NO_ERROR, "create a folder");
+    expect(simfsResolvePath("/outer/inner", &node) == SIMFS_NOT_FOUND_ERROR, "resolve a missing name");
+    expect(simfsChangeDirectory("/outer") == SIMFS_NO_ERROR, "change the working directory");
+    expect(simfsCreateFile(inner, SIMFS_FOLDER_CONTENT_TYPE) == SIMFS_NO_ERROR, "create a folder");
+    expect(simfsResolvePath("/outer/inner", &node) == SIMFS_NO_ERROR, "resolve a name cached as missing");
+    expect(simfsChangeDirectory("inner") == SIMFS_NO_ERROR, "change the working directory");
+    expect(simfsCreateFile(leaf, SIMFS_FILE_CONTENT_TYPE) == SIMFS_NO_ERROR, "create a file");
+
+    expect(simfsResolvePath("/outer/inner/leaf", &node) == SIMFS_NO_ERROR, "resolve a path");
+    expect(simfsResolvePath("/outer/./inner//leaf", &again) == SIMFS_NO_ERROR && again == node,
+           "resolve a path through the cache");
+    expect(simfsResolvePath("leaf", &again) == SIMFS_NO_ERROR && again == node, "resolve a relative path");
+
+    expect(simfsDeleteFile(leaf) == SIMFS_NO_ERROR, "delete a file");
+    expect(simfsResolvePath("/outer/inner/leaf", &node) == SIMFS_NOT_FOUND_ERROR, "resolve a deleted file");
+    expect(simfsCreateFile(leaf, SIMFS_FOLDER_CONTENT_TYPE) == SIMFS_NO_ERROR, "create a folder");
+    expect(simfsResolvePath("/outer/inner/leaf", &again) == SIMFS_NO_ERROR, "resolve a name created again");
+    SIMFS_FILE_DESCRIPTOR_TYPE info;
+    expect(simfsGetFileInfoByReference(again, &info) == SIMFS_NO_ERROR && info.type == SIMFS_FOLDER_CONTENT_TYPE,
+           "a name created again refers to the new folder");
+    expect(simfsDeleteFile(leaf) == SIMFS_NO_ERROR, "delete a folder");
+
+    expect(simfsChangeDirectory("/outer") == SIMFS_NO_ERROR, "change the working directory");
+    expect(simfsDeleteFile(inner) == SIMFS_NO_ERROR, "delete a folder");
+    expect(simfsResolvePath("/outer/inner/leaf", &node) == SIMFS_NOT_FOUND_ERROR, "resolve below a deleted folder");
+    expect(simfsChangeDirectory("/") == SIMFS_NO_ERROR, "change the working directory");
+
+    expect(simfsUmountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "unmount the volume");
+}
+
+/***
+ * A volume mounted again from its image, without any state left from the instance that wrote it, holds the folders
+ * and files written to it; creating a volume discards the one that is mounted.
+ */
+static void testColdMount()
+{
+    char *content = simfsGenerateContent(3000);
+    for (int round = 0; round < 3; round++) {
+        mountNewVolume();
+        SIMFS_NAME_TYPE folderName = "kept";
+        expect(simfsCreateFile(folderName, SIMFS_FOLDER_CONTENT_TYPE) == SIMFS_NO_ERROR, "create a folder");
+        expect(simfsChangeDirectory("/kept") == SIMFS_NO_ERROR, "enter a folder");
+        SIMFS_FILE_HANDLE_TYPE fileHandle = createAndOpen("file");
+        expect(simfsWriteFile(fileHandle, content) == SIMFS_NO_ERROR, "write a file");
+        expect(simfsCloseFile(fileHandle) == SIMFS_NO_ERROR, "close a file");
+        expect(simfsUmountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "unmount the volume");
+
+        expect(simfsMountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "mount the volume again");
+        SIMFS_INDEX_TYPE node;
+        expect(simfsResolvePath("/kept/file", &node) == SIMFS_NO_ERROR, "find a file after mounting again");
+        expect(simfsOpenFileByReference(node, &fileHandle) == SIMFS_NO_ERROR, "open a file after mounting again");
+        expectContent(fileHandle, content, "read a file after mounting again");
+        expect(simfsCloseFile(fileHandle) == SIMFS_NO_ERROR, "close a file");
+
+        expect(simfsCreateFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "create a volume over a mounted one");
+        expect(simfsMountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "mount the new volume");
+        expect(simfsResolvePath("/kept/file", &node) != SIMFS_NO_ERROR, "find no file in the new volume");
+        expect(simfsUmountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "unmount the volume");
+    }
+    free(content);
+}
+
+/***
+ * Reads a block from the image of an unmounted volume.
+ */
+static SIMFS_BLOCK_TYPE readImageBlock(SIMFS_INDEX_TYPE block)
+{
+    int file = open(SIMFS_FILE_NAME, O_RDONLY);
+    expect(file >= 0, "open the image");
+    SIMFS_BLOCK_TYPE content;
+    off_t offset = offsetof(SIMFS_VOLUME, block) + block * sizeof(SIMFS_BLOCK_TYPE);
+    expect(pread(file, &content, sizeof(content), offset) == sizeof(content), "read a block of the image");
+    close(file);
+    return content;
+}
+
+/***
+ * Overwrites a block in the image of an unmounted volume, and drops the checksum table of the image so that it is
+ * read without being checked.
+ */
+static void writeImageBlock(SIMFS_INDEX_TYPE block, SIMFS_BLOCK_TYPE *content)
+{
+    int file = open(SIMFS_FILE_NAME, O_RDWR);
+    expect(file >= 0, "open the image");
+    off_t offset = offsetof(SIMFS_VOLUME, block) + block * sizeof(SIMFS_BLOCK_TYPE);
+    expect(pwrite(file, content, sizeof(*content), offset) == sizeof(*content), "write a block of the image");
+    expect(ftruncate(file, sizeof(SIMFS_VOLUME)) == 0, "drop the checksums of the image");
+    close(file);
+}
+
+/***
+ * Changes the content type of a block in the image of an unmounted volume.
+ */
+static void damageBlock(SIMFS_INDEX_TYPE block, SIMFS_CONTENT_TYPE type)
+{
+    SIMFS_BLOCK_TYPE content = readImageBlock(block);
+    content.type = type;
+    writeImageBlock(block, &content);
+}
+
+#define TEST_CHECKSUM_BLOCKS 7 // two groups of three for simfsCrc32cBlocks, and one block left over
+
+/***
+ * Checksums of consecutive blocks are those of the blocks one by one, and simfsCrc32c gives the check value of
+ * CRC-32C and can be continued over the rest of the data.
+ */
+static void testCrc32c()
+{
+    expect(simfsCrc32c(0, "123456789", 9) == 0xE3069283, "compute the check value of CRC-32C");
+    expect(simfsCrc32c(simfsCrc32c(0, "1234", 4), "56789", 5) == 0xE3069283, "continue a checksum");
+
+    SIMFS_BLOCK_TYPE blocks[TEST_CHECKSUM_BLOCKS];
+    unsigned char *bytes = (unsigned char *) blocks;
+    for (size_t i = 0; i < sizeof(blocks); i++)
+        bytes[i] = (unsigned char) rand();
+    uint32_t checksums[TEST_CHECKSUM_BLOCKS];
+    simfsCrc32cBlocks(blocks, sizeof(SIMFS_BLOCK_TYPE), TEST_CHECKSUM_BLOCKS, checksums);
+    for (int i = 0; i < TEST_CHECKSUM_BLOCKS; i++)
+        expect(checksums[i] == simfsCrc32c(0, &blocks[i], sizeof(SIMFS_BLOCK_TYPE)),
+               "checksum consecutive blocks as single ones");
+}
+
+/***
+ * An image whose checksum table is in place is mounted only if its blocks match the table, and an image whose table
+ * is cut short is not mounted at all.
+ */
+static void testChecksums()
+{
+    mountNewVolume();
+    SIMFS_FILE_HANDLE_TYPE fileHandle = createAndOpen("checked");
+    expect(simfsWriteFile(fileHandle, "checked content") == SIMFS_NO_ERROR, "write a file");
+    expect(simfsCloseFile(fileHandle) == SIMFS_NO_ERROR, "close a file");
+    SIMFS_NAME_TYPE fileName = "checked";
+    SIMFS_INDEX_TYPE node;
+    expect(simfsLookupFile(SIMFS_ROOT_NODE_INDEX, fileName, &node) == SIMFS_NO_ERROR, "look up a file");
+    expect(simfsUmountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "unmount the volume");
+    expect(simfsMountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "mount a volume with checksums");
+    expect(simfsUmountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "unmount the volume");
+
+    int file = open(SIMFS_FILE_NAME, O_RDWR);
+    expect(file >= 0, "open the image");
+    off_t offset = offsetof(SIMFS_VOLUME, block) + node * sizeof(SIMFS_BLOCK_TYPE)
+                   + offsetof(SIMFS_BLOCK_TYPE, content.fileDescriptor.name);
+    char byte;
+    expect(pread(file, &byte, 1, offset) == 1, "read a byte of the image");
+    byte ^= 0x01;
+    expect(pwrite(file, &byte, 1, offset) == 1, "change a byte of the image");
+    expect(simfsMountFileSystem(SIMFS_FILE_NAME) == SIMFS_READ_ERROR, "refuse a block that does not match");
+
+    byte ^= 0x01;
+    expect(pwrite(file, &byte, 1, offset) == 1, "restore a byte of the image");
+    expect(simfsMountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "mount a restored image");
+    expect(simfsUmountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "unmount the volume");
+
+    expect(ftruncate(file, sizeof(SIMFS_VOLUME) + sizeof(uint32_t)) == 0, "cut the checksum table short");
+    expect(simfsMountFileSystem(SIMFS_FILE_NAME) == SIMFS_READ_ERROR, "refuse a checksum table cut short");
+    close(file);
+}
+
+#define TEST_REPAIR_CHILDREN 20
+
+/***
+ * Lists a folder into names; returns the number of children.
+ */
+static int listFolder(SIMFS_INDEX_TYPE folder, SIMFS_NAME_TYPE *names, int capacity)
+{
+    SIMFS_FOLDER_CURSOR_TYPE cursor = SIMFS_FOLDER_CURSOR_START;
+    SIMFS_FOLDER_ENTRY_TYPE entries[TEST_REPAIR_CHILDREN];
+    int count, listed = 0;
+    do {
+        expect(simfsReadDir(folder, &cursor, entries, TEST_REPAIR_CHILDREN, &count) == SIMFS_NO_ERROR, "list a folder");
+        for (int i = 0; i < count; i++, listed++)
+            if (listed < capacity)
+                strcpy(names[listed], entries[i].name);
+    } while (count > 0);
+    return listed;
+}
+
+/***
+ * Creates a folder holding files with the given number of names.
+ */
+static SIMFS_INDEX_TYPE createFolderOfFiles(char *path, int files)
+{
+    SIMFS_NAME_TYPE name;
+    SIMFS_INDEX_TYPE folder;
+    expect(simfsChangeDirectory("/") == SIMFS_NO_ERROR, "enter the root folder");
+    strcpy(name, path + 1);
+    expect(simfsCreateFile(name, SIMFS_FOLDER_CONTENT_TYPE) == SIMFS_NO_ERROR, "create a folder");
+    expect(simfsChangeDirectory(path) == SIMFS_NO_ERROR, "enter a folder");
+    for (int i = 0; i < files; i++) {
+        snprintf(name, sizeof(name), "child%d", i);
+        expect(simfsCreateFile(name, SIMFS_FILE_CONTENT_TYPE) == SIMFS_NO_ERROR, "create a file");
+    }
+    expect(simfsResolvePath(path, &folder) == SIMFS_NO_ERROR, "find a folder");
+    return folder;
+}
+
+/***
+ * Repairing a volume in which a folder lists a file whose descriptor is lost and a file refers to a data block that
+ * is lost drops the record and cuts the file there. A folder whose directory is lost is left empty, and one that
+ * lost a leaf of its directory counts only the children left; both can be emptied and deleted afterwards. The
+ * repaired volume is one that the next check finds clean.
+ */
+static void testRepair()
+{
+    mountNewVolume();
+    SIMFS_INDEX_TYPE rootless = createFolderOfFiles("/rootless", 3);
+    SIMFS_INDEX_TYPE leafless = createFolderOfFiles("/leafless", TEST_REPAIR_CHILDREN);
+    expect(simfsChangeDirectory("/") == SIMFS_NO_ERROR, "enter the root folder");
+    SIMFS_NAME_TYPE folderName = "damaged";
+    expect(simfsCreateFile(folderName, SIMFS_FOLDER_CONTENT_TYPE) == SIMFS_NO_ERROR, "create a folder");
+    expect(simfsChangeDirectory("/damaged") == SIMFS_NO_ERROR, "enter a folder");
+    char *content = simfsGenerateContent(100);
+    char *names[] = {"lost", "kept", "cut"};
+    for (int i = 0; i < 3; i++) {
+        SIMFS_FILE_HANDLE_TYPE fileHandle = createAndOpen(names[i]);
+        expect(simfsWriteFile(fileHandle, content) == SIMFS_NO_ERROR, "write a file");
+        expect(simfsCloseFile(fileHandle) == SIMFS_NO_ERROR, "close a file");
+    }
+    SIMFS_INDEX_TYPE folder, lost, cut;
+    SIMFS_FILE_DESCRIPTOR_TYPE info;
+    expect(simfsResolvePath("/damaged", &folder) == SIMFS_NO_ERROR, "find a folder");
+    expect(simfsResolvePath("/damaged/lost", &lost) == SIMFS_NO_ERROR, "find a file");
+    expect(simfsResolvePath("/damaged/cut", &cut) == SIMFS_NO_ERROR, "find a file");
+    expect(simfsGetFileInfoByReference(cut, &info) == SIMFS_NO_ERROR, "get the information of a file");
+    SIMFS_INDEX_TYPE cutIndex = info.block_ref;
+    expect(simfsGetFileInfoByReference(rootless, &info) == SIMFS_NO_ERROR, "get the information of a folder");
+    SIMFS_INDEX_TYPE rootlessDirectory = info.block_ref;
+    expect(simfsGetFileInfoByReference(leafless, &info) == SIMFS_NO_ERROR, "get the information of a folder");
+    SIMFS_INDEX_TYPE leaflessDirectory = info.block_ref;
+    expect(simfsUmountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "unmount the volume");
+
+    damageBlock(lost, SIMFS_INVALID_CONTENT_TYPE);
+    damageBlock(readImageBlock(cutIndex).content.index[2], SIMFS_INVALID_CONTENT_TYPE);
+    damageBlock(rootlessDirectory, SIMFS_INVALID_CONTENT_TYPE);
+    SIMFS_BLOCK_TYPE directory = readImageBlock(leaflessDirectory);
+    int bucket = 0;
+    while (directory.content.bucket[bucket] == 0)
+        bucket++;
+    damageBlock(directory.content.bucket[bucket], SIMFS_INVALID_CONTENT_TYPE);
+    expect(simfsMountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "mount a damaged volume");
+
+    SIMFS_CHECK_TYPE check = {.numberOfThreads = 2};
+    expect(simfsCheckFileSystem(&check) == SIMFS_NO_ERROR, "check a damaged volume");
+    expect(check.brokenReferences == 4, "find the references to the lost blocks");
+    check.repair = 1;
+    expect(simfsCheckFileSystem(&check) == SIMFS_NO_ERROR, "repair a damaged volume");
+    check.repair = 0;
+    expect(simfsCheckFileSystem(&check) == SIMFS_NO_ERROR, "check a repaired volume");
+    expect(check.brokenReferences == 0 && check.orphanedBlocks == 0 && check.unmarkedBlocks == 0
+           && check.orphanedDescriptors == 0 && check.doublyReferencedBlocks == 0, "find a repaired volume clean");
+    SIMFS_NAME_TYPE children[TEST_REPAIR_CHILDREN];
+    int survivors = listFolder(leafless, children, TEST_REPAIR_CHILDREN);
+    expect(survivors < TEST_REPAIR_CHILDREN, "drop the children of a lost leaf");
+    expect(check.files == 2 + (unsigned long) survivors && check.folders == 4, "keep the live folders and files");
+
+    for (int round = 0; round < 2; round++) {
+        SIMFS_NAME_TYPE fileName = "lost";
+        SIMFS_INDEX_TYPE node;
+        expect(simfsLookupFile(folder, fileName, &node) == SIMFS_NOT_FOUND_ERROR, "drop the record of a lost file");
+        expect(simfsGetFileInfoByReference(folder, &info) == SIMFS_NO_ERROR && info.size == 2,
+               "count the records left in a folder");
+
+        SIMFS_FILE_HANDLE_TYPE fileHandle;
+        expect(simfsResolvePath("/damaged/kept", &node) == SIMFS_NO_ERROR, "find a file kept");
+        expect(simfsOpenFileByReference(node, &fileHandle) == SIMFS_NO_ERROR, "open a file kept");
+        expectContent(fileHandle, content, "read a file kept");
+        expect(simfsCloseFile(fileHandle) == SIMFS_NO_ERROR, "close a file");
+
+        char *start = strndup(content, 2 * SIMFS_DATA_SIZE);
+        expect(simfsOpenFileByReference(cut, &fileHandle) == SIMFS_NO_ERROR, "open a file cut");
+        expectContent(fileHandle, start, "read a file cut before its lost block");
+        expect(simfsCloseFile(fileHandle) == SIMFS_NO_ERROR, "close a file");
+        free(start);
+
+        expect(simfsGetFileInfoByReference(rootless, &info) == SIMFS_NO_ERROR && info.size == 0
+               && listFolder(rootless, children, TEST_REPAIR_CHILDREN) == 0, "empty a folder whose directory is lost");
+        expect(simfsGetFileInfoByReference(leafless, &info) == SIMFS_NO_ERROR && info.size == (size_t) survivors
+               && listFolder(leafless, children, TEST_REPAIR_CHILDREN) == survivors,
+               "count the children left of a folder that lost a leaf");
+
+        if (round == 0) {
+            expect(simfsUmountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "unmount the volume");
+            expect(simfsMountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "mount a repaired volume");
+        }
+    }
+
+    SIMFS_NAME_TYPE fileName = "fresh";
+    expect(simfsChangeDirectory("/rootless") == SIMFS_NO_ERROR, "enter a folder whose directory is lost");
+    expect(simfsCreateFile(fileName, SIMFS_FILE_CONTENT_TYPE) == SIMFS_NO_ERROR, "create a file in a new directory");
+    expect(simfsDeleteFile(fileName) == SIMFS_NO_ERROR, "delete a file of a new directory");
+    expect(simfsChangeDirectory("/leafless") == SIMFS_NO_ERROR, "enter a folder that lost a leaf");
+    for (int i = 0; i < survivors; i++)
+        expect(simfsDeleteFile(children[i]) == SIMFS_NO_ERROR, "delete a child left");
+    expect(simfsChangeDirectory("/") == SIMFS_NO_ERROR, "enter the root folder");
+    strcpy(fileName, "rootless");
+    expect(simfsDeleteFile(fileName) == SIMFS_NO_ERROR, "delete a folder whose directory is lost");
+    strcpy(fileName, "leafless");
+    expect(simfsDeleteFile(fileName) == SIMFS_NO_ERROR, "delete a folder that lost a leaf");
+    expect(simfsCheckFileSystem(&check) == SIMFS_NO_ERROR && check.brokenReferences == 0
+           && check.orphanedBlocks == 0 && check.unmarkedBlocks == 0, "find the emptied volume clean");
+    expect(simfsUmountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "unmount the volume");
+    free(content);
+}
+
+#define TEST_COMPRESSION_SIZE (3 * SIMFS_COMPRESSION_CHUNK_SIZE + 100)
+
+/***
+ * Content that compresses: a sentence repeated, with a counter so that the matches are not all at the same distance.
+ */
+static char *repetitiveContent(int size)
+{
+    char *content = malloc(size);
+    expect(content != NULL, "allocate content");
+    for (int offset = 0; offset < size - 1;)
+        offset += snprintf(content + offset, size - offset, "sentence %d of the repetitive content; ", offset % 7);
+    content[size - 1] = '\0';
+    return content;
+}
+
+/***
+ * LZ4 blocks decompress to what was compressed, whether the content compresses or not, and input that is cut or
+ * made up is rejected.
+ */
+static void testLz4()
+{
+    char *contents[] = {repetitiveContent(TEST_COMPRESSION_SIZE), simfsGenerateContent(TEST_COMPRESSION_SIZE)};
+    int capacity = TEST_COMPRESSION_SIZE + TEST_COMPRESSION_SIZE / 255 + 16;
+    char *compressed = malloc(capacity), *decompressed = malloc(TEST_COMPRESSION_SIZE);
+    expect(compressed != NULL && decompressed != NULL, "allocate buffers");
+
+    for (int i = 0; i < 2; i++) {
+        int length = simfsLz4Compress(contents[i], TEST_COMPRESSION_SIZE, compressed, capacity);
+        expect(length > 0, "compress content");
+        if (i == 0)
+            expect(length < TEST_COMPRESSION_SIZE / 4, "compress repetitive content");
+        expect(simfsLz4Decompress(compressed, length, decompressed, TEST_COMPRESSION_SIZE) == TEST_COMPRESSION_SIZE
+               && memcmp(decompressed, contents[i], TEST_COMPRESSION_SIZE) == 0, "decompress content");
+
+        expect(simfsLz4Decompress(compressed, length - 1, decompressed, TEST_COMPRESSION_SIZE) == -1,
+               "reject a block that is cut");
+        expect(simfsLz4Decompress(compressed, length, decompressed, TEST_COMPRESSION_SIZE - 1) == -1,
+               "reject a block that does not fit");
+        free(contents[i]);
+    }
+
+    char longLiterals[] = {(char) 0xF0, (char) 0xFF, (char) 0xFF, 'a'};
+    expect(simfsLz4Decompress(longLiterals, sizeof(longLiterals), decompressed, TEST_COMPRESSION_SIZE) == -1,
+           "reject literals beyond the input");
+    char farMatch[] = {0x10, 'a', 0x02, 0x00, 0x00};
+    expect(simfsLz4Decompress(farMatch, sizeof(farMatch), decompressed, TEST_COMPRESSION_SIZE) == -1,
+           "reject a match before the output");
+
+    free(compressed);
+    free(decompressed);
+}
+
+/***
+ * Compressed files read back what was written to them, before and after a remount, and use fewer blocks when their
+ * content compresses; a chunk damaged in the image makes the read fail instead of returning other content.
+ */
+static void testCompression()
+{
+    char *contents[] = {repetitiveContent(TEST_COMPRESSION_SIZE), simfsGenerateContent(TEST_COMPRESSION_SIZE)};
+    char *names[] = {"packed", "raw"};
+    mountNewVolume();
+    for (int i = 0; i < 2; i++) {
+        SIMFS_FILE_HANDLE_TYPE fileHandle = createAndOpen(names[i]);
+        expect(simfsWriteFile(fileHandle, contents[i]) == SIMFS_NO_ERROR, "write a file");
+        SIMFS_STATS_TYPE before, after;
+        expect(simfsGetStats(&before) == SIMFS_NO_ERROR, "get the statistics");
+        expect(simfsSetFileCompression(fileHandle, 1) == SIMFS_NO_ERROR, "compress a file");
+        expect(simfsGetStats(&after) == SIMFS_NO_ERROR, "get the statistics");
+        if (i == 0)
+            expect(after.freeBlocks > before.freeBlocks, "store compressed content in fewer blocks");
+        expectContent(fileHandle, contents[i], "read a compressed file");
+        expect(simfsCloseFile(fileHandle) == SIMFS_NO_ERROR, "close a file");
+    }
+    expect(simfsUmountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "unmount the volume");
+
+    expect(simfsMountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "mount the volume again");
+    SIMFS_INDEX_TYPE packed = SIMFS_INVALID_INDEX;
+    for (int i = 0; i < 2; i++) {
+        SIMFS_NAME_TYPE fileName = {0};
+        strncpy(fileName, names[i], sizeof(fileName) - 1);
+        SIMFS_FILE_HANDLE_TYPE fileHandle;
+        expect(simfsOpenFile(fileName, &fileHandle) == SIMFS_NO_ERROR, "open a compressed file");
+        expectContent(fileHandle, contents[i], "read a compressed file after mounting again");
+        expect(simfsCloseFile(fileHandle) == SIMFS_NO_ERROR, "close a file");
+        if (i == 0)
+            expect(simfsLookupFile(SIMFS_ROOT_NODE_INDEX, fileName, &packed) == SIMFS_NO_ERROR, "look up a file");
+    }
+    SIMFS_FILE_DESCRIPTOR_TYPE info;
+    expect(simfsGetFileInfoByReference(packed, &info) == SIMFS_NO_ERROR, "get the information of a file");
+    expect(simfsUmountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "unmount the volume");
+
+    // the LZ4 block of the first chunk starts with literals running past its end
+    SIMFS_INDEX_TYPE first = readImageBlock(info.block_ref).content.index[0];
+    SIMFS_BLOCK_TYPE chunk = readImageBlock(first);
+    memset(chunk.content.data + SIMFS_COMPRESSION_HEADER_SIZE, 0xFF, SIMFS_DATA_SIZE - SIMFS_COMPRESSION_HEADER_SIZE);
+    writeImageBlock(first, &chunk);
+
+    expect(simfsMountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "mount a damaged volume");
+    SIMFS_FILE_HANDLE_TYPE fileHandle;
+    char *content = NULL;
+    expect(simfsOpenFileByReference(packed, &fileHandle) == SIMFS_NO_ERROR, "open a damaged file");
+    expect(simfsReadFile(fileHandle, &content) == SIMFS_READ_ERROR && content == NULL, "reject a damaged chunk");
+    expect(simfsCloseFile(fileHandle) == SIMFS_NO_ERROR, "close a file");
+    expect(simfsUmountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "unmount the volume");
+
+    free(contents[0]);
+    free(contents[1]);
+}
+
+#define TEST_DEDUPLICATION_SIZE 1000
+
+static int freeBlocks()
+{
+    SIMFS_STATS_TYPE stats;
+    expect(simfsGetStats(&stats) == SIMFS_NO_ERROR, "get the statistics");
+    return stats.freeBlocks;
+}
+
+/***
+ * Copies of a file written with deduplication on share its data blocks, which stay readable until the last copy is
+ * deleted and are then freed; the references are counted again when the volume is mounted.
+ */
+static void testDeduplication()
+{
+    char *content = simfsGenerateContent(TEST_DEDUPLICATION_SIZE);
+    char *names[] = {"original", "copy1", "copy2", "copy3"};
+    mountNewVolume();
+    expect(simfsSetDeduplication(1) == SIMFS_NO_ERROR, "turn deduplication on");
+    int initial = freeBlocks(), taken = 0;
+    for (int i = 0; i < 3; i++) {
+        int before = freeBlocks();
+        SIMFS_FILE_HANDLE_TYPE fileHandle = createAndOpen(names[i]);
+        expect(simfsWriteFile(fileHandle, content) == SIMFS_NO_ERROR, "write a file");
+        expect(simfsCloseFile(fileHandle) == SIMFS_NO_ERROR, "close a file");
+        if (i == 0)
+            taken = before - freeBlocks();
+        else
+            expect(before - freeBlocks() < taken / 2, "share the data blocks of a copy");
+    }
+
+    SIMFS_STATS_TYPE stats;
+    expect(simfsGetStats(&stats) == SIMFS_NO_ERROR && stats.sharedBlocks > 0, "count the shared blocks");
+    SIMFS_CHECK_TYPE check = {0};
+    expect(simfsCheckFileSystem(&check) == SIMFS_NO_ERROR, "check a deduplicated volume");
+    expect(check.sharedBlocks == (unsigned long) stats.sharedBlocks && check.doublyReferencedBlocks == 0
+           && check.orphanedBlocks == 0 && check.brokenReferences == 0, "find a deduplicated volume clean");
+
+    SIMFS_NAME_TYPE fileName = "original";
+    expect(simfsDeleteFile(fileName) == SIMFS_NO_ERROR, "delete the original");
+    expect(simfsUmountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "unmount the volume");
+
+    expect(simfsMountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "mount the volume again");
+    expect(simfsSetDeduplication(1) == SIMFS_NO_ERROR, "turn deduplication on");
+    for (int i = 1; i < 3; i++) {
+        strncpy(fileName, names[i], sizeof(fileName) - 1);
+        SIMFS_FILE_HANDLE_TYPE fileHandle;
+        expect(simfsOpenFile(fileName, &fileHandle) == SIMFS_NO_ERROR, "open a copy");
+        expectContent(fileHandle, content, "read a copy of a deleted file");
+        expect(simfsCloseFile(fileHandle) == SIMFS_NO_ERROR, "close a file");
+    }
+    int before = freeBlocks();
+    SIMFS_FILE_HANDLE_TYPE fileHandle = createAndOpen(names[3]);
+    expect(simfsWriteFile(fileHandle, content) == SIMFS_NO_ERROR, "write a file");
+    expect(simfsCloseFile(fileHandle) == SIMFS_NO_ERROR, "close a file");
+    expect(before - freeBlocks() < taken / 2, "share the data blocks written before mounting");
+
+    for (int i = 1; i < 4; i++) {
+        strncpy(fileName, names[i], sizeof(fileName) - 1);
+        expect(simfsDeleteFile(fileName) == SIMFS_NO_ERROR, "delete a copy");
+    }
+    expect(freeBlocks() == initial, "free the shared blocks with the last copy");
+    expect(simfsCheckFileSystem(&check) == SIMFS_NO_ERROR && check.sharedBlocks == 0 && check.orphanedBlocks == 0,
+           "find an emptied volume clean");
+    expect(simfsUmountFileSystem(SIMFS_FILE_NAME) == SIMFS_NO_ERROR, "unmount the volume");
+    free(content);
+}
+
+#define TEST_STRIPES "simfsStripe0.dta:simfsStripe1.dta:simfsStripe2.dta"
+#define TEST_STRIPES_SWAPPED "simfsStripe1.dta:simfsStripe0.dta:simfsStripe2.dta"
+#define TEST_STRIPES_FEWER "simfsStripe0.dta:simfsStripe1.dta"
+
+/***
+ * A volume striped across several image files is mounted again from them, only if they are named in the order they
+ * were written in, and can be striped across a different number of files when it is unmounted.
+ */
+static void testStriping()
+{
+    expect(simfsCreateFileSystem(TEST_STRIPES) == SIMFS_NO_ERROR, "create a striped volume");
+    expect(simfsMountFileSystem(TEST_STRIPES) == SIMFS_NO_ERROR, "mount a striped volume");
+    char *content = simfsGenerateContent(5000);
+    SIMFS_FILE_HANDLE_TYPE fileHandle = createAndOpen("striped");
+    expect(simfsWriteFile(fileHandle, content) == SIMFS_NO_ERROR, "write a file");
+    expect(simfsCloseFile(fileHandle) == SIMFS_NO_ERROR, "close a file");
+    expect(simfsUmountFileSystem(TEST_STRIPES) == SIMFS_NO_ERROR, "unmount a striped volume");
+
+    expect(simfsMountFileSystem(TEST_STRIPES_SWAPPED) == SIMFS_READ_ERROR, "mount stripes named out of order");
+    expect(simfsMountFileSystem(TEST_STRIPES_FEWER) == SIMFS_READ_ERROR, "mount a volume from some of its stripes");
+    expect(simfsMountFileSystem(TEST_STRIPES) == SIMFS_NO_ERROR, "mount a striped volume again");
+
+    SIMFS_NAME_TYPE fileName = "striped";
+    expect(simfsOpenFile(fileName, &fileHandle) == SIMFS_NO_ERROR, "open a file of a striped volume");
+    expectContent(fileHandle, content, "read a file of a striped volume");
+    expect(simfsCloseFile(fileHandle) == SIMFS_NO_ERROR, "close a file");
+    expect(simfsUmountFileSystem(TEST_STRIPES_FEWER) == SIMFS_NO_ERROR, "restripe a volume across fewer files");
+
+    expect(simfsMountFileSystem(TEST_STRIPES_FEWER) == SIMFS_NO_ERROR, "mount a restriped volume");
+    expect(simfsOpenFile(fileName, &fileHandle) == SIMFS_NO_ERROR, "open a file of a restriped volume");
+    expectContent(fileHandle, content, "read a file of a restriped volume");
+    expect(simfsCloseFile(fileHandle) == SIMFS_NO_ERROR, "close a file");
+    expect(simfsUmountFileSystem(TEST_STRIPES_FEWER) == SIMFS_NO_ERROR, "unmount a restriped volume");
+
+    free(content);
+    remove("simfsStripe0.dta");
+    remove("simfsStripe1.dta");
+    remove("simfsStripe2.dta");
+}
+
 int main()
 {
 //    srand(time(NULL)); // uncomment to get true random values in get_context()
@@ -64,5 +876,20 @@ int main()
     simfsSetBit(testBitVector, 33);
     printf("Found free block at %d\n", simfsFindFreeBlock(testBitVector));
 
+    testOpenByReference();
+    testCloseWhilePinned();
+    testBatch();
+    testCompactWhilePinned();
+    testReadDir();
+    testDentryCache();
+    testColdMount();
+    testStriping();
+    testCrc32c();
+    testChecksums();
+    testRepair();
+    testLz4();
+    testCompression();
+    testDeduplication();
+
     return EXIT_SUCCESS;
 }